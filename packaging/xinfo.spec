@@ -6,6 +6,14 @@ Group:      Graphics/X Window System
 License:    MIT
 Source0:    %{name}-%{version}.tar.gz
 BuildRequires: pkgconfig(x11)
+BuildRequires: pkgconfig(x11-xcb)
+BuildRequires: pkgconfig(xcb)
+BuildRequires: pkgconfig(xcb-shape)
+BuildRequires: pkgconfig(xcb-res)
+BuildRequires: pkgconfig(xext)
+BuildRequires: pkgconfig(xdamage)
+BuildRequires: pkgconfig(xtst)
+BuildRequires: pkgconfig(zlib)
 
 # some file to be intalled can be ignored when rpm generates packages
 #%define _unpackaged_files_terminate_build 0
@@ -0,0 +1,183 @@
+/**************************************************************************
+
+xinfo
+
+Copyright 2014-2018 Samsung Electronics co., Ltd. All Rights Reserved.
+
+Contact: SooChan Lim <sc1.lim@samsung.com>
+Contact: Gwan-gyeong Mun <kk.moon@samsung.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sub license, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice (including the
+next paragraph) shall be included in all copies or substantial portions
+of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+**************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <xinfo.h>
+
+/*
+ * String arena : the strings of a scan are copied into large chunks and
+ * released in one shot. Equal strings are interned once, so the application
+ * name shared by all the windows of a process takes the memory of one.
+ */
+
+#define ARENA_CHUNK_SIZE 16384
+
+struct _StrChunk {
+    struct _StrChunk *next;
+    size_t used;
+    size_t size;
+    char data[];
+};
+
+    static unsigned int
+_arena_hash(const char *str, size_t len)
+{
+    unsigned int hash = 2166136261u;
+    size_t i;
+
+    for (i = 0; i < len; i++)
+        hash = (hash ^ (unsigned char)str[i]) * 16777619u;
+
+    return hash;
+}
+
+    static char *
+_arena_alloc(StrArena *arena, size_t len)
+{
+    StrChunk *chunk = arena->chunks;
+    char *str;
+
+    if (!chunk || chunk->size - chunk->used < len)
+    {
+        size_t size = len > ARENA_CHUNK_SIZE ? len : ARENA_CHUNK_SIZE;
+
+        chunk = malloc(sizeof(StrChunk) + size);
+        if (!chunk)
+        {
+            fprintf(stderr, " alloc error \n");
+            exit(1);
+        }
+        chunk->used = 0;
+        chunk->size = size;
+        chunk->next = arena->chunks;
+        arena->chunks = chunk;
+    }
+
+    str = chunk->data + chunk->used;
+    chunk->used += len;
+    arena->used += len;
+
+    return str;
+}
+
+    static void
+_arena_grow(StrArena *arena)
+{
+    const char **table;
+    int size = arena->size ? arena->size * 2 : 256;
+    int i;
+
+    table = calloc(size, sizeof(char *));
+    if (!table)
+    {
+        fprintf(stderr, " alloc error \n");
+        exit(1);
+    }
+
+    for (i = 0; i < arena->size; i++)
+    {
+        unsigned int j;
+
+        if (!arena->table[i])
+            continue;
+
+        j = _arena_hash(arena->table[i], strlen(arena->table[i])) & (size - 1);
+        while (table[j])
+            j = (j + 1) & (size - 1);
+        table[j] = arena->table[i];
+    }
+
+    free(arena->table);
+    arena->table = table;
+    arena->size = size;
+}
+
+/*
+ * Return the interned copy of the first len bytes of str (up to a '\0').
+ * NULL stays NULL.
+ */
+    const char *
+arena_strndup(StrArena *arena, const char *str, size_t len)
+{
+    unsigned int i;
+    char *copy;
+
+    if (!str)
+        return NULL;
+
+    len = strnlen(str, len);
+
+    if ((arena->num + 1) * 2 > arena->size)
+        _arena_grow(arena);
+
+    i = _arena_hash(str, len) & (arena->size - 1);
+    while (arena->table[i])
+    {
+        if (!strncmp(arena->table[i], str, len) && arena->table[i][len] == '\0')
+            return arena->table[i];
+        i = (i + 1) & (arena->size - 1);
+    }
+
+    copy = _arena_alloc(arena, len + 1);
+    memcpy(copy, str, len);
+    copy[len] = '\0';
+
+    arena->table[i] = copy;
+    arena->num++;
+
+    return copy;
+}
+
+    const char *
+arena_strdup(StrArena *arena, const char *str)
+{
+    return arena_strndup(arena, str, (size_t)-1);
+}
+
+/*
+ * Release all the strings of the arena at once.
+ */
+    void
+arena_release(StrArena *arena)
+{
+    StrChunk *chunk, *next;
+
+    for (chunk = arena->chunks; chunk; chunk = next)
+    {
+        next = chunk->next;
+        free(chunk);
+    }
+
+    free(arena->table);
+    memset(arena, 0, sizeof(StrArena));
+}
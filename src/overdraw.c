@@ -0,0 +1,210 @@
+/**************************************************************************
+
+xinfo
+
+Copyright 2014-2018 Samsung Electronics co., Ltd. All Rights Reserved.
+
+Contact: SooChan Lim <sc1.lim@samsung.com>
+Contact: Gwan-gyeong Mun <kk.moon@samsung.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sub license, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice (including the
+next paragraph) shall be included in all copies or substantial portions
+of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+**************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <xinfo.h>
+
+/*
+ * Per pixel layer count of a stack of rectangles. A rectangle is added as
+ * the four corners of a two dimensional difference array, so adding costs
+ * the same for a small window and a fullscreen one. The counts are resolved
+ * with a vertical prefix sum, row by row in vectors of 8 counters, and a
+ * horizontal one which gathers the statistics on the way. The counters are
+ * 16 bits, the differences wrap around but the sums come out right.
+ */
+
+typedef uint16_t OverdrawVec __attribute__((vector_size(16)));
+
+#define OVERDRAW_VEC_LEN (int)(sizeof(OverdrawVec) / sizeof(uint16_t))
+
+struct _Overdraw {
+    int width;
+    int height;
+    uint16_t *count;
+    OverdrawStats stats;
+};
+
+    OverdrawPtr
+overdraw_new(int width, int height)
+{
+    OverdrawPtr od;
+
+    od = calloc(1, sizeof(Overdraw));
+    if (!od)
+    {
+        fprintf(stderr, " alloc error \n");
+        exit(1);
+    }
+    od->width = width;
+    od->height = height;
+    od->count = calloc((size_t)width * height, sizeof(uint16_t));
+    if (!od->count)
+    {
+        fprintf(stderr, " alloc error \n");
+        exit(1);
+    }
+
+    return od;
+}
+
+    void
+overdraw_add(OverdrawPtr od, int x, int y, int w, int h)
+{
+    int x2 = x + w, y2 = y + h;
+    uint16_t *count = od->count;
+
+    if (x < 0)
+        x = 0;
+    if (y < 0)
+        y = 0;
+    if (x2 > od->width)
+        x2 = od->width;
+    if (y2 > od->height)
+        y2 = od->height;
+    if (x >= x2 || y >= y2)
+        return;
+
+    /* the corners past the right or the bottom edge are never summed */
+    count[(size_t)y * od->width + x]++;
+    if (x2 < od->width)
+        count[(size_t)y * od->width + x2]--;
+    if (y2 < od->height)
+    {
+        count[(size_t)y2 * od->width + x]--;
+        if (x2 < od->width)
+            count[(size_t)y2 * od->width + x2]++;
+    }
+}
+
+    static void
+overdraw_add_row(uint16_t *row, const uint16_t *prev, int len)
+{
+    OverdrawVec a, b;
+    int x;
+
+    for (x = 0; x + OVERDRAW_VEC_LEN <= len; x += OVERDRAW_VEC_LEN)
+    {
+        memcpy(&a, row + x, sizeof(a));
+        memcpy(&b, prev + x, sizeof(b));
+        a += b;
+        memcpy(row + x, &a, sizeof(a));
+    }
+    for (; x < len; x++)
+        row[x] += prev[x];
+}
+
+    const OverdrawStats *
+overdraw_resolve(OverdrawPtr od)
+{
+    OverdrawStats *stats = &od->stats;
+    int x, y;
+
+    memset(stats, 0, sizeof(OverdrawStats));
+    stats->width = od->width;
+    stats->height = od->height;
+
+    for (y = 1; y < od->height; y++)
+        overdraw_add_row(od->count + (size_t)y * od->width, od->count + (size_t)(y - 1) * od->width, od->width);
+
+    for (y = 0; y < od->height; y++)
+    {
+        uint16_t *row = od->count + (size_t)y * od->width;
+        uint16_t sum = 0;
+
+        for (x = 0; x < od->width; x++)
+        {
+            sum += row[x];
+            row[x] = sum;
+            stats->layers += sum;
+            stats->area[sum < OVERDRAW_LEVELS ? sum : OVERDRAW_LEVELS]++;
+            if (sum > stats->max)
+                stats->max = sum;
+        }
+    }
+    stats->covered = (long)od->width * od->height - stats->area[0];
+
+    return stats;
+}
+
+/*
+ * The resolved counts as a binary PGM, the gray level of a pixel is its
+ * number of layers.
+ */
+    int
+overdraw_write_pgm(OverdrawPtr od, FILE *fd)
+{
+    int maxval = od->stats.max ? od->stats.max : 1;
+    int bytes = maxval > 255 ? 2 : 1;
+    unsigned char *line;
+    int x, y;
+
+    line = malloc((size_t)od->width * bytes);
+    if (!line)
+    {
+        fprintf(stderr, " alloc error \n");
+        exit(1);
+    }
+
+    fprintf(fd, "P5\n%d %d\n%d\n", od->width, od->height, maxval);
+    for (y = 0; y < od->height; y++)
+    {
+        const uint16_t *row = od->count + (size_t)y * od->width;
+
+        /* the 16 bits samples are big endian */
+        for (x = 0; x < od->width; x++)
+        {
+            if (bytes == 2)
+            {
+                line[2 * x] = row[x] >> 8;
+                line[2 * x + 1] = row[x] & 0xff;
+            }
+            else
+                line[x] = row[x];
+        }
+        if (fwrite(line, bytes, od->width, fd) != (size_t)od->width)
+        {
+            free(line);
+            return -1;
+        }
+    }
+
+    free(line);
+    return 0;
+}
+
+    void
+overdraw_free(OverdrawPtr od)
+{
+    free(od->count);
+    free(od);
+}
@@ -0,0 +1,296 @@
+/**************************************************************************
+
+xinfo
+
+Copyright 2014-2018 Samsung Electronics co., Ltd. All Rights Reserved.
+
+Contact: SooChan Lim <sc1.lim@samsung.com>
+Contact: Gwan-gyeong Mun <kk.moon@samsung.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sub license, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice (including the
+next paragraph) shall be included in all copies or substantial portions
+of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+**************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <dirent.h>
+#include <xinfo.h>
+
+/*
+ * Per-run cache of the /proc metadata of the client processes. Many windows
+ * (popups, tooltips, ...) share one pid, so every /proc/<pid> file is read
+ * once per process with open + pread into a reusable buffer. A process which
+ * has exited in the middle of the scan is remembered as gone instead of
+ * aborting the scan. The resource usage is only parsed when it is asked for.
+ */
+
+#define PROC_BUF_SIZE 4096
+
+typedef struct _ProcEntry {
+    long pid;               /* 0 : free slot */
+    int gone;
+    char *cmdline;          /* argv[0] */
+    int usage_loaded;
+    ProcUsage usage;
+} ProcEntry;
+
+static ProcEntry *proc_table = NULL;
+static int proc_size = 0;   /* power of two */
+static int proc_num = 0;
+static char proc_buf[PROC_BUF_SIZE];
+
+/*
+ * Read /proc/<pid>/<name> into proc_buf with a single pread.
+ * Return the number of bytes read, -1 if the file cannot be read.
+ */
+    static int
+_proc_read(long pid, const char *name)
+{
+    char path[64];
+    ssize_t len;
+    int fd;
+
+    snprintf(path, sizeof(path), "/proc/%ld/%s", pid, name);
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return -1;
+
+    do {
+        len = pread(fd, proc_buf, sizeof(proc_buf) - 1, 0);
+    } while (len < 0 && errno == EINTR);
+
+    close(fd);
+
+    if (len < 0)
+        return -1;
+
+    proc_buf[len] = '\0';
+    return (int)len;
+}
+
+    static unsigned int
+_proc_hash(long pid)
+{
+    return (unsigned int)pid * 2654435761u;
+}
+
+    static ProcEntry *
+_proc_slot(ProcEntry *table, int size, long pid)
+{
+    unsigned int i = _proc_hash(pid) & (size - 1);
+
+    while (table[i].pid && table[i].pid != pid)
+        i = (i + 1) & (size - 1);
+
+    return &table[i];
+}
+
+    static void
+_proc_grow(void)
+{
+    ProcEntry *table;
+    int size = proc_size ? proc_size * 2 : 64;
+    int i;
+
+    table = calloc(size, sizeof(ProcEntry));
+    if (!table)
+    {
+        fprintf(stderr, " alloc error \n");
+        exit(1);
+    }
+
+    for (i = 0; i < proc_size; i++)
+        if (proc_table[i].pid)
+            *_proc_slot(table, size, proc_table[i].pid) = proc_table[i];
+
+    free(proc_table);
+    proc_table = table;
+    proc_size = size;
+}
+
+    static void
+_proc_load(ProcEntry *entry)
+{
+    int len;
+
+    len = _proc_read(entry->pid, "cmdline");
+    if (len < 0)
+    {
+        entry->gone = 1;
+        return;
+    }
+
+    /* the arguments are separated by '\0', keep argv[0] as the original code */
+    entry->cmdline = strndup(proc_buf, 254);
+    if (!entry->cmdline)
+    {
+        fprintf(stderr, " alloc error \n");
+        exit(1);
+    }
+}
+
+    static ProcEntry *
+_proc_lookup(long pid)
+{
+    ProcEntry *entry;
+
+    if (pid <= 0)
+        return NULL;
+
+    if ((proc_num + 1) * 2 > proc_size)
+        _proc_grow();
+
+    entry = _proc_slot(proc_table, proc_size, pid);
+    if (!entry->pid)
+    {
+        entry->pid = pid;
+        proc_num++;
+        _proc_load(entry);
+    }
+
+    return entry->gone ? NULL : entry;
+}
+
+/*
+ * Return the value of the "<key>:" line of the text in proc_buf, -1 if absent.
+ */
+    static long
+_proc_field(const char *key)
+{
+    size_t len = strlen(key);
+    char *line = proc_buf;
+
+    while (line && *line)
+    {
+        if (!strncmp(line, key, len) && line[len] == ':')
+            return strtol(line + len + 1, NULL, 10);
+
+        line = strchr(line, '\n');
+        if (line)
+            line++;
+    }
+
+    return -1;
+}
+
+    static long
+_proc_count_fds(long pid)
+{
+    char path[64];
+    struct dirent *de;
+    DIR *dir;
+    long num = 0;
+
+    snprintf(path, sizeof(path), "/proc/%ld/fd", pid);
+
+    /* only readable for our own processes, or as root */
+    dir = opendir(path);
+    if (!dir)
+        return -1;
+
+    while ((de = readdir(dir)))
+        if (de->d_name[0] != '.')
+            num++;
+
+    closedir(dir);
+
+    return num;
+}
+
+    static void
+_proc_load_usage(ProcEntry *entry)
+{
+    ProcUsage *usage = &entry->usage;
+    unsigned long utime, stime;
+    long resident;
+    char *p;
+
+    entry->usage_loaded = 1;
+    usage->rss = usage->pss = usage->threads = usage->fds = -1;
+    usage->cpu = -1;
+
+    /* the comm field may hold spaces and parentheses, the fields start after the last ')' */
+    if (_proc_read(entry->pid, "stat") > 0 && (p = strrchr(proc_buf, ')')) &&
+        sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu %*d %*d %*d %*d %ld",
+               &utime, &stime, &usage->threads) == 3)
+        usage->cpu = (double)(utime + stime) / sysconf(_SC_CLK_TCK);
+
+    if (_proc_read(entry->pid, "statm") > 0 && sscanf(proc_buf, "%*u %ld", &resident) == 1)
+        usage->rss = resident * (sysconf(_SC_PAGESIZE) / 1024);
+
+    /* smaps_rollup needs the ptrace read permission on the process */
+    if (_proc_read(entry->pid, "smaps_rollup") > 0)
+        usage->pss = _proc_field("Pss");
+
+    usage->fds = _proc_count_fds(entry->pid);
+}
+
+/*
+ * Return argv[0] of the process, or NULL if the process does not exist
+ * anymore. The string belongs to the cache.
+ */
+    const char *
+procinfo_cmdline(long pid)
+{
+    ProcEntry *entry = _proc_lookup(pid);
+
+    return entry ? entry->cmdline : NULL;
+}
+
+/*
+ * Return the resource usage of the process, or NULL if the process does not
+ * exist anymore. The fields which cannot be read are -1.
+ */
+    const ProcUsage *
+procinfo_usage(long pid)
+{
+    ProcEntry *entry = _proc_lookup(pid);
+
+    if (!entry)
+        return NULL;
+
+    if (!entry->usage_loaded)
+        _proc_load_usage(entry);
+
+    return &entry->usage;
+}
+
+/*
+ * Forget all the processes, e.g. before a new scan of a long running mode
+ * where the pids may have been reused.
+ */
+    void
+procinfo_reset(void)
+{
+    int i;
+
+    for (i = 0; i < proc_size; i++)
+        free(proc_table[i].cmdline);
+
+    free(proc_table);
+    proc_table = NULL;
+    proc_size = proc_num = 0;
+}
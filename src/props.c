@@ -0,0 +1,676 @@
+/**************************************************************************
+
+xinfo
+
+Copyright 2014-2018 Samsung Electronics co., Ltd. All Rights Reserved.
+
+Contact: SooChan Lim <sc1.lim@samsung.com>
+Contact: Gwan-gyeong Mun <kk.moon@samsung.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sub license, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice (including the
+next paragraph) shall be included in all copies or substantial portions
+of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+**************************************************************************/
+
+#include <X11/Xlib.h>
+#include <X11/Xlib-xcb.h>
+#include <X11/Xatom.h>
+#include <X11/Xutil.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <xinfo.h>
+
+/*
+ * In-process replacement of /usr/bin/xprop : the properties of all the
+ * windows are listed in one pipelined batch, all the values are fetched in a
+ * second batch and the names of all the atoms met on the way are resolved
+ * with one XGetAtomNames call. The output follows the text format of xprop.
+ */
+
+typedef struct _WinProps {
+    Window window;
+    int num;
+    xcb_atom_t *atoms;
+    xcb_get_property_reply_t **replies;
+} WinProps;
+
+struct _PropList {
+    int count;
+    WinProps *wins;
+    int natoms;
+    Atom *atoms; /* sorted */
+    char **names;
+};
+
+typedef struct {
+    Atom type;
+    const char *label;
+} IdFormat;
+
+static const IdFormat _id_formats[] = {
+    { XA_BITMAP, "bitmap" },
+    { XA_COLORMAP, "colormap" },
+    { XA_CURSOR, "cursor" },
+    { XA_DRAWABLE, "drawable" },
+    { XA_FONT, "font" },
+    { XA_PIXMAP, "pixmap" },
+    { XA_VISUALID, "visual" },
+    { None, NULL } };
+
+static const char *_initial_states[] = {
+    "Don't Care State", "Normal State", "Zoomed State", "Iconic State", "Inactive State" };
+
+static const char *_gravities[] = {
+    "Forget", "NorthWest", "North", "NorthEast", "West", "Center",
+    "East", "SouthWest", "South", "SouthEast", "Static" };
+
+/* a stale atom left in a property must not end the run */
+    static int
+_props_error_handler(Display *disp, XErrorEvent *ev)
+{
+    return 0;
+}
+
+    static int
+_compare_atom(const void *a, const void *b)
+{
+    Atom x = *(const Atom *)a, y = *(const Atom *)b;
+
+    return (x > y) - (x < y);
+}
+
+    static void
+_add_atom(PropListPtr list, int *size, Atom atom)
+{
+    if (atom == None)
+        return;
+
+    if (list->natoms == *size)
+    {
+        *size = *size ? *size * 2 : 256;
+        list->atoms = realloc(list->atoms, *size * sizeof(Atom));
+        if (!list->atoms)
+        {
+            fprintf(stderr, " alloc error \n");
+            exit(1);
+        }
+    }
+    list->atoms[list->natoms++] = atom;
+}
+
+    static const char *
+_atom_name(PropListPtr list, Atom atom)
+{
+    static char unknown[2][48];
+    static int n = 0;
+    Atom *found;
+
+    if (atom == None)
+        return "None";
+
+    found = bsearch(&atom, list->atoms, list->natoms, sizeof(Atom), _compare_atom);
+    if (found && list->names[found - list->atoms])
+        return list->names[found - list->atoms];
+
+    /* the name and the type of a property can both be unknown */
+    n = !n;
+    snprintf(unknown[n], sizeof(unknown[n]), "undefined atom # 0x%lx", atom);
+    return unknown[n];
+}
+
+    static unsigned long
+_value(xcb_get_property_reply_t *reply, int i)
+{
+    void *val = xcb_get_property_value(reply);
+
+    if (reply->format == 8)
+        return ((uint8_t *)val)[i];
+    else if (reply->format == 16)
+        return ((uint16_t *)val)[i];
+    else
+        return ((uint32_t *)val)[i];
+}
+
+    static long
+_signed_value(xcb_get_property_reply_t *reply, int i)
+{
+    void *val = xcb_get_property_value(reply);
+
+    if (reply->format == 8)
+        return ((int8_t *)val)[i];
+    else if (reply->format == 16)
+        return ((int16_t *)val)[i];
+    else
+        return ((int32_t *)val)[i];
+}
+
+    static void
+_print_string(FILE *fd, const unsigned char *str, int len)
+{
+    int i;
+
+    fputc('"', fd);
+    for (i = 0; i < len; i++)
+    {
+        if (str[i] == '\\' || str[i] == '"')
+            fprintf(fd, "\\%c", str[i]);
+        else if (str[i] == '\n')
+            fprintf(fd, "\\n");
+        else if (str[i] < 0x20 || str[i] == 0x7f)
+            fprintf(fd, "\\%03o", str[i]);
+        else
+            fputc(str[i], fd);
+    }
+    fputc('"', fd);
+}
+
+/* NUL separated list of strings : "a", "b" */
+    static void
+_print_strings(FILE *fd, const unsigned char *str, int len)
+{
+    int start = 0, i;
+
+    if (len == 0)
+    {
+        _print_string(fd, str, 0);
+        return;
+    }
+
+    for (i = 0; i <= len; i++)
+    {
+        if (i < len && str[i])
+            continue;
+        if (i == len && start == len)
+            break;
+        if (start)
+            fprintf(fd, ", ");
+        _print_string(fd, str + start, i - start);
+        start = i + 1;
+    }
+}
+
+    static void
+_print_text(Display *dpy, FILE *fd, xcb_get_property_reply_t *reply)
+{
+    XTextProperty tp;
+    char **list = NULL;
+    int count = 0, ret, i;
+
+    tp.value = (unsigned char *)xcb_get_property_value(reply);
+    tp.encoding = reply->type;
+    tp.format = reply->format;
+    tp.nitems = reply->value_len;
+
+    ret = XmbTextPropertyToTextList(dpy, &tp, &list, &count);
+    if ((ret == Success || ret > 0) && list != NULL)
+    {
+        for (i = 0; i < count; i++)
+        {
+            if (i)
+                fprintf(fd, ", ");
+            _print_string(fd, (unsigned char *)list[i], strlen(list[i]));
+        }
+        XFreeStringList(list);
+    }
+    else
+        _print_strings(fd, tp.value, tp.nitems);
+}
+
+    static void
+_print_values(PropListPtr list, FILE *fd, xcb_get_property_reply_t *reply, char fmt)
+{
+    int i, num = reply->value_len;
+
+    for (i = 0; i < num; i++)
+    {
+        if (i)
+            fprintf(fd, ", ");
+        switch (fmt)
+        {
+            case 'a':
+                fprintf(fd, "%s", _atom_name(list, _value(reply, i)));
+                break;
+            case 'c':
+                fprintf(fd, "%lu", _value(reply, i));
+                break;
+            case 'i':
+                fprintf(fd, "%ld", _signed_value(reply, i));
+                break;
+            default:
+                fprintf(fd, "0x%lx", _value(reply, i));
+                break;
+        }
+    }
+}
+
+    static void
+_print_wm_hints(FILE *fd, xcb_get_property_reply_t *reply)
+{
+    unsigned long flags;
+    int num = reply->value_len;
+
+    fprintf(fd, ":\n");
+    if (reply->format != 32 || num < 1)
+        return;
+
+    flags = _value(reply, 0);
+    if ((flags & InputHint) && num > 1)
+        fprintf(fd, "\t\tClient accepts input or input focus: %s\n", _value(reply, 1) ? "True" : "False");
+    if ((flags & StateHint) && num > 2)
+    {
+        if (_value(reply, 2) < sizeof(_initial_states) / sizeof(_initial_states[0]))
+            fprintf(fd, "\t\tInitial state is %s.\n", _initial_states[_value(reply, 2)]);
+        else
+            fprintf(fd, "\t\tInitial state is .\n");
+    }
+    if ((flags & IconPixmapHint) && num > 3)
+        fprintf(fd, "\t\tbitmap id # to use for icon: 0x%lx\n", _value(reply, 3));
+    if ((flags & IconMaskHint) && num > 7)
+        fprintf(fd, "\t\tbitmap id # of mask for icon: 0x%lx\n", _value(reply, 7));
+    if ((flags & IconWindowHint) && num > 4)
+        fprintf(fd, "\t\twindow id # to use for icon: 0x%lx\n", _value(reply, 4));
+    if ((flags & IconPositionHint) && num > 6)
+        fprintf(fd, "\t\tstarting position for icon: %ld, %ld\n", _signed_value(reply, 5), _signed_value(reply, 6));
+    if ((flags & WindowGroupHint) && num > 8)
+        fprintf(fd, "\t\twindow id # of group leader: 0x%lx\n", _value(reply, 8));
+    if (flags & XUrgencyHint)
+        fprintf(fd, "\t\tThe urgency hint bit is set\n");
+}
+
+    static void
+_print_size_hints(FILE *fd, xcb_get_property_reply_t *reply)
+{
+    unsigned long flags;
+    int num = reply->value_len;
+
+    fprintf(fd, ":\n");
+    if (reply->format != 32 || num < 1)
+        return;
+
+#define V(i) _signed_value(reply, i)
+    flags = _value(reply, 0);
+    if ((flags & USPosition) && num > 2)
+        fprintf(fd, "\t\tuser specified location: %ld, %ld\n", V(1), V(2));
+    if ((flags & USSize) && num > 4)
+        fprintf(fd, "\t\tuser specified size: %ld by %ld\n", V(3), V(4));
+    if ((flags & PPosition) && num > 2)
+        fprintf(fd, "\t\tprogram specified location: %ld, %ld\n", V(1), V(2));
+    if ((flags & PSize) && num > 4)
+        fprintf(fd, "\t\tprogram specified size: %ld by %ld\n", V(3), V(4));
+    if ((flags & PMinSize) && num > 6)
+        fprintf(fd, "\t\tprogram specified minimum size: %ld by %ld\n", V(5), V(6));
+    if ((flags & PMaxSize) && num > 8)
+        fprintf(fd, "\t\tprogram specified maximum size: %ld by %ld\n", V(7), V(8));
+    if ((flags & PResizeInc) && num > 10)
+        fprintf(fd, "\t\tprogram specified resize increment: %ld by %ld\n", V(9), V(10));
+    if ((flags & PAspect) && num > 14)
+    {
+        fprintf(fd, "\t\tprogram specified minimum aspect ratio: %ld/%ld\n", V(11), V(12));
+        fprintf(fd, "\t\tprogram specified maximum aspect ratio: %ld/%ld\n", V(13), V(14));
+    }
+    if ((flags & PBaseSize) && num > 16)
+        fprintf(fd, "\t\tprogram specified base size: %ld by %ld\n", V(15), V(16));
+    if ((flags & PWinGravity) && num > 17)
+    {
+        if (_value(reply, 17) < sizeof(_gravities) / sizeof(_gravities[0]))
+            fprintf(fd, "\t\twindow gravity: %s\n", _gravities[_value(reply, 17)]);
+        else
+            fprintf(fd, "\t\twindow gravity: \n");
+    }
+#undef V
+}
+
+    static void
+_print_property(Display *dpy, PropListPtr list, FILE *fd, Atom atom, xcb_get_property_reply_t *reply)
+{
+    const char *name = _atom_name(list, atom);
+    const char *type;
+    int i;
+
+    if (!reply || reply->type == None)
+    {
+        fprintf(fd, "%s:  not found.\n", name);
+        return;
+    }
+
+    type = _atom_name(list, reply->type);
+    fprintf(fd, "%s(%s)", name, type);
+
+    if (reply->format == 8 &&
+        (reply->type == XA_STRING || !strcmp(type, "UTF8_STRING") || !strcmp(type, "COMPOUND_TEXT")))
+    {
+        if (!strcmp(name, "WM_COMMAND"))
+        {
+            fprintf(fd, " = { ");
+            _print_strings(fd, xcb_get_property_value(reply), reply->value_len);
+            fprintf(fd, " }\n");
+        }
+        else if (!strcmp(type, "COMPOUND_TEXT"))
+        {
+            fprintf(fd, " = ");
+            _print_text(dpy, fd, reply);
+            fprintf(fd, "\n");
+        }
+        else
+        {
+            fprintf(fd, " = ");
+            _print_strings(fd, xcb_get_property_value(reply), reply->value_len);
+            fprintf(fd, "\n");
+        }
+        return;
+    }
+
+    if (reply->type == XA_WM_HINTS)
+    {
+        _print_wm_hints(fd, reply);
+        return;
+    }
+
+    if (reply->type == XA_WM_SIZE_HINTS)
+    {
+        _print_size_hints(fd, reply);
+        return;
+    }
+
+    if (!strcmp(type, "WM_STATE") && reply->format == 32 && reply->value_len >= 2)
+    {
+        fprintf(fd, ":\n\t\twindow state: ");
+        switch (_value(reply, 0))
+        {
+            case WithdrawnState: fprintf(fd, "Withdrawn\n"); break;
+            case NormalState: fprintf(fd, "Normal\n"); break;
+            case IconicState: fprintf(fd, "Iconic\n"); break;
+            default: fprintf(fd, "\n"); break;
+        }
+        fprintf(fd, "\t\ticon window: 0x%lx\n", _value(reply, 1));
+        return;
+    }
+
+    if (reply->type == XA_ATOM && reply->format == 32)
+    {
+        if (!strcmp(name, "WM_PROTOCOLS"))
+            fprintf(fd, ": protocols  ");
+        else
+            fprintf(fd, " = ");
+        _print_values(list, fd, reply, 'a');
+        fprintf(fd, "\n");
+        return;
+    }
+
+    if (reply->type == XA_WINDOW && reply->format == 32)
+    {
+        fprintf(fd, ": window id # ");
+        _print_values(list, fd, reply, 'x');
+        fprintf(fd, "\n");
+        return;
+    }
+
+    for (i = 0; _id_formats[i].label; i++)
+    {
+        if (reply->type == _id_formats[i].type && reply->format == 32 && reply->value_len > 0)
+        {
+            fprintf(fd, ": %s id # 0x%lx\n", _id_formats[i].label, _value(reply, 0));
+            return;
+        }
+    }
+
+    fprintf(fd, " = ");
+    if (reply->type == XA_CARDINAL)
+        _print_values(list, fd, reply, 'c');
+    else if (reply->type == XA_INTEGER)
+        _print_values(list, fd, reply, 'i');
+    else
+        _print_values(list, fd, reply, 'x');
+    fprintf(fd, "\n");
+}
+
+/*
+ * Get all the properties of the windows in pipelined batches.
+ */
+    PropListPtr
+props_query(Display *dpy, Window *windows, int count)
+{
+    xcb_connection_t *conn = XGetXCBConnection(dpy);
+    xcb_list_properties_cookie_t *list_cookies;
+    xcb_get_property_cookie_t **prop_cookies;
+    xcb_generic_error_t *err = NULL;
+    XErrorHandler old_handler;
+    PropListPtr list;
+    int i, j, k, size = 0;
+
+    list = calloc(1, sizeof(PropList));
+    list_cookies = calloc(count + 1, sizeof(xcb_list_properties_cookie_t));
+    prop_cookies = calloc(count + 1, sizeof(xcb_get_property_cookie_t *));
+    if (!list || !list_cookies || !prop_cookies)
+    {
+        fprintf(stderr, " alloc error \n");
+        exit(1);
+    }
+
+    list->count = count;
+    list->wins = calloc(count + 1, sizeof(WinProps));
+    if (!list->wins)
+    {
+        fprintf(stderr, " alloc error \n");
+        exit(1);
+    }
+
+    /* list the properties of all the windows */
+    for (i = 0; i < count; i++)
+    {
+        list->wins[i].window = windows[i];
+        list_cookies[i] = xcb_list_properties(conn, windows[i]);
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        xcb_list_properties_reply_t *reply;
+        WinProps *wp = &list->wins[i];
+
+        reply = xcb_list_properties_reply(conn, list_cookies[i], &err);
+        if (err)
+        {
+            free(err);
+            err = NULL;
+        }
+        if (!reply)
+            continue;
+
+        wp->num = xcb_list_properties_atoms_length(reply);
+        wp->atoms = calloc(wp->num + 1, sizeof(xcb_atom_t));
+        wp->replies = calloc(wp->num + 1, sizeof(xcb_get_property_reply_t *));
+        prop_cookies[i] = calloc(wp->num + 1, sizeof(xcb_get_property_cookie_t));
+        if (!wp->atoms || !wp->replies || !prop_cookies[i])
+        {
+            fprintf(stderr, " alloc error \n");
+            exit(1);
+        }
+        memcpy(wp->atoms, xcb_list_properties_atoms(reply), wp->num * sizeof(xcb_atom_t));
+        free(reply);
+
+        /* send the requests of the values right away */
+        for (j = 0; j < wp->num; j++)
+            prop_cookies[i][j] = xcb_get_property(conn, 0, wp->window, wp->atoms[j],
+                                                  XCB_GET_PROPERTY_TYPE_ANY, 0, 0x7fffffff);
+    }
+
+    /* get all the values, and the atoms to be named */
+    for (i = 0; i < count; i++)
+    {
+        WinProps *wp = &list->wins[i];
+
+        for (j = 0; j < wp->num; j++)
+        {
+            xcb_get_property_reply_t *reply;
+
+            reply = xcb_get_property_reply(conn, prop_cookies[i][j], &err);
+            if (err)
+            {
+                free(err);
+                err = NULL;
+            }
+            wp->replies[j] = reply;
+
+            _add_atom(list, &size, wp->atoms[j]);
+            if (!reply)
+                continue;
+            _add_atom(list, &size, reply->type);
+            if (reply->type == XA_ATOM && reply->format == 32)
+                for (k = 0; k < (int)reply->value_len; k++)
+                    _add_atom(list, &size, _value(reply, k));
+        }
+        free(prop_cookies[i]);
+    }
+
+    /* name all the atoms at once */
+    if (list->natoms)
+    {
+        qsort(list->atoms, list->natoms, sizeof(Atom), _compare_atom);
+        for (i = 1, j = 1; i < list->natoms; i++)
+            if (list->atoms[i] != list->atoms[j - 1])
+                list->atoms[j++] = list->atoms[i];
+        list->natoms = j;
+
+        list->names = calloc(list->natoms, sizeof(char *));
+        if (!list->names)
+        {
+            fprintf(stderr, " alloc error \n");
+            exit(1);
+        }
+
+        /* the names of the unknown atoms are left NULL */
+        old_handler = XSetErrorHandler(_props_error_handler);
+        XGetAtomNames(dpy, list->atoms, list->natoms, list->names);
+        XSync(dpy, False);
+        XSetErrorHandler(old_handler);
+    }
+
+    free(list_cookies);
+    free(prop_cookies);
+
+    return list;
+}
+
+/*
+ * Print the properties of the idx-th window of props_query() like xprop.
+ */
+    void
+props_print(Display *dpy, PropListPtr list, int idx, FILE *fd)
+{
+    WinProps *wp;
+    int i;
+
+    if (!list || idx < 0 || idx >= list->count)
+        return;
+
+    wp = &list->wins[idx];
+    for (i = 0; i < wp->num; i++)
+        _print_property(dpy, list, fd, wp->atoms[i], wp->replies[i]);
+}
+
+/*
+ * Pass the properties of the idx-th window of props_query() to emit one by
+ * one : the name, the type (NULL if the property is not found) and the value
+ * in the text of xprop. The value text is formatted into one stream reused
+ * for all the properties.
+ */
+    void
+props_export(Display *dpy, PropListPtr list, int idx,
+             void (*emit)(void *data, const char *name, const char *type, const char *value), void *data)
+{
+    static FILE *mem = NULL;
+    static char *buf = NULL;
+    static size_t size = 0;
+    WinProps *wp;
+    const char *name, *type, *value;
+    size_t len;
+    int i;
+
+    if (!list || idx < 0 || idx >= list->count)
+        return;
+
+    if (!mem)
+    {
+        mem = open_memstream(&buf, &size);
+        if (!mem)
+        {
+            fprintf(stderr, " alloc error \n");
+            exit(1);
+        }
+    }
+
+    wp = &list->wins[idx];
+    for (i = 0; i < wp->num; i++)
+    {
+        xcb_get_property_reply_t *reply = wp->replies[i];
+
+        if (!reply || reply->type == None)
+        {
+            emit(data, _atom_name(list, wp->atoms[i]), NULL, NULL);
+            continue;
+        }
+        rewind(mem);
+        _print_property(dpy, list, mem, wp->atoms[i], reply);
+        fputc('\0', mem);
+        fflush(mem);
+
+        /* the names of unknown atoms are in rotating buffers, name them after the value */
+        name = _atom_name(list, wp->atoms[i]);
+        type = _atom_name(list, reply->type);
+
+        /* skip "name(type)" and the separator, drop the last newline */
+        value = buf + strlen(name) + strlen(type) + 2;
+        while (*value == ' ' || *value == '=' || *value == ':')
+            value++;
+        while (*value == '\n' || *value == '\t')
+            value++;
+        len = strlen(value);
+        if (len && value[len - 1] == '\n')
+            buf[value - buf + len - 1] = '\0';
+
+        emit(data, name, type, value);
+    }
+}
+
+    void
+props_free(PropListPtr list)
+{
+    int i, j;
+
+    if (!list)
+        return;
+
+    for (i = 0; i < list->count; i++)
+    {
+        for (j = 0; j < list->wins[i].num; j++)
+            free(list->wins[i].replies[j]);
+        free(list->wins[i].replies);
+        free(list->wins[i].atoms);
+    }
+    for (i = 0; i < list->natoms; i++)
+        if (list->names[i])
+            XFree(list->names[i]);
+
+    free(list->names);
+    free(list->atoms);
+    free(list->wins);
+    free(list);
+}
@@ -0,0 +1,380 @@
+/**************************************************************************
+
+xinfo
+
+Copyright 2014-2018 Samsung Electronics co., Ltd. All Rights Reserved.
+
+Contact: SooChan Lim <sc1.lim@samsung.com>
+Contact: Gwan-gyeong Mun <kk.moon@samsung.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sub license, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice (including the
+next paragraph) shall be included in all copies or substantial portions
+of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+**************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <xinfo.h>
+
+/*
+ * Varint codec, writer and reader of the record log, see RecHeader.
+ */
+
+#define REC_ALIGN(x) (((x) + 7) & ~(uint64_t)7)
+
+struct _RecFile {
+    FILE *fd;
+    FILE *index;
+    uint64_t offset; /* of the next frame */
+};
+
+    static void
+rec_reserve(RecBuf *buf, size_t len)
+{
+    unsigned char *data;
+
+    if (buf->len + len <= buf->size)
+        return;
+
+    while (buf->len + len > buf->size)
+        buf->size = buf->size ? buf->size * 2 : 4096;
+    data = realloc(buf->data, buf->size);
+    if (!data)
+    {
+        fprintf(stderr, " alloc error \n");
+        exit(1);
+    }
+    buf->data = data;
+}
+
+    void
+rec_put_uint(RecBuf *buf, uint64_t val)
+{
+    rec_reserve(buf, 10);
+    while (val >= 0x80)
+    {
+        buf->data[buf->len++] = (unsigned char)(val | 0x80);
+        val >>= 7;
+    }
+    buf->data[buf->len++] = (unsigned char)val;
+}
+
+    void
+rec_put_int(RecBuf *buf, int64_t val)
+{
+    rec_put_uint(buf, ((uint64_t)val << 1) ^ (uint64_t)(val >> 63));
+}
+
+/* the length with the NUL, 0 for NULL, then the string with its NUL */
+    void
+rec_put_str(RecBuf *buf, const char *str)
+{
+    size_t len;
+
+    if (!str)
+    {
+        rec_put_uint(buf, 0);
+        return;
+    }
+    len = strlen(str) + 1;
+    rec_put_uint(buf, len);
+    rec_reserve(buf, len);
+    memcpy(buf->data + buf->len, str, len);
+    buf->len += len;
+}
+
+    uint64_t
+rec_get_uint(RecCursor *cur)
+{
+    uint64_t val = 0;
+    int shift;
+
+    for (shift = 0; shift < 64 && cur->pos < cur->end; shift += 7)
+    {
+        unsigned char byte = *cur->pos++;
+
+        val |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return val;
+    }
+
+    cur->error = 1;
+    return 0;
+}
+
+    int64_t
+rec_get_int(RecCursor *cur)
+{
+    uint64_t val = rec_get_uint(cur);
+
+    return (int64_t)(val >> 1) ^ -(int64_t)(val & 1);
+}
+
+/* the string stays in the mapping */
+    const char *
+rec_get_str(RecCursor *cur)
+{
+    const char *str;
+    uint64_t len = rec_get_uint(cur);
+
+    if (!len || cur->error)
+        return NULL;
+    if (len > (uint64_t)(cur->end - cur->pos) || cur->pos[len - 1])
+    {
+        cur->error = 1;
+        return NULL;
+    }
+
+    str = (const char *)cur->pos;
+    cur->pos += len;
+    return str;
+}
+
+    RecFilePtr
+rec_open(FILE *fd, FILE *index, uint32_t mode, uint32_t root, int64_t start, int64_t interval)
+{
+    RecFilePtr rf;
+    RecHeader header;
+
+    rf = calloc(1, sizeof(RecFile));
+    if (!rf)
+    {
+        fprintf(stderr, " alloc error \n");
+        exit(1);
+    }
+    rf->fd = fd;
+    rf->index = index;
+
+    memset(&header, 0, sizeof(RecHeader));
+    memcpy(header.magic, REC_MAGIC, sizeof(header.magic));
+    header.version = REC_VERSION;
+    header.byte_order = SNAP_BYTE_ORDER;
+    header.mode = mode;
+    header.root = root;
+    header.start = start;
+    header.interval = interval;
+
+    if (fwrite(&header, sizeof(RecHeader), 1, fd) != 1 || fflush(fd))
+    {
+        free(rf);
+        return NULL;
+    }
+    rf->offset = sizeof(RecHeader);
+
+    return rf;
+}
+
+/*
+ * Append a frame, and the index entry of a key frame once the frame is
+ * written. Both files are flushed, so a reader sees whole frames only, but
+ * for the last one of a writer which died.
+ */
+    int
+rec_append(RecFilePtr rf, uint32_t kind, int64_t time, const RecBuf *buf)
+{
+    static const char pad[8];
+    RecFrame frame;
+    RecIndex entry;
+    size_t padding = REC_ALIGN(buf->len) - buf->len;
+
+    frame.size = buf->len;
+    frame.kind = kind;
+    frame.time = time;
+
+    if (fwrite(&frame, sizeof(RecFrame), 1, rf->fd) != 1 ||
+        (buf->len && fwrite(buf->data, buf->len, 1, rf->fd) != 1) ||
+        (padding && fwrite(pad, padding, 1, rf->fd) != 1) || fflush(rf->fd))
+        return -1;
+
+    if (kind == REC_KEY && rf->index)
+    {
+        entry.time = time;
+        entry.offset = rf->offset;
+        if (fwrite(&entry, sizeof(RecIndex), 1, rf->index) != 1 || fflush(rf->index))
+            return -1;
+    }
+
+    rf->offset += sizeof(RecFrame) + buf->len + padding;
+    return 0;
+}
+
+    void
+rec_close(RecFilePtr rf)
+{
+    if (rf->index)
+        fclose(rf->index);
+    free(rf);
+}
+
+    static void *
+rec_map_file(const char *path, size_t *size)
+{
+    struct stat st;
+    void *map;
+    int fd;
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0 || fstat(fd, &st) < 0)
+    {
+        if (fd >= 0)
+            close(fd);
+        return NULL;
+    }
+    if (!st.st_size)
+    {
+        close(fd);
+        return NULL;
+    }
+
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return NULL;
+
+    *size = st.st_size;
+    return map;
+}
+
+    const RecHeader *
+rec_map(const char *path, size_t *size)
+{
+    const RecHeader *header;
+
+    header = rec_map_file(path, size);
+    if (!header)
+    {
+        fprintf(stderr, "cannot map %s\n", path);
+        return NULL;
+    }
+
+    if (*size < sizeof(RecHeader) ||
+        memcmp(header->magic, REC_MAGIC, sizeof(header->magic)) || header->version != REC_VERSION)
+    {
+        fprintf(stderr, "%s is not a xinfo record\n", path);
+        munmap((void *)header, *size);
+        return NULL;
+    }
+    if (header->byte_order != SNAP_BYTE_ORDER)
+    {
+        fprintf(stderr, "%s has been written with another byte order\n", path);
+        munmap((void *)header, *size);
+        return NULL;
+    }
+
+    return header;
+}
+
+    void
+rec_unmap(const RecHeader *header, size_t size)
+{
+    munmap((void *)header, size);
+}
+
+/* the frame at offset, NULL past the end or if the frame is cut */
+    static const RecFrame *
+rec_frame_at(const RecHeader *header, size_t size, uint64_t offset)
+{
+    const RecFrame *frame;
+
+    if (offset & 7 || offset > size || size - offset < sizeof(RecFrame))
+        return NULL;
+
+    frame = (const RecFrame *)((const char *)header + offset);
+    if (frame->kind > REC_DELTA || frame->size > size - offset - sizeof(RecFrame))
+        return NULL;
+
+    return frame;
+}
+
+    const RecFrame *
+rec_first(const RecHeader *header, size_t size)
+{
+    return rec_frame_at(header, size, sizeof(RecHeader));
+}
+
+    const RecFrame *
+rec_next(const RecHeader *header, size_t size, const RecFrame *frame)
+{
+    uint64_t offset = (const char *)frame - (const char *)header;
+
+    return rec_frame_at(header, size, offset + sizeof(RecFrame) + REC_ALIGN(frame->size));
+}
+
+/*
+ * The last key frame at or before time, the first frame if there is none.
+ * The index is searched when it matches the record, else the frame headers
+ * are walked, which still skips the decoding of the frames.
+ */
+    const RecFrame *
+rec_seek(const RecHeader *header, size_t size, const char *path, int64_t time)
+{
+    const RecFrame *frame, *key = NULL;
+    const RecIndex *index;
+    char *index_path;
+    size_t index_size = 0;
+    size_t lo, hi, num;
+
+    index_path = malloc(strlen(path) + sizeof(REC_INDEX_SUFFIX));
+    if (!index_path)
+    {
+        fprintf(stderr, " alloc error \n");
+        exit(1);
+    }
+    sprintf(index_path, "%s%s", path, REC_INDEX_SUFFIX);
+    index = rec_map_file(index_path, &index_size);
+    free(index_path);
+
+    if (index)
+    {
+        /* the last entry can be cut, or be written before its frame */
+        num = index_size / sizeof(RecIndex);
+        lo = 0;
+        hi = num;
+        while (lo < hi)
+        {
+            size_t mid = lo + (hi - lo) / 2;
+
+            if (index[mid].time <= time)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        while (lo > 0 && !key)
+        {
+            frame = rec_frame_at(header, size, index[--lo].offset);
+            if (frame && frame->kind == REC_KEY && frame->time == index[lo].time)
+                key = frame;
+        }
+        munmap((void *)index, index_size);
+        if (key)
+            return key;
+    }
+
+    for (frame = rec_first(header, size); frame && frame->time <= time; frame = rec_next(header, size, frame))
+        if (frame->kind == REC_KEY)
+            key = frame;
+
+    return key ? key : rec_first(header, size);
+}
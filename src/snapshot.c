@@ -0,0 +1,371 @@
+/**************************************************************************
+
+xinfo
+
+Copyright 2014-2018 Samsung Electronics co., Ltd. All Rights Reserved.
+
+Contact: SooChan Lim <sc1.lim@samsung.com>
+Contact: Gwan-gyeong Mun <kk.moon@samsung.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sub license, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice (including the
+next paragraph) shall be included in all copies or substantial portions
+of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+**************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <xinfo.h>
+
+/*
+ * Writer and reader of the binary snapshot files, see SnapHeader.
+ */
+
+#define SNAP_MAX_COLUMNS 32
+#define SNAP_ALIGN(x) (((x) + 7) & ~(uint64_t)7)
+
+struct _SnapWriter {
+    uint32_t mode;
+    uint32_t root;
+    uint32_t count;
+    int num_columns;
+    SnapColumn columns[SNAP_MAX_COLUMNS];
+    void *data[SNAP_MAX_COLUMNS];
+
+    /* string table, the interned strings are written once by address */
+    char *strings;
+    size_t strings_size;
+    size_t strings_len;
+    const char **keys;
+    uint32_t *offsets;
+    int size;
+    int num;
+};
+
+    SnapWriterPtr
+snap_writer_new(uint32_t mode, uint32_t root, uint32_t count)
+{
+    SnapWriterPtr sw;
+
+    sw = calloc(1, sizeof(SnapWriter));
+    if (!sw)
+    {
+        fprintf(stderr, " alloc error \n");
+        exit(1);
+    }
+    sw->mode = mode;
+    sw->root = root;
+    sw->count = count;
+
+    return sw;
+}
+
+/*
+ * Add a column of width bytes per row. Returns the zeroed rows to be filled.
+ */
+    void *
+snap_writer_column(SnapWriterPtr sw, uint32_t id, uint32_t width)
+{
+    void *data;
+
+    if (sw->num_columns == SNAP_MAX_COLUMNS)
+    {
+        fprintf(stderr, "too many snapshot columns\n");
+        exit(1);
+    }
+
+    data = calloc(sw->count + 1, width);
+    if (!data)
+    {
+        fprintf(stderr, " alloc error \n");
+        exit(1);
+    }
+
+    sw->columns[sw->num_columns].id = id;
+    sw->columns[sw->num_columns].width = width;
+    sw->data[sw->num_columns++] = data;
+
+    return data;
+}
+
+    static void
+_grow_keys(SnapWriterPtr sw)
+{
+    const char **keys;
+    uint32_t *offsets;
+    int size = sw->size ? sw->size * 2 : 256;
+    int i;
+
+    keys = calloc(size, sizeof(char *));
+    offsets = calloc(size, sizeof(uint32_t));
+    if (!keys || !offsets)
+    {
+        fprintf(stderr, " alloc error \n");
+        exit(1);
+    }
+
+    for (i = 0; i < sw->size; i++)
+    {
+        unsigned int j;
+
+        if (!sw->keys[i])
+            continue;
+        j = ((uintptr_t)sw->keys[i] * 2654435761u) & (size - 1);
+        while (keys[j])
+            j = (j + 1) & (size - 1);
+        keys[j] = sw->keys[i];
+        offsets[j] = sw->offsets[i];
+    }
+
+    free(sw->keys);
+    free(sw->offsets);
+    sw->keys = keys;
+    sw->offsets = offsets;
+    sw->size = size;
+}
+
+/*
+ * Return the offset of str in the string table. The strings of a scan are
+ * interned, so one address is one string.
+ */
+    uint32_t
+snap_writer_string(SnapWriterPtr sw, const char *str)
+{
+    unsigned int i;
+    size_t len;
+
+    if (!str)
+        return SNAP_NO_STRING;
+
+    if ((sw->num + 1) * 2 > sw->size)
+        _grow_keys(sw);
+
+    i = ((uintptr_t)str * 2654435761u) & (sw->size - 1);
+    while (sw->keys[i])
+    {
+        if (sw->keys[i] == str)
+            return sw->offsets[i];
+        i = (i + 1) & (sw->size - 1);
+    }
+
+    len = strlen(str) + 1;
+    if (sw->strings_len + len > sw->strings_size)
+    {
+        sw->strings_size = (sw->strings_len + len) * 2;
+        sw->strings = realloc(sw->strings, sw->strings_size);
+        if (!sw->strings)
+        {
+            fprintf(stderr, " alloc error \n");
+            exit(1);
+        }
+    }
+    memcpy(sw->strings + sw->strings_len, str, len);
+
+    sw->keys[i] = str;
+    sw->offsets[i] = sw->strings_len;
+    sw->num++;
+    sw->strings_len += len;
+
+    return sw->offsets[i];
+}
+
+    static int
+_write_at(FILE *fd, uint64_t *pos, uint64_t offset, const void *data, size_t size)
+{
+    static const char zero[8];
+
+    /* pad up to the aligned offset */
+    if (offset > *pos && fwrite(zero, 1, offset - *pos, fd) != offset - *pos)
+        return -1;
+    if (size && fwrite(data, 1, size, fd) != size)
+        return -1;
+    *pos = offset + size;
+
+    return 0;
+}
+
+/*
+ * Write the snapshot to fd. Returns 0 on success.
+ */
+    int
+snap_writer_save(SnapWriterPtr sw, FILE *fd)
+{
+    SnapHeader header;
+    uint64_t offset, pos = 0;
+    int i;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAP_MAGIC, sizeof(header.magic));
+    header.version = SNAP_VERSION;
+    header.byte_order = SNAP_BYTE_ORDER;
+    header.mode = sw->mode;
+    header.count = sw->count;
+    header.time = time(NULL);
+    header.root = sw->root;
+    header.num_columns = sw->num_columns;
+
+    offset = SNAP_ALIGN(sizeof(SnapHeader) + sw->num_columns * sizeof(SnapColumn));
+    for (i = 0; i < sw->num_columns; i++)
+    {
+        sw->columns[i].offset = offset;
+        offset = SNAP_ALIGN(offset + (uint64_t)sw->count * sw->columns[i].width);
+    }
+    header.strings = offset;
+    header.strings_size = sw->strings_len;
+
+    if (_write_at(fd, &pos, 0, &header, sizeof(header)) ||
+        _write_at(fd, &pos, pos, sw->columns, sw->num_columns * sizeof(SnapColumn)))
+        return -1;
+
+    for (i = 0; i < sw->num_columns; i++)
+        if (_write_at(fd, &pos, sw->columns[i].offset, sw->data[i], (size_t)sw->count * sw->columns[i].width))
+            return -1;
+
+    if (_write_at(fd, &pos, header.strings, sw->strings, sw->strings_len))
+        return -1;
+
+    return fflush(fd) ? -1 : 0;
+}
+
+    void
+snap_writer_free(SnapWriterPtr sw)
+{
+    int i;
+
+    for (i = 0; i < sw->num_columns; i++)
+        free(sw->data[i]);
+    free(sw->strings);
+    free(sw->keys);
+    free(sw->offsets);
+    free(sw);
+}
+
+/*
+ * Map a snapshot file and check its layout. Returns NULL with a message if
+ * the file is not a valid snapshot.
+ */
+    const SnapHeader *
+snap_map(const char *path, size_t *size)
+{
+    const SnapHeader *header;
+    struct stat st;
+    void *map;
+    uint32_t i;
+    int fd;
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0 || fstat(fd, &st) < 0)
+    {
+        fprintf(stderr, "cannot open %s\n", path);
+        if (fd >= 0)
+            close(fd);
+        return NULL;
+    }
+
+    if ((size_t)st.st_size < sizeof(SnapHeader))
+    {
+        fprintf(stderr, "%s is not a xinfo snapshot\n", path);
+        close(fd);
+        return NULL;
+    }
+
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        fprintf(stderr, "cannot map %s\n", path);
+        return NULL;
+    }
+    header = map;
+    *size = st.st_size;
+
+    if (memcmp(header->magic, SNAP_MAGIC, sizeof(header->magic)) || header->version != SNAP_VERSION)
+    {
+        fprintf(stderr, "%s is not a xinfo snapshot\n", path);
+        goto fail;
+    }
+    if (header->byte_order != SNAP_BYTE_ORDER)
+    {
+        fprintf(stderr, "%s has been written with another byte order\n", path);
+        goto fail;
+    }
+
+    /* every column and the string table must lie in the file */
+    if (sizeof(SnapHeader) + (uint64_t)header->num_columns * sizeof(SnapColumn) > *size ||
+        header->strings > *size || header->strings_size > *size - header->strings ||
+        (header->strings_size && ((const char *)map)[header->strings + header->strings_size - 1]))
+    {
+        fprintf(stderr, "%s is truncated\n", path);
+        goto fail;
+    }
+    for (i = 0; i < header->num_columns; i++)
+    {
+        const SnapColumn *col = &header->columns[i];
+
+        if (col->offset > *size || (col->offset & 7) ||
+            (uint64_t)col->width * header->count > *size - col->offset)
+        {
+            fprintf(stderr, "%s is truncated\n", path);
+            goto fail;
+        }
+    }
+
+    return header;
+
+fail:
+    munmap(map, *size);
+    return NULL;
+}
+
+/*
+ * Return the rows of the column id, NULL if the snapshot has no such column
+ * of this width.
+ */
+    const void *
+snap_column(const SnapHeader *header, uint32_t id, uint32_t width)
+{
+    uint32_t i;
+
+    for (i = 0; i < header->num_columns; i++)
+        if (header->columns[i].id == id && header->columns[i].width == width)
+            return (const char *)header + header->columns[i].offset;
+
+    return NULL;
+}
+
+    const char *
+snap_string(const SnapHeader *header, uint32_t offset)
+{
+    if (offset == SNAP_NO_STRING || offset >= header->strings_size)
+        return NULL;
+
+    return (const char *)header + header->strings + offset;
+}
+
+    void
+snap_unmap(const SnapHeader *header, size_t size)
+{
+    munmap((void *)header, size);
+}
@@ -29,18 +29,28 @@
  **************************************************************************/
 
 #include <X11/Xlib.h>
+#include <X11/Xlib-xcb.h>
 #include <X11/Xutil.h>
+#include <X11/Xregion.h>
+#include <X11/extensions/Xdamage.h>
+#include <X11/extensions/XTest.h>
 #include <X11/Xatom.h>
 #include <X11/Xos.h>
+#include <xcb/shape.h>
+#include <xcb/res.h>
 #ifndef NO_I18N
 #include <X11/Xlocale.h>
 #endif
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
+#include <limits.h>
 #include <unistd.h>
 #include <xinfo.h>
-#include <wait.h>
+#include <poll.h>
+#include <time.h>
+#include <signal.h>
+#include <sys/wait.h>
 
 
 static void Display_Window_Id(FILE* fd, Window window, Bool newline_wanted);
@@ -48,6 +58,7 @@ static void Display_Pointed_Window_Info(FILE* fd);
 static void Display_Focused_Window_Info(FILE* fd);
 
 Display *dpy;
+xcb_connection_t *xcb_conn;
 Atom prop_pid;
 Atom prop_c_pid;
 Atom prop_class;
@@ -70,10 +81,12 @@ Atom prop_wm_type_combo;
 Atom prop_wm_type_dnd;
 
 Atom prop_level;
+Atom prop_user_created_win;
+Atom prop_wm_protocols;
+Atom prop_net_wm_ping;
 
 int      screen = 0;
 static const char *window_id_format = "0x%lx";
-static int win_cnt = 0;
 
 
 typedef struct {
@@ -87,9 +100,13 @@ static const binding _map_states[] = {
     { IsViewable, "IsViewable" },
     { 0, 0 } };
 
+static const binding _screen_states[] = {
+    { XINFO_SCREEN_ON, "on" },
+    { XINFO_SCREEN_PARTIAL, "partial" },
+    { XINFO_SCREEN_OFF, "off" },
+    { 0, 0 } };
+
 typedef struct  _Wininfo {
-    struct _Wininfo *prev, *next;
-    int idx;
     /*" PID   WinID     w  h Rel_x Rel_y Abs_x Abs_y Depth          WinName      App_Name*/
     long pid;
     Window winid;
@@ -103,13 +120,43 @@ typedef struct  _Wininfo {
     unsigned int depth;
     char type[8];
     char level[4];
-    char *winname;
-    char *appname;
-    char *appname_brief;
-    char *map_state;
-    char *ping_result;
+    const char *winname;        /* the strings are interned in a StrArena */
+    const char *appname;
+    const char *appname_brief;
+    const char *map_state;
+    const char *ping_result;
+    long ping_rtt; /* round trip time of _NET_WM_PING in usec, -1 if no reply */
+    int vis_x;                  /* the part on the screen, in root coordinates */
+    int vis_y;
+    int vis_w;
+    int vis_h;
+    int screen_state;           /* XINFO_SCREEN */
 } Wininfo, *WininfoPtr;
 
+/*
+ * Map of XIDs to records, open addressing with linear probing.
+ */
+typedef struct _XidMap {
+    Window *keys;   /* 0 : free slot */
+    void **vals;
+    int size;       /* power of two */
+    int num;
+} XidMap;
+
+/*
+ * The windows of a scan : one contiguous array addressed by index, with the
+ * border and the client window ids mapped to the records. All the strings of
+ * the scan are released with the table.
+ */
+typedef struct _WininfoTable {
+    Wininfo *wins;
+    int num;
+    int size;
+    XidMap map;
+    StrArena strings;
+    ProcUsage *usage;   /* loaded from a snapshot file, NULL : from /proc */
+} WininfoTable;
+
 /*
  * Standard fatal error routine - call like printf
  * Does not require dpy or screen defined.
@@ -217,328 +264,395 @@ Display_Window_Id(FILE* fd, Window window, Bool newline_wanted)
     return;
 }
 
+/*
+ * The window information is gathered with XCB cookies on the Xlib connection.
+ * All requests for all windows are sent first and the replies are collected
+ * afterwards, so a scan costs about one round trip instead of one per request.
+ */
+typedef struct _WininfoCookies {
+    xcb_get_property_cookie_t pid;
+    xcb_get_property_cookie_t c_pid;
+    xcb_get_geometry_cookie_t geometry;
+    xcb_query_tree_cookie_t tree;           /* the parent of the window */
+    xcb_get_geometry_cookie_t ancestor;     /* the frame, then the parent */
+    xcb_get_property_cookie_t type;
+    xcb_get_property_cookie_t level;
+    xcb_get_property_cookie_t name;
+    xcb_get_property_cookie_t wm_class;
+
+    /* the walk to the root, in the coordinates of the inside of parent */
+    Window parent;
+    int off_x, off_y;
+    int clip_x, clip_y, clip_w, clip_h;
+    int outer_w, outer_h;
+} WininfoCookies;
+
+static xcb_get_property_cookie_t
+_send_get_property(Window win, Atom atom, Atom type, unsigned int len)
+{
+    return xcb_get_property(xcb_conn, 0, win, atom, type, 0, len);
+}
+
+static xcb_get_property_reply_t *
+_get_property_reply(xcb_get_property_cookie_t cookie)
+{
+    xcb_generic_error_t *err = NULL;
+    xcb_get_property_reply_t *reply;
+
+    /* the window can be destroyed while the scan is running */
+    reply = xcb_get_property_reply(xcb_conn, cookie, &err);
+    if (err)
+        free(err);
+
+    return reply;
+}
+
 static int
-_get_window_property(Display *dpy, Window win, Atom atom, Atom type, unsigned int *val, unsigned int len)
+_get_property_card32(xcb_get_property_reply_t *reply, Atom type, unsigned int *val)
 {
-    unsigned char *prop_ret;
-    Atom type_ret;
-    unsigned long bytes_after, num_ret;
-    int format_ret;
-    unsigned int i;
-    int num;
+    if (!reply)
+        return -1;
 
-    prop_ret = NULL;
-    if (XGetWindowProperty(dpy, win, atom, 0, 0x7fffffff, False,
-                           type, &type_ret, &format_ret, &num_ret,
-                           &bytes_after, &prop_ret) != Success) {
+    if (reply->type != type || reply->format != 32)
         return -1;
-    }
 
-    if (type_ret != type || format_ret != 32) {
-        num = -1;
-    } else if (num_ret == 0 || !prop_ret) {
-        num = 0;
-    } else {
-        if (num_ret < len)
-            len = num_ret;
-        for (i = 0; i < len; i++)
-            val[i] = ((unsigned long *)prop_ret)[i];
-        num = len;
-    }
+    if (xcb_get_property_value_length(reply) < (int)sizeof(uint32_t))
+        return 0;
 
-    if (prop_ret)
-        XFree(prop_ret);
+    *val = *(uint32_t *)xcb_get_property_value(reply);
 
-    return num;
+    return 1;
 }
 
 
-    static WininfoPtr
-alloc_wininfo()
+    static unsigned int
+_xid_hash(Window xid)
 {
-    WininfoPtr wininfo;
-    wininfo = (WininfoPtr) malloc(sizeof(Wininfo));
-    if(!wininfo)
-    {
-        fprintf(stderr, " alloc error \n");
-        exit(1);
-    }
-    wininfo->idx = win_cnt++;
-    wininfo->next = NULL;
-    wininfo->prev = NULL;
-    return wininfo;
+    return (unsigned int)xid * 2654435761u;
 }
 
-    static void
-free_wininfo(WininfoPtr wininfo)
+    static void *
+xidmap_find(XidMap *map, Window xid)
 {
-    WininfoPtr w;
-    /* TODO : free winname and appname map_state*/
-    w = wininfo;
-    while(1)
-    {
+    unsigned int i;
 
-        if(w && w->next)
-            w = w->next;
-        else
-            break;
+    if (!map->size || !xid)
+        return NULL;
 
-    }
+    for (i = _xid_hash(xid) & (map->size - 1); map->keys[i]; i = (i + 1) & (map->size - 1))
+        if (map->keys[i] == xid)
+            return map->vals[i];
 
-    while(1)
-    {
-        if(w && w->prev)
-        {
-            w = w->prev;
-            if(w && w->next)
-                free(w->next);
-        }
-        else
-        {
-            if(w)
-                free(w);
-            break;
-        }
-    }
+    return NULL;
 }
 
+    static void
+_xidmap_insert(Window *keys, void **vals, int size, Window xid, void *val)
+{
+    unsigned int i = _xid_hash(xid) & (size - 1);
+
+    while (keys[i] && keys[i] != xid)
+        i = (i + 1) & (size - 1);
 
+    keys[i] = xid;
+    vals[i] = val;
+}
 
     static void
-get_winname(Window window, char* str)
+xidmap_put(XidMap *map, Window xid, void *val)
 {
-    XTextProperty tp;
-    Atom actual_type;
-    int actual_format;
-    unsigned long nitems, bytes_after;
-    char *class_name = NULL;
-
+    if (!xid)
+        return;
 
-    if (window)
+    if ((map->num + 1) * 2 > map->size)
     {
-        if (window == RootWindow(dpy, screen))
-        {
-            printf(" (the root window)");
-        }
+        int size = map->size ? map->size * 2 : 64;
+        Window *keys = calloc(size, sizeof(Window));
+        void **vals = calloc(size, sizeof(void *));
+        int i;
 
-        if (XGetWMName(dpy, window, &tp))
+        if (!keys || !vals)
         {
-            if (tp.nitems > 0)
-            {
-                int count = 0, i, ret;
-                char **list = NULL;
-                ret = XmbTextPropertyToTextList(dpy, &tp, &list, &count);
-                if((ret == Success || ret > 0) && list != NULL)
-                {
-                    for(i=0; i<count; i++)
-                        snprintf(str, 255, "%s", *list);
-                    XFreeStringList(list);
-                }
-            }
+            fprintf(stderr, " alloc error \n");
+            exit(1);
         }
-        else if (XGetWindowProperty(dpy, window, prop_class,
-                    0, 10000000L,
-                    False, AnyPropertyType,
-                    &actual_type, &actual_format, &nitems,
-                    &bytes_after, (unsigned char **)&class_name) == Success
-                && nitems && class_name != NULL)
-        {
-            strncpy(str, class_name, strlen(class_name)+1);
-            if(class_name)
-            {
-                XFree(class_name);
-                class_name = NULL;
-            }
 
+        for (i = 0; i < map->size; i++)
+            if (map->keys[i])
+                _xidmap_insert(keys, vals, size, map->keys[i], map->vals[i]);
 
-        }
+        free(map->keys);
+        free(map->vals);
+        map->keys = keys;
+        map->vals = vals;
+        map->size = size;
     }
+
+    if (!xidmap_find(map, xid))
+        map->num++;
+    _xidmap_insert(map->keys, map->vals, map->size, xid, val);
 }
 
     static void
-get_appname_brief(char* brief)
+xidmap_del(XidMap *map, Window xid)
 {
-    char delim[] = "/";
-    char *token = NULL;
-    char temp[255] = {0,};
-    char *saveptr = NULL;
+    unsigned int mask = map->size - 1;
+    unsigned int i, j, k;
 
-    token = strtok_r(brief, delim, &saveptr);
-    while (token != NULL) {
-        memset(temp, 0x00, 255*sizeof(char));
-        strncpy(temp, token, 254*sizeof(char));
+    if (!map->size || !xid)
+        return;
 
-        token = strtok_r(NULL, delim, &saveptr);
+    for (i = _xid_hash(xid) & mask; map->keys[i] != xid; i = (i + 1) & mask)
+        if (!map->keys[i])
+            return;
+
+    /* shift back the following entries of the cluster which belong before the hole */
+    for (j = (i + 1) & mask; map->keys[j]; j = (j + 1) & mask)
+    {
+        k = _xid_hash(map->keys[j]) & mask;
+        if ((j > i && (k <= i || k > j)) || (j < i && k <= i && k > j))
+        {
+            map->keys[i] = map->keys[j];
+            map->vals[i] = map->vals[j];
+            i = j;
+        }
     }
 
-    snprintf(brief, sizeof(temp), "%s", temp);
+    map->keys[i] = 0;
+    map->num--;
 }
 
     static void
-get_appname_from_pid(long pid, char* str)
+xidmap_free(XidMap *map)
 {
-    FILE* fp;
-    int len;
-    long app_pid = pid;
-    char fn_cmdline[255] = {0,};
-    char cmdline[255] = {0,};
+    free(map->keys);
+    free(map->vals);
+    memset(map, 0, sizeof(XidMap));
+}
 
-    snprintf(fn_cmdline, sizeof(fn_cmdline), "/proc/%ld/cmdline",app_pid);
+    static WininfoPtr
+wininfo_table_add(WininfoTable *table, Window border, Window client)
+{
+    WininfoPtr w;
+    int i;
 
-    fp = fopen(fn_cmdline, "r");
-    if(fp==0)
+    if (table->num == table->size)
     {
-        fprintf(stderr,"cannot file open /proc/%ld/cmdline", app_pid);
-        exit(1);
-    }
-    if (!fgets(cmdline, 255, fp)) {
-        fprintf(stderr, "fail to get appname for pid(%ld)\n", app_pid);
-        fclose(fp);
-        exit(1);
-    }
-    fclose(fp);
-
-    len = strlen(cmdline);
-    if(len < 1)
-        memset(cmdline, 0x00,255);
-    else
-        cmdline[len] = 0;
+        Wininfo *wins;
 
-#if 0
-    if(strstr(cmdline, "app-domain") != NULL)
-    {
-        char temp_buf[255] = {0,};
-        char* buf = NULL;
-        memset(fn_cmdline, 0x00, 255);
-        sprintf(fn_cmdline, "/proc/%ld/maps", app_pid);
-        fp = fopen(fn_cmdline, "r");
-        if(fp==0)
+        table->size = table->size ? table->size * 2 : 64;
+        wins = realloc(table->wins, table->size * sizeof(Wininfo));
+        if (!wins)
         {
-            fprintf(stderr,"cannot file open /proc/%ld/maps", app_pid);
+            fprintf(stderr, " alloc error \n");
             exit(1);
         }
 
-        while(!feof(fp))
+        /* the records moved */
+        if (wins != table->wins)
         {
-            fgets(temp_buf, 255, fp);
-            if(!(buf = strstr(temp_buf, "/com.samsung")))
-                continue;
-            if(buf != NULL) {
-                buf = strstr(buf, "/lib");
-                if(buf != NULL) {
-                    if(buf[strlen(buf)-1] == '\n')
-                        buf[strlen(buf)-4] = 0;
-                    buf += 8;
-                    memset(cmdline, 0x00, 255);
-                    strncpy(cmdline, buf, strlen(buf)+1);
-                }
+            xidmap_free(&table->map);
+            for (i = 0; i < table->num; i++)
+            {
+                xidmap_put(&table->map, wins[i].BDid, &wins[i]);
+                xidmap_put(&table->map, wins[i].winid, &wins[i]);
             }
-            break;
         }
-
-        fclose(fp);
+        table->wins = wins;
     }
-#endif
-    snprintf(str, sizeof(cmdline), "%s", cmdline);
+
+    w = &table->wins[table->num++];
+    memset(w, 0, sizeof(Wininfo));
+    w->BDid = border;
+    w->winid = client;
+    w->ping_rtt = -1;
+
+    xidmap_put(&table->map, border, w);
+    xidmap_put(&table->map, client, w);
+
+    return w;
 }
 
-static int
-init_atoms(void)
+    static void
+wininfo_table_free(WininfoTable *table)
+{
+    free(table->wins);
+    xidmap_free(&table->map);
+    arena_release(&table->strings);
+    memset(table, 0, sizeof(WininfoTable));
+}
+
+/*
+ * Long running modes : the strings of the windows which are gone stay in the
+ * arena, so the strings of the live windows are moved to a new arena once
+ * most of the arena is garbage.
+ */
+#define ARENA_SLACK 65536
+
+    static void
+compact_strings(StrArena *strings, WininfoPtr *wins, int count)
 {
-    prop_wm_type = XInternAtom(dpy, "_NET_WM_WINDOW_TYPE", False);
-    if (!prop_wm_type) return 0;
+    StrArena fresh;
+    size_t live = 0;
+    int i;
+
+    for (i = 0; i < count; i++)
+    {
+        live += wins[i]->winname ? strlen(wins[i]->winname) + 1 : 0;
+        live += wins[i]->appname ? strlen(wins[i]->appname) + 1 : 0;
+        live += wins[i]->appname_brief ? strlen(wins[i]->appname_brief) + 1 : 0;
+    }
+
+    if (strings->used < 2 * live + ARENA_SLACK)
+        return;
 
-    prop_wm_type_desktop = XInternAtom(dpy, "_NET_WM_WINDOW_TYPE_DESKTOP", False);
-    if (!prop_wm_type_desktop) return 0;
+    memset(&fresh, 0, sizeof(StrArena));
+    for (i = 0; i < count; i++)
+    {
+        wins[i]->winname = arena_strdup(&fresh, wins[i]->winname);
+        wins[i]->appname = arena_strdup(&fresh, wins[i]->appname);
+        wins[i]->appname_brief = arena_strdup(&fresh, wins[i]->appname_brief);
+    }
 
-    prop_wm_type_dock = XInternAtom(dpy, "_NET_WM_WINDOW_TYPE_DOCK", False);
-    if (!prop_wm_type_dock) return 0;
+    arena_release(strings);
+    *strings = fresh;
+}
 
-    prop_wm_type_toolbar = XInternAtom(dpy, "_NET_WM_WINDOW_TYPE_TOOLBAR", False);
-    if (!prop_wm_type_toolbar) return 0;
+    static void
+get_winname(xcb_get_property_reply_t *name, xcb_get_property_reply_t *wm_class, char* str)
+{
+    XTextProperty tp;
+    int len;
 
-    prop_wm_type_menu = XInternAtom(dpy, "_NET_WM_WINDOW_TYPE_MENU", False);
-    if (!prop_wm_type_menu) return 0;
+    if (name && name->type != None)
+    {
+        len = xcb_get_property_value_length(name);
+        if (len > 0)
+        {
+            int count = 0, ret;
+            char **list = NULL;
 
-    prop_wm_type_utility = XInternAtom(dpy, "_NET_WM_WINDOW_TYPE_UTILITY", False);
-    if (!prop_wm_type_utility) return 0;
+            tp.value = (unsigned char *)xcb_get_property_value(name);
+            tp.encoding = name->type;
+            tp.format = name->format;
+            tp.nitems = name->value_len;
 
-    prop_wm_type_splash = XInternAtom(dpy, "_NET_WM_WINDOW_TYPE_SPLASH", False);
-    if (!prop_wm_type_splash) return 0;
+            ret = XmbTextPropertyToTextList(dpy, &tp, &list, &count);
+            if((ret == Success || ret > 0) && list != NULL)
+            {
+                if (count > 0)
+                    snprintf(str, 255, "%s", *list);
+                XFreeStringList(list);
+            }
+        }
+    }
+    else if (wm_class && wm_class->type != None)
+    {
+        len = xcb_get_property_value_length(wm_class);
+        if (len > 0)
+            snprintf(str, 255, "%.*s", len, (char *)xcb_get_property_value(wm_class));
+    }
+}
 
-    prop_wm_type_dialog = XInternAtom(dpy, "_NET_WM_WINDOW_TYPE_DIALOG", False);
-    if (!prop_wm_type_dialog) return 0;
+    static void
+get_appname_brief(char* brief)
+{
+    char delim[] = "/";
+    char *token = NULL;
+    char temp[255] = {0,};
+    char *saveptr = NULL;
 
-    prop_wm_type_normal = XInternAtom(dpy, "_NET_WM_WINDOW_TYPE_NORMAL", False);
-    if (!prop_wm_type_normal) return 0;
+    token = strtok_r(brief, delim, &saveptr);
+    while (token != NULL) {
+        memset(temp, 0x00, 255*sizeof(char));
+        strncpy(temp, token, 254*sizeof(char));
 
-    prop_wm_type_dropdown_menu = XInternAtom(dpy, "_NET_WM_WINDOW_TYPE_DROPDOWN_MENU", False);
-    if (!prop_wm_type_dropdown_menu) return 0;
+        token = strtok_r(NULL, delim, &saveptr);
+    }
 
-    prop_wm_type_popup_menu = XInternAtom(dpy, "_NET_WM_WINDOW_TYPE_POPUP_MENU", False);
-    if (!prop_wm_type_popup_menu) return 0;
+    snprintf(brief, sizeof(temp), "%s", temp);
+}
 
-    prop_wm_type_tooltip = XInternAtom(dpy, "_NET_WM_WINDOW_TYPE_TOOLTIP", False);
-    if (!prop_wm_type_tooltip) return 0;
+/*
+ * All the atoms used by xinfo, interned at once with XInternAtoms.
+ * type_name : the short name of a _NET_WM_WINDOW_TYPE in the output.
+ */
+typedef struct {
+    const char *name;
+    Atom *atom;
+    const char *type_name;
+} atom_binding;
+
+static const atom_binding _atoms[] = {
+    { "_NET_WM_PID", &prop_pid, NULL },
+    { "X_CLIENT_PID", &prop_c_pid, NULL },
+    { "WM_CLASS", &prop_class, NULL },
+    { "WM_COMMAND", &prop_command, NULL },
+    { "WM_PROTOCOLS", &prop_wm_protocols, NULL },
+    { "_NET_WM_PING", &prop_net_wm_ping, NULL },
+    { "_E_USER_CREATED_WINDOW", &prop_user_created_win, NULL },
+    { "_E_ILLUME_NOTIFICATION_LEVEL", &prop_level, NULL },
+    { "_NET_WM_WINDOW_TYPE", &prop_wm_type, NULL },
+    { "_NET_WM_WINDOW_TYPE_NORMAL", &prop_wm_type_normal, "Normal " },
+    { "_NET_WM_WINDOW_TYPE_NOTIFICATION", &prop_wm_type_notification, "Notific" },
+    { "_NET_WM_WINDOW_TYPE_UTILITY", &prop_wm_type_utility, "Utility" },
+    { "_NET_WM_WINDOW_TYPE_DIALOG", &prop_wm_type_dialog, "Dialog " },
+    { "_NET_WM_WINDOW_TYPE_POPUP_MENU", &prop_wm_type_popup_menu, "Popup M" },
+    { "_NET_WM_WINDOW_TYPE_DOCK", &prop_wm_type_dock, "Dock   " },
+    { "_NET_WM_WINDOW_TYPE_DESKTOP", &prop_wm_type_desktop, "Desktop" },
+    { "_NET_WM_WINDOW_TYPE_TOOLBAR", &prop_wm_type_toolbar, "Toolbar" },
+    { "_NET_WM_WINDOW_TYPE_MENU", &prop_wm_type_menu, "Menu   " },
+    { "_NET_WM_WINDOW_TYPE_SPLASH", &prop_wm_type_splash, "Splash " },
+    { "_NET_WM_WINDOW_TYPE_DROPDOWN_MENU", &prop_wm_type_dropdown_menu, "Dropdow" },
+    { "_NET_WM_WINDOW_TYPE_TOOLTIP", &prop_wm_type_tooltip, "Tooltip" },
+    { "_NET_WM_WINDOW_TYPE_COMBO", &prop_wm_type_combo, "Combo  " },
+    { "_NET_WM_WINDOW_TYPE_DND", &prop_wm_type_dnd, "Dnd    " },
+    { NULL, NULL, NULL } };
+
+#define NUM_ATOMS (sizeof(_atoms) / sizeof(_atoms[0]) - 1)
 
-    prop_wm_type_notification = XInternAtom(dpy, "_NET_WM_WINDOW_TYPE_NOTIFICATION", False);
-    if (!prop_wm_type_notification) return 0;
+static int
+init_atoms(void)
+{
+    char *names[NUM_ATOMS];
+    Atom atoms[NUM_ATOMS];
+    unsigned int i;
 
-    prop_wm_type_combo = XInternAtom(dpy, "_NET_WM_WINDOW_TYPE_COMBO", False);
-    if (!prop_wm_type_combo) return 0;
+    for (i = 0; i < NUM_ATOMS; i++)
+        names[i] = (char *)_atoms[i].name;
 
-    prop_wm_type_dnd = XInternAtom(dpy, "_NET_WM_WINDOW_TYPE_DND", False);
-    if (!prop_wm_type_dnd) return 0;
+    /* one round trip for all the atoms */
+    if (!XInternAtoms(dpy, names, NUM_ATOMS, False, atoms))
+        return 0;
 
-    prop_level = XInternAtom(dpy, "_E_ILLUME_NOTIFICATION_LEVEL", False);
-    if (!prop_level) return 0;
+    for (i = 0; i < NUM_ATOMS; i++)
+        *_atoms[i].atom = atoms[i];
 
     return 1;
 }
 
-static char*
+static const char*
 get_type_name(Atom atom)
 {
-    if (atom == prop_wm_type_normal)
-        return "Normal ";
-    else if (atom == prop_wm_type_notification)
-        return "Notific";
-    else if (atom == prop_wm_type_utility)
-        return "Utility";
-    else if (atom == prop_wm_type_dialog)
-        return "Dialog ";
-    else if (atom == prop_wm_type_popup_menu)
-        return "Popup M";
-    else if (atom == prop_wm_type_dock)
-        return "Dock   ";
-    else if (atom == prop_wm_type_desktop)
-        return "Desktop";
-    else if (atom == prop_wm_type_toolbar)
-        return "Toolbar";
-    else if (atom == prop_wm_type_menu)
-        return "Menu   ";
-    else if (atom == prop_wm_type_splash)
-        return "Splash ";
-    else if (atom == prop_wm_type_dropdown_menu)
-        return "Dropdow";
-    else if (atom == prop_wm_type_tooltip)
-        return "Tooltip";
-    else if (atom == prop_wm_type_combo)
-        return "Combo  ";
-    else if (atom == prop_wm_type_dnd)
-        return "Dnd    ";
-    else
-        return "Unknown";
+    const atom_binding *table;
+
+    for (table = _atoms; table->name; table++)
+    {
+        if (table->type_name && *table->atom == atom)
+            return table->type_name;
+    }
+
+    return "Unknown";
 }
 
 static void
-get_type(Window win, char* type)
+get_type(xcb_get_property_reply_t *reply, char* type)
 {
     int ret;
-    char *type_name = NULL;
-    Atom win_type = 0;
+    const char *type_name = NULL;
+    unsigned int win_type = 0;
 
-    ret = _get_window_property(dpy, win, prop_wm_type, XA_ATOM, (unsigned int*)&win_type, 1);
+    ret = _get_property_card32(reply, XA_ATOM, &win_type);
     if (ret < 1)
         win_type = 0;
 
@@ -548,12 +662,12 @@ get_type(Window win, char* type)
 }
 
 static void
-get_level(Window win, char* level)
+get_level(xcb_get_property_reply_t *reply, char* level)
 {
     int ret;
     unsigned int val = 0;
 
-    ret = _get_window_property(dpy, win, prop_level, XA_CARDINAL, &val, 1);
+    ret = _get_property_card32(reply, XA_CARDINAL, &val);
     if (ret < 1)
         val = 0;
 
@@ -615,69 +729,172 @@ Lookup(int code, const binding *table)
     return LookupL((long)code, table);
 }
 
+/* NULL if the screen state is unknown */
+    static const char *
+screen_state_name(int state)
+{
+    if (state < XINFO_SCREEN_ON || state > XINFO_SCREEN_OFF)
+        return NULL;
+    return Lookup(state, _screen_states);
+}
+
+/*
+ * _NET_WM_PING is sent to every window at once. Each ping carries its own
+ * timestamp in data.l[1] and the window in data.l[2], which the client echoes
+ * back to the root window, so every reply is matched to the window that
+ * was pinged and all the windows share a single deadline.
+ */
+static Time ping_serial = 0;
+
+    static long
+_elapsed_usec(struct timespec *from, struct timespec *to)
+{
+    return (to->tv_sec - from->tv_sec) * 1000000L + (to->tv_nsec - from->tv_nsec) / 1000L;
+}
+
+    static void
+Send_Ping_to_Window(Window window, Time timestamp)
+{
+    XClientMessageEvent xclient;
+
+    memset (&xclient, 0, sizeof (xclient));
+    xclient.type = ClientMessage;
+    xclient.window = window;
+    xclient.message_type = prop_wm_protocols;
+    xclient.format = 32;
+    xclient.data.l[0] = prop_net_wm_ping;
+    xclient.data.l[1] = timestamp;
+    xclient.data.l[2] = window;
+
+    XSendEvent (dpy, window, 0, None, (XEvent *)&xclient);
+}
+
+/*
+ * Send a ping to all windows of the list. Returns the timestamp of the first
+ * ping, the ping of wins[i] carries (base + i).
+ */
+    static Time
+send_pings(WininfoPtr *wins, int count, struct timespec *sent)
+{
+    Time base;
+    int i;
+
+    if (!ping_serial)
+    {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        ping_serial = (Time)(now.tv_sec * 1000 + now.tv_nsec / 1000000) & 0xffffffff;
+    }
+
+    base = ping_serial;
+    ping_serial = (ping_serial + count) & 0xffffffff;
+    if (!ping_serial)
+        ping_serial = 1;
+
+    for (i = 0; i < count; i++)
+    {
+        wins[i]->ping_rtt = -1;
+        clock_gettime(CLOCK_MONOTONIC, &sent[i]);
+        Send_Ping_to_Window(wins[i]->winid, (base + i) & 0xffffffff);
+    }
+    XFlush(dpy);
+
+    return base;
+}
+
+/*
+ * Get the next event, waiting until timeout (msec) from start expired.
+ * Returns 0 on timeout.
+ */
     static int
-get_map_status(Window window)
+_next_event(XEvent *e, struct timespec *start, long timeout)
 {
-    XWindowAttributes win_attributes;
+    struct timespec now;
+    struct pollfd pfd;
+    long remain;
 
-    if (!XGetWindowAttributes(dpy, window, &win_attributes))
-        printf("Can't get window attributes.");
+    pfd.fd = ConnectionNumber(dpy);
+    pfd.events = POLLIN;
 
-    if( win_attributes.map_state == 0 )
-        return 0;
-    else
-        return win_attributes.map_state;
+    while (!XPending(dpy))
+    {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        remain = timeout - _elapsed_usec(start, &now) / 1000;
+        if (remain <= 0)
+            return 0;
+        poll(&pfd, 1, remain);
+    }
+
+    XNextEvent(dpy, e);
+    return 1;
 }
 
-static int Ping_Event_Loop()
+/*
+ * Wait for the replies of the pings sent by send_pings() until every window
+ * answered or timeout (msec) expired. The other events are passed to handler.
+ * Returns the number of replies.
+ */
+    static int
+collect_pings(WininfoPtr *wins, int count, Time base, struct timespec *sent, long timeout,
+              void (*handler)(XEvent *e))
 {
+    struct timespec start, now;
     XEvent e;
+    int replied = 0;
+    unsigned int idx;
 
-    while (XPending (dpy)) {
-        XFlush( dpy );
-        XNextEvent(dpy, &e);
-        /* draw or redraw the window */
-        if (e.type == Expose) {
-            fprintf(stderr," Expose \n");
-        }
-        /* exit on key press */
-        if (e.type == KeyPress) {
-            fprintf(stderr,"  KeyPress  \n");
-            break;
-        }
-        if (e.type ==  ClientMessage ) {
-            return 1;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (replied < count && _next_event(&e, &start, timeout))
+    {
+        if (e.type != ClientMessage ||
+            e.xclient.message_type != prop_wm_protocols ||
+            (Atom)e.xclient.data.l[0] != prop_net_wm_ping)
+        {
+            if (handler)
+                handler(&e);
+            continue;
         }
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+
+        /* match the reply to the window it was sent to */
+        idx = ((unsigned long)e.xclient.data.l[1] - base) & 0xffffffff;
+        if (idx >= (unsigned int)count)
+            continue;
+        if (wins[idx]->winid != (Window)e.xclient.data.l[2] || wins[idx]->ping_rtt >= 0)
+            continue;
+
+        wins[idx]->ping_rtt = _elapsed_usec(&sent[idx], &now);
+        replied++;
     }
-    return 0;
+
+    return replied;
 }
 
     static void
-Send_Ping_to_Window(Window window)
+ping_wininfo(WininfoPtr *wins, int count, long timeout)
 {
-    XClientMessageEvent xclient;
-    Display* display = dpy;
-
-    memset (&xclient, 0, sizeof (xclient));
-    xclient.type = ClientMessage;
-    xclient.window = window;
+    struct timespec *sent;
+    Time base;
+    int i;
 
-    xclient.message_type = XInternAtom (display, "WM_PROTOCOLS",0);
+    sent = calloc(count, sizeof(struct timespec));
+    if (!sent)
+    {
+        fprintf(stderr, " alloc error \n");
+        exit(1);
+    }
 
-    xclient.format = 32;
+    base = send_pings(wins, count, sent);
+    collect_pings(wins, count, base, sent, timeout, NULL);
 
-    xclient.data.l[0] = XInternAtom (display, "_NET_WM_PING",0);
-    xclient.data.l[1] = 0;
-    //    fprintf(stderr,"<0x%x>\n", window);
-    XSendEvent (display, window, 0,
-            None,
-            (XEvent *)&xclient);
-    XFlush( dpy );
+    for (i = 0; i < count; i++)
+        wins[i]->ping_result = wins[i]->ping_rtt >= 0 ? "  Success  " : "  Fail  ";
 
+    free(sent);
 }
 
 
-
 void print_default(FILE* fd, Window root_win, int num_children)
 {
     fprintf(fd, " \n");
@@ -691,615 +908,5383 @@ void print_default(FILE* fd, Window root_win, int num_children)
     fprintf(fd, "%d Top level windows\n", num_children);
 }
 
-void gen_output(XinfoPtr pXinfo, WininfoPtr pWininfo)
+/*
+ * The optional resource usage columns of the owner process of a window.
+ */
+#define PROC_USAGE_TITLE "  RSS(KB)  PSS(KB)    CPU(s)  Thr  FDs"
+
+    static void
+print_long_column(FILE* fd, int width, long val)
 {
-    int i;
-    FILE* fd;
-    pid_t pid;
+    if (val < 0)
+        fprintf(fd, " %*s", width, "-");
+    else
+        fprintf(fd, " %*ld", width, val);
+}
 
-    int val = pXinfo->xinfo_val;
-    WininfoPtr w = pWininfo;
-    char* name = pXinfo->xinfovalname;
-    char* path = pXinfo->pathname;
-    char* file = pXinfo->filename;
-    char *argument[6];
-    char *argument_props_root[3];
-    char *argument_props_id[4];
-    int child_status=0;
+    static void
+print_proc_usage(FILE* fd, const ProcUsage *usage)
+{
+    if (!usage)
+    {
+        fprintf(fd, " %8s %8s %9s %4s %4s\n", "-", "-", "-", "-", "-");
+        return;
+    }
 
-    Window root_win = RootWindow(dpy, screen);
-    int num_children = win_cnt;
+    print_long_column(fd, 8, usage->rss);
+    print_long_column(fd, 8, usage->pss);
+    if (usage->cpu < 0)
+        fprintf(fd, " %9s", "-");
+    else
+        fprintf(fd, " %9.2f", usage->cpu);
+    print_long_column(fd, 4, usage->threads);
+    print_long_column(fd, 4, usage->fds);
+    fprintf(fd, "\n");
+}
+
+/*
+ * The machine readable formats : one record per window, or per property.
+ */
+#define TOPWINS_COLUMNS "no", "pid", "winid", "w", "h", "rel_x", "rel_y", "abs_x", "abs_y", "depth", \
+                        "winname", "appname"
+#define TOPVWINS_COLUMNS "no", "pid", "border_id", "winid", "w", "h", "rel_x", "rel_y", "abs_x", "abs_y", \
+                         "depth", "type", "level", "winname", "appname", "map_state", \
+                         "screen", "vis_x", "vis_y", "vis_w", "vis_h"
+#define PROC_COLUMNS "rss_kb", "pss_kb", "cpu_s", "threads", "fds"
+
+static const char *const _topwins_columns[] = { TOPWINS_COLUMNS, NULL };
+static const char *const _topwins_proc_columns[] = { TOPWINS_COLUMNS, PROC_COLUMNS, NULL };
+static const char *const _topvwins_columns[] = { TOPVWINS_COLUMNS, NULL };
+static const char *const _topvwins_proc_columns[] = { TOPVWINS_COLUMNS, PROC_COLUMNS, NULL };
+static const char *const _ping_columns[] = {
+    "no", "pid", "winid", "w", "h", "winname", "appname", "ping", "rtt_us", "command", NULL };
+static const char *const _props_columns[] = {
+    "no", "role", "window", "property", "type", "value", NULL };
+
+/* the padded names of the text output, without the padding */
+    static void
+write_trimmed(WriterPtr wr, const char *str)
+{
+    size_t len;
 
-    argument[2] = (char *)malloc(sizeof(char)*15);
-    argument[4] = (char *)malloc(sizeof(char)*255);
+    if (!str)
+    {
+        writer_null(wr);
+        return;
+    }
 
-    argument[0] = strdup("xwd");
-    argument[1] = strdup("-id");
-    argument[3] = strdup("-out");
-    argument[5] = NULL;
+    while (*str == ' ')
+        str++;
+    len = strlen(str);
+    while (len && str[len - 1] == ' ')
+        len--;
+    writer_strn(wr, str, len);
+}
 
-    fd = pXinfo->output_fd;
-    fprintf(stderr, "[%s] Start to logging ", name);
-    if(path && file)
-        fprintf(stderr, "at %s/%s\n", path, file);
+    static void
+write_long_or_null(WriterPtr wr, long val)
+{
+    if (val < 0)
+        writer_null(wr);
     else
-        fprintf(stderr, "\n");
+        writer_long(wr, val);
+}
+
+    static void
+write_proc_usage(WriterPtr wr, long pid)
+{
+    const ProcUsage *usage = procinfo_usage(pid);
+
+    write_long_or_null(wr, usage ? usage->rss : -1);
+    write_long_or_null(wr, usage ? usage->pss : -1);
+    if (usage && usage->cpu >= 0)
+        writer_double(wr, usage->cpu);
+    else
+        writer_null(wr);
+    write_long_or_null(wr, usage ? usage->threads : -1);
+    write_long_or_null(wr, usage ? usage->fds : -1);
+}
+
+typedef struct {
+    WriterPtr wr;
+    int no;
+    const char *role;
+    Window window;
+} PropRecord;
+
+    static void
+write_property(void *data, const char *name, const char *type, const char *value)
+{
+    PropRecord *rec = data;
+
+    writer_long(rec->wr, rec->no);
+    writer_str(rec->wr, rec->role);
+    writer_xid(rec->wr, rec->window);
+    writer_str(rec->wr, name);
+    writer_str(rec->wr, type);
+    writer_str(rec->wr, value);
+    writer_end(rec->wr);
+}
+
+    static void
+gen_records(XinfoPtr pXinfo, WininfoTable *table)
+{
+    int val = pXinfo->xinfo_val;
+    Window root_win = RootWindow(dpy, screen);
+    Window *prop_wins;
+    PropListPtr props;
+    PropRecord rec;
+    WriterPtr wr;
+    WininfoPtr w;
+    int i;
+
+    if (val == XINFO_TOPWINS)
+    {
+        wr = writer_open(pXinfo->output_fd, pXinfo->format, pXinfo->proc ? _topwins_proc_columns : _topwins_columns);
+        for (i = 0; i < table->num; i++)
+        {
+            w = &table->wins[i];
+            writer_long(wr, i + 1);
+            writer_long(wr, w->pid);
+            writer_xid(wr, w->winid);
+            writer_long(wr, w->w);
+            writer_long(wr, w->h);
+            writer_long(wr, w->rel_x);
+            writer_long(wr, w->rel_y);
+            writer_long(wr, w->abs_x);
+            writer_long(wr, w->abs_y);
+            writer_long(wr, w->depth);
+            writer_str(wr, w->winname);
+            writer_str(wr, w->appname_brief);
+            if (pXinfo->proc)
+                write_proc_usage(wr, w->pid);
+            writer_end(wr);
+        }
+    }
+    else if (val == XINFO_TOPVWINS)
+    {
+        wr = writer_open(pXinfo->output_fd, pXinfo->format, pXinfo->proc ? _topvwins_proc_columns : _topvwins_columns);
+        for (i = 0; i < table->num; i++)
+        {
+            w = &table->wins[i];
+            writer_long(wr, i + 1);
+            writer_long(wr, w->pid);
+            writer_xid(wr, w->BDid);
+            writer_xid(wr, w->winid);
+            writer_long(wr, w->w);
+            writer_long(wr, w->h);
+            writer_long(wr, w->rel_x);
+            writer_long(wr, w->rel_y);
+            writer_long(wr, w->abs_x);
+            writer_long(wr, w->abs_y);
+            writer_long(wr, w->depth);
+            write_trimmed(wr, w->type);
+            write_trimmed(wr, w->level);
+            writer_str(wr, w->winname);
+            writer_str(wr, w->appname_brief);
+            writer_str(wr, w->map_state);
+            writer_str(wr, screen_state_name(w->screen_state));
+            writer_long(wr, w->vis_x);
+            writer_long(wr, w->vis_y);
+            writer_long(wr, w->vis_w);
+            writer_long(wr, w->vis_h);
+            if (pXinfo->proc)
+                write_proc_usage(wr, w->pid);
+            writer_end(wr);
+        }
+    }
+    else if (val == XINFO_PING)
+    {
+        wr = writer_open(pXinfo->output_fd, pXinfo->format, _ping_columns);
+        for (i = 0; i < table->num; i++)
+        {
+            w = &table->wins[i];
+            writer_long(wr, i + 1);
+            writer_long(wr, w->pid);
+            writer_xid(wr, w->winid);
+            writer_long(wr, w->w);
+            writer_long(wr, w->h);
+            writer_str(wr, w->winname);
+            writer_str(wr, w->appname_brief);
+            write_trimmed(wr, w->ping_result);
+            write_long_or_null(wr, w->ping_rtt);
+            writer_str(wr, w->appname);
+            writer_end(wr);
+        }
+    }
+    else
+    {
+        wr = writer_open(pXinfo->output_fd, pXinfo->format, _props_columns);
+
+        /* root, then the border and the client window of every window */
+        prop_wins = (Window *)calloc(2 * table->num + 1, sizeof(Window));
+        if (!prop_wins)
+        {
+            fprintf(stderr, " alloc error \n");
+            exit(1);
+        }
+        prop_wins[0] = root_win;
+        for (i = 0; i < table->num; i++)
+        {
+            prop_wins[2 * i + 1] = table->wins[i].BDid;
+            prop_wins[2 * i + 2] = table->wins[i].winid;
+        }
+        props = props_query(dpy, prop_wins, 2 * table->num + 1);
+
+        rec.wr = wr;
+        for (i = 0; i < 2 * table->num + 1; i++)
+        {
+            rec.no = (i + 1) / 2;
+            rec.role = i == 0 ? "root" : (i % 2 ? "border" : "client");
+            rec.window = prop_wins[i];
+            props_export(dpy, props, i, write_property, &rec);
+        }
+
+        props_free(props);
+        free(prop_wins);
+    }
+
+    writer_close(wr);
+}
+
+/*
+ * The text table of topwins, topvwins and ping.
+ */
+    static void
+print_wininfo_table(FILE* fd, XinfoPtr pXinfo, WininfoTable *table)
+{
+    int i;
+    int val = pXinfo->xinfo_val;
+    char* name = pXinfo->xinfovalname;
+    int win_cnt = table->num;
+    WininfoPtr w;
+
     if(val == XINFO_TOPWINS)
     {
-        print_default(fd, root_win, num_children);
         fprintf( fd, "----------------------------------[ %s ]-------------------------------------------------------------------------------\n", name);
-        fprintf( fd, " No    PID    WinID     w    h   Rel_x Rel_y Abs_x Abs_y Depth          WinName                      AppName\n" );
+        fprintf( fd, " No    PID    WinID     w    h   Rel_x Rel_y Abs_x Abs_y Depth          WinName                      AppName%s\n",
+                 pXinfo->proc ? "                            " PROC_USAGE_TITLE : "" );
         fprintf( fd, "----------------------------------------------------------------------------------------------------------------------------\n" );
 
         for(i = 0; i < win_cnt; i++)
         {
-            fprintf(fd, "%3i %6ld  0x%-7lx %4i %4i %5i %5i %5i %5i %5i  %-35s %-35s\n",
-                    (w->idx+1),w->pid,w->winid,w->w,w->h,w->rel_x,w->rel_y,w->abs_x,w->abs_y,w->depth,w->winname,w->appname_brief);
-
-            w = w->next;
+            w = &table->wins[i];
+            fprintf(fd, pXinfo->proc ? "%3i %6ld  0x%-7lx %4i %4i %5i %5i %5i %5i %5i  %-35s %-35s" : "%3i %6ld  0x%-7lx %4i %4i %5i %5i %5i %5i %5i  %-35s %-35s\n",
+                    (i+1),w->pid,w->winid,w->w,w->h,w->rel_x,w->rel_y,w->abs_x,w->abs_y,w->depth,w->winname,w->appname_brief);
+            if (pXinfo->proc)
+                print_proc_usage(fd, table->usage ? &table->usage[i] : procinfo_usage(w->pid));
         }
     }
     else if(val == XINFO_TOPVWINS)
     {
-        print_default(fd, root_win, num_children);
         fprintf( fd, "----------------------------------[ %s ]-------------------------------------------------------------------------------------------------------------\n", name);
-        fprintf( fd, " No    PID  BorderID    WinID      w    h   Rel_x Rel_y Abs_x  Abs_y  Depth  Type   Level  WinName                   AppName                     map state \n" );
+        fprintf( fd, " No    PID  BorderID    WinID      w    h   Rel_x Rel_y Abs_x  Abs_y  Depth  Type   Level  WinName                   AppName                     map state   Screen %s\n",
+                 pXinfo->proc ? "   " PROC_USAGE_TITLE : "" );
         fprintf( fd, "-----------------------------------------------------------------------------------------------------------------------------------------------------------\n" );
 
         for(i = 0; i < win_cnt; i++)
         {
-            fprintf( fd, "%3i %6ld  0x%-7lx 0x%-8lx %4i %4i %5i %5i %6i %6i %5i  %-7s  %-3s   %-25s %-25s %s\n",
-                    (w->idx+1),w->pid,w->BDid,w->winid,w->w,w->h,w->rel_x,w->rel_y,w->abs_x,w->abs_y,w->depth, w->type, w->level,w->winname, w->appname_brief,w->map_state);
-            w = w->next;
+            w = &table->wins[i];
+            fprintf( fd, pXinfo->proc ? "%3i %6ld  0x%-7lx 0x%-8lx %4i %4i %5i %5i %6i %6i %5i  %-7s  %-3s   %-25s %-25s   %-10s  %-7s " : "%3i %6ld  0x%-7lx 0x%-8lx %4i %4i %5i %5i %6i %6i %5i  %-7s  %-3s   %-25s %-25s   %-10s  %s  \n",
+                    (i+1),w->pid,w->BDid,w->winid,w->w,w->h,w->rel_x,w->rel_y,w->abs_x,w->abs_y,w->depth, w->type, w->level,w->winname, w->appname_brief,w->map_state,
+                    screen_state_name(w->screen_state) ? screen_state_name(w->screen_state) : "-");
+            if (pXinfo->proc)
+                print_proc_usage(fd, table->usage ? &table->usage[i] : procinfo_usage(w->pid));
+        }
+    }
+    else if(val == XINFO_PING)
+    {
+        fprintf( fd, "----------------------------------[ %s ]-----------------------------------------------------------------------------------------------------\n", name);
+        fprintf( fd, " No    PID    WinID     w    h           WinName              AppName                           Ping       RTT(us)            Command\n" );
+        fprintf( fd, "-----------------------------------------------------------------------------------------------------------------------------------------------\n" );
+
+        for(i = 0; i < win_cnt; i++)
+        {
+            w = &table->wins[i];
+            fprintf( fd, "%3i %6ld  0x%-7lx %4i %4i %-30s %-30s %-10s %8ld           %-40s\n",
+                    (i+1),w->pid,w->winid,w->w,w->h, w->winname, w->appname_brief,w->ping_result,w->ping_rtt,w->appname);
+        }
+    }
+}
+
+/* the code of a map state name, 0xff if unknown */
+    static unsigned int
+map_state_code(const char *map_state)
+{
+    int i;
+
+    for (i = 0; map_state && _map_states[i].name; i++)
+        if (!strcmp(map_state, _map_states[i].name))
+            return _map_states[i].code;
+
+    return 0xff;
+}
+
+/*
+ * Binary snapshot of topwins, topvwins and ping, and its dump back into the
+ * text table.
+ */
+    static void
+gen_snapshot(XinfoPtr pXinfo, WininfoTable *table)
+{
+    SnapWriterPtr sw;
+    int32_t *pid, *w, *h, *rel_x, *rel_y, *abs_x, *abs_y, *rtt;
+    int32_t *vis_x, *vis_y, *vis_w, *vis_h;
+    uint32_t *border, *winid, *winname, *appname, *command;
+    uint8_t *depth, *map, *state;
+    char *type, *level;
+    int i;
+
+    sw = snap_writer_new(pXinfo->xinfo_val, RootWindow(dpy, screen), table->num);
+
+    pid = snap_writer_column(sw, SNAP_PID, sizeof(int32_t));
+    border = snap_writer_column(sw, SNAP_BORDER_ID, sizeof(uint32_t));
+    winid = snap_writer_column(sw, SNAP_WINID, sizeof(uint32_t));
+    w = snap_writer_column(sw, SNAP_W, sizeof(int32_t));
+    h = snap_writer_column(sw, SNAP_H, sizeof(int32_t));
+    rel_x = snap_writer_column(sw, SNAP_REL_X, sizeof(int32_t));
+    rel_y = snap_writer_column(sw, SNAP_REL_Y, sizeof(int32_t));
+    abs_x = snap_writer_column(sw, SNAP_ABS_X, sizeof(int32_t));
+    abs_y = snap_writer_column(sw, SNAP_ABS_Y, sizeof(int32_t));
+    depth = snap_writer_column(sw, SNAP_DEPTH, sizeof(uint8_t));
+    type = snap_writer_column(sw, SNAP_TYPE, 8);
+    level = snap_writer_column(sw, SNAP_LEVEL, 4);
+    map = snap_writer_column(sw, SNAP_MAP_STATE, sizeof(uint8_t));
+    rtt = snap_writer_column(sw, SNAP_PING_RTT, sizeof(int32_t));
+    winname = snap_writer_column(sw, SNAP_WINNAME, sizeof(uint32_t));
+    appname = snap_writer_column(sw, SNAP_APPNAME, sizeof(uint32_t));
+    command = snap_writer_column(sw, SNAP_COMMAND, sizeof(uint32_t));
+    state = snap_writer_column(sw, SNAP_SCREEN, sizeof(uint8_t));
+    vis_x = snap_writer_column(sw, SNAP_VIS_X, sizeof(int32_t));
+    vis_y = snap_writer_column(sw, SNAP_VIS_Y, sizeof(int32_t));
+    vis_w = snap_writer_column(sw, SNAP_VIS_W, sizeof(int32_t));
+    vis_h = snap_writer_column(sw, SNAP_VIS_H, sizeof(int32_t));
+
+    for (i = 0; i < table->num; i++)
+    {
+        WininfoPtr win = &table->wins[i];
+
+        pid[i] = win->pid;
+        border[i] = win->BDid;
+        winid[i] = win->winid;
+        w[i] = win->w;
+        h[i] = win->h;
+        rel_x[i] = win->rel_x;
+        rel_y[i] = win->rel_y;
+        abs_x[i] = win->abs_x;
+        abs_y[i] = win->abs_y;
+        depth[i] = win->depth;
+        memcpy(type + 8 * i, win->type, 8);
+        memcpy(level + 4 * i, win->level, 4);
+        rtt[i] = win->ping_rtt;
+        winname[i] = snap_writer_string(sw, win->winname);
+        appname[i] = snap_writer_string(sw, win->appname_brief);
+        command[i] = snap_writer_string(sw, win->appname);
+        map[i] = map_state_code(win->map_state);
+        state[i] = win->screen_state;
+        vis_x[i] = win->vis_x;
+        vis_y[i] = win->vis_y;
+        vis_w[i] = win->vis_w;
+        vis_h[i] = win->vis_h;
+    }
+
+    if (pXinfo->proc)
+    {
+        int32_t *rss = snap_writer_column(sw, SNAP_RSS, sizeof(int32_t));
+        int32_t *pss = snap_writer_column(sw, SNAP_PSS, sizeof(int32_t));
+        int32_t *cpu = snap_writer_column(sw, SNAP_CPU, sizeof(int32_t));
+        int32_t *threads = snap_writer_column(sw, SNAP_THREADS, sizeof(int32_t));
+        int32_t *fds = snap_writer_column(sw, SNAP_FDS, sizeof(int32_t));
+
+        for (i = 0; i < table->num; i++)
+        {
+            const ProcUsage *usage = procinfo_usage(table->wins[i].pid);
+
+            rss[i] = usage ? usage->rss : -1;
+            pss[i] = usage ? usage->pss : -1;
+            cpu[i] = usage && usage->cpu >= 0 ? (int32_t)(usage->cpu * 100) : -1;
+            threads[i] = usage ? usage->threads : -1;
+            fds[i] = usage ? usage->fds : -1;
+        }
+    }
+
+    if (snap_writer_save(sw, pXinfo->output_fd))
+        fprintf(stderr, "fail to write the snapshot\n");
+
+    snap_writer_free(sw);
+}
+
+#define SNAP_COL(header, id, type) ((const type *)snap_column(header, id, sizeof(type)))
+
+static const binding _snap_modes[] = {
+    { XINFO_TOPWINS, "topwins" },
+    { XINFO_TOPVWINS, "topvwins" },
+    { XINFO_PING, "ping" },
+    { 0, 0 } };
+
+/*
+ * Map a snapshot file and rebuild its rows, the strings stay in the mapping.
+ */
+    static const SnapHeader *
+load_snapshot(const char *path, WininfoTable *table, size_t *size)
+{
+    const SnapHeader *header;
+    const int32_t *pid, *w, *h, *rel_x, *rel_y, *abs_x, *abs_y, *rtt;
+    const int32_t *rss, *pss, *cpu, *threads, *fds;
+    const int32_t *vis_x, *vis_y, *vis_w, *vis_h;
+    const uint32_t *border, *winid, *winname, *appname, *command;
+    const uint8_t *depth, *map, *state;
+    const char *type, *level;
+    uint32_t i;
+
+    header = snap_map(path, size);
+    if (!header)
+        return NULL;
+
+    if (header->mode != XINFO_TOPWINS && header->mode != XINFO_TOPVWINS && header->mode != XINFO_PING)
+    {
+        fprintf(stderr, "%s : unsupported mode %u\n", path, header->mode);
+        snap_unmap(header, *size);
+        return NULL;
+    }
+
+    pid = SNAP_COL(header, SNAP_PID, int32_t);
+    border = SNAP_COL(header, SNAP_BORDER_ID, uint32_t);
+    winid = SNAP_COL(header, SNAP_WINID, uint32_t);
+    w = SNAP_COL(header, SNAP_W, int32_t);
+    h = SNAP_COL(header, SNAP_H, int32_t);
+    rel_x = SNAP_COL(header, SNAP_REL_X, int32_t);
+    rel_y = SNAP_COL(header, SNAP_REL_Y, int32_t);
+    abs_x = SNAP_COL(header, SNAP_ABS_X, int32_t);
+    abs_y = SNAP_COL(header, SNAP_ABS_Y, int32_t);
+    depth = SNAP_COL(header, SNAP_DEPTH, uint8_t);
+    type = snap_column(header, SNAP_TYPE, 8);
+    level = snap_column(header, SNAP_LEVEL, 4);
+    map = SNAP_COL(header, SNAP_MAP_STATE, uint8_t);
+    rtt = SNAP_COL(header, SNAP_PING_RTT, int32_t);
+    winname = SNAP_COL(header, SNAP_WINNAME, uint32_t);
+    appname = SNAP_COL(header, SNAP_APPNAME, uint32_t);
+    command = SNAP_COL(header, SNAP_COMMAND, uint32_t);
+    rss = SNAP_COL(header, SNAP_RSS, int32_t);
+    pss = SNAP_COL(header, SNAP_PSS, int32_t);
+    cpu = SNAP_COL(header, SNAP_CPU, int32_t);
+    threads = SNAP_COL(header, SNAP_THREADS, int32_t);
+    fds = SNAP_COL(header, SNAP_FDS, int32_t);
+    state = SNAP_COL(header, SNAP_SCREEN, uint8_t);
+    vis_x = SNAP_COL(header, SNAP_VIS_X, int32_t);
+    vis_y = SNAP_COL(header, SNAP_VIS_Y, int32_t);
+    vis_w = SNAP_COL(header, SNAP_VIS_W, int32_t);
+    vis_h = SNAP_COL(header, SNAP_VIS_H, int32_t);
+
+    memset(table, 0, sizeof(WininfoTable));
+    table->num = table->size = header->count;
+    table->wins = calloc(header->count + 1, sizeof(Wininfo));
+    if (rss && pss && cpu && threads && fds)
+        table->usage = calloc(header->count + 1, sizeof(ProcUsage));
+    if (!table->wins || (rss && pss && cpu && threads && fds && !table->usage))
+    {
+        fprintf(stderr, " alloc error \n");
+        exit(1);
+    }
+
+    for (i = 0; i < header->count; i++)
+    {
+        WininfoPtr win = &table->wins[i];
+
+        win->pid = pid ? pid[i] : 0;
+        win->BDid = border ? border[i] : 0;
+        win->winid = winid ? winid[i] : 0;
+        win->w = w ? w[i] : 0;
+        win->h = h ? h[i] : 0;
+        win->rel_x = rel_x ? rel_x[i] : 0;
+        win->rel_y = rel_y ? rel_y[i] : 0;
+        win->abs_x = abs_x ? abs_x[i] : 0;
+        win->abs_y = abs_y ? abs_y[i] : 0;
+        win->depth = depth ? depth[i] : 0;
+        if (type)
+            memcpy(win->type, type + 8 * i, 7);
+        if (level)
+            memcpy(win->level, level + 4 * i, 3);
+        win->map_state = map && map[i] != 0xff ? Lookup(map[i], _map_states) : NULL;
+        win->ping_rtt = rtt ? rtt[i] : -1;
+        win->ping_result = win->ping_rtt >= 0 ? "  Success  " : "  Fail  ";
+        win->winname = winname ? snap_string(header, winname[i]) : NULL;
+        win->appname_brief = appname ? snap_string(header, appname[i]) : NULL;
+        win->appname = command ? snap_string(header, command[i]) : NULL;
+        if (state && vis_x && vis_y && vis_w && vis_h)
+        {
+            win->screen_state = state[i];
+            win->vis_x = vis_x[i];
+            win->vis_y = vis_y[i];
+            win->vis_w = vis_w[i];
+            win->vis_h = vis_h[i];
+        }
+
+        if (table->usage)
+        {
+            table->usage[i].rss = rss[i];
+            table->usage[i].pss = pss[i];
+            table->usage[i].cpu = cpu[i] < 0 ? -1 : cpu[i] / 100.0;
+            table->usage[i].threads = threads[i];
+            table->usage[i].fds = fds[i];
         }
     }
+
+    return header;
+}
+
+    static void
+snapshot_time(const SnapHeader *header, char *stamp, size_t size)
+{
+    struct tm t;
+    time_t time = header->time;
+
+    localtime_r(&time, &t);
+    strftime(stamp, size, "%Y-%m-%d %H:%M:%S", &t);
+}
+
+/*
+ * -dump : print a snapshot file as the text table of its mode.
+ */
+    void
+dump_snapshot(XinfoPtr pXinfo, const char *path)
+{
+    const SnapHeader *header;
+    WininfoTable table;
+    Xinfo info;
+    char stamp[64];
+    size_t size;
+
+    header = load_snapshot(path, &table, &size);
+    if (!header)
+        return;
+
+    memset(&info, 0, sizeof(Xinfo));
+    info.xinfo_val = header->mode;
+    info.xinfovalname = (char *)Lookup(header->mode, _snap_modes);
+    info.proc = table.usage != NULL;
+
+    snapshot_time(header, stamp, sizeof(stamp));
+
+    fprintf(pXinfo->output_fd, " \n");
+    fprintf(pXinfo->output_fd, "  Snapshot file          : %s\n", path);
+    fprintf(pXinfo->output_fd, "  Snapshot time          : %s\n", stamp);
+    fprintf(pXinfo->output_fd, "  Root window id         : 0x%x\n", header->root);
+    fprintf(pXinfo->output_fd, "\n");
+    fprintf(pXinfo->output_fd, "%d Top level windows\n", header->count);
+    print_wininfo_table(pXinfo->output_fd, &info, &table);
+
+    free(table.wins);
+    free(table.usage);
+    snap_unmap(header, size);
+}
+
+void gen_output(XinfoPtr pXinfo, WininfoTable *table)
+{
+    int i;
+    FILE* fd;
+
+    int val = pXinfo->xinfo_val;
+    WininfoPtr w;
+    int win_cnt = table ? table->num : 0;
+    char* name = pXinfo->xinfovalname;
+    char* path = pXinfo->pathname;
+    char* file = pXinfo->filename;
+    char filename[255];
+    Window *prop_wins;
+    PropListPtr props;
+
+    Window root_win = RootWindow(dpy, screen);
+    int num_children = win_cnt;
+
+    fd = pXinfo->output_fd;
+    fprintf(stderr, "[%s] Start to logging ", name);
+    if(path && file)
+        fprintf(stderr, "at %s/%s\n", path, file);
+    else
+        fprintf(stderr, "\n");
+    if(pXinfo->format == XINFO_FORMAT_BIN && table)
+    {
+        gen_snapshot(pXinfo, table);
+    }
+    else if(pXinfo->format != XINFO_FORMAT_TEXT && table &&
+       (val == XINFO_TOPWINS || val == XINFO_TOPVWINS || val == XINFO_PING || val == XINFO_TOPVWINS_PROPS))
+    {
+        gen_records(pXinfo, table);
+    }
+    else if(val == XINFO_TOPWINS || val == XINFO_TOPVWINS || val == XINFO_PING)
+    {
+        print_default(fd, root_win, num_children);
+        print_wininfo_table(fd, pXinfo, table);
+    }
     else if(val == XINFO_TOPVWINS_PROPS)
     {
         print_default(fd, root_win, num_children);
 
+        /* root, then the border and the client window of every window */
+        prop_wins = (Window *)calloc(2 * win_cnt + 1, sizeof(Window));
+        if (!prop_wins)
+        {
+            fprintf(stderr, " alloc error \n");
+            exit(1);
+        }
+        prop_wins[0] = root_win;
+        for(i = 0; i < win_cnt; i++)
+        {
+            w = &table->wins[i];
+            prop_wins[2 * i + 1] = w->BDid;
+            prop_wins[2 * i + 2] = w->winid;
+        }
+        props = props_query(dpy, prop_wins, 2 * win_cnt + 1);
+
         fprintf( fd, "###[ Root  Window ]###\n");
         fprintf( fd, "ID: 0x%lx\n", root_win);
         fprintf( fd, "######\n" );
-        argument_props_root[0] = strdup("/usr/bin/xprop");
-        argument_props_root[1] = strdup("-root");
-        argument_props_root[2] = NULL;
-        fflush(fd);
-        switch(pid = fork())
-        {
-            case 0:
-                if (execv("/usr/bin/xprop", argument_props_root) == -1)
-                {
-                    fprintf(fd, "failed to excute 'xprop -root'\n");
-                    exit(1);
-                }
-                break;
-            default:
-                break;
-        }
-        waitpid(pid, &child_status, WUNTRACED);
-        fflush(fd);
+        props_print(dpy, props, 0, fd);
 
-        argument_props_id[0] = strdup("/usr/bin/xprop");
-        argument_props_id[1] = strdup("-id");
-        argument_props_id[2] = (char *)malloc(sizeof(char)*15);
-        argument_props_id[3] = NULL;
         for(i = 0; i < win_cnt; i++)
         {
+            w = &table->wins[i];
             fprintf( fd, "\n###[ Window ID: 0x%x ]###\n", (unsigned int)w->winid);
             fprintf( fd, "PID: %ld\n",  w->pid);
             fprintf( fd, "Border ID: 0x%x\n",  (unsigned int)w->BDid);
             fprintf( fd, "###\n" );
-            snprintf(argument_props_id[2], 15, "0x%-7x", (unsigned int)w->BDid);
-            fflush(fd);
-            switch(pid = fork())
-            {
-                case 0:
-                    if (execv("/usr/bin/xprop", argument_props_id) == -1)
-                    {
-                        fprintf(stderr, "failed to excute 'xprop' \n");
-                        exit(1);
-                    }
-                    break;
-                default:
-                    break;
-            }
-            waitpid(pid, &child_status, WUNTRACED);
-            fflush(fd);
+            props_print(dpy, props, 2 * i + 1, fd);
             fprintf( fd, "###\n" );
             fprintf( fd, "Win Name : %s\n",  w->winname);
             fprintf( fd, "Window ID: 0x%x\n",  (unsigned int)w->winid);
             fprintf( fd, "######\n" );
-            snprintf(argument_props_id[2], 15, "0x%-7x", (unsigned int)w->winid);
-            fflush(fd);
-            switch(pid = fork())
-            {
-                case 0:
-                    if (execv("/usr/bin/xprop", argument_props_id) == -1)
-                    {
-                        fprintf(stderr, "failed to excute 'xprop' \n");
-                        exit(1);
-                    }
-                    break;
-                default:
-                    break;
-            }
-            waitpid(pid, &child_status, WUNTRACED);
-            fflush(fd);
+            props_print(dpy, props, 2 * i + 2, fd);
             fprintf( fd, "######\n" );
-
-            w = w->next;
         }
-        free(argument_props_id[0]);
-        free(argument_props_id[1]);
-        free(argument_props_id[2]);
 
-        free(argument_props_root[0]);
-        free(argument_props_root[1]);
+        props_free(props);
+        free(prop_wins);
     }
-    else if(val == XINFO_PING)
+    else if(val == XINFO_XWD_TOPVWINS)
     {
-        print_default(fd, root_win, num_children);
-        fprintf( fd, "----------------------------------[ %s ]-----------------------------------------------------------------------------------------------------\n", name);
-        fprintf( fd, " No    PID    WinID     w    h           WinName              AppName                           Ping                         Command\n" );
-        fprintf( fd, "-----------------------------------------------------------------------------------------------------------------------------------------------\n" );
+        fprintf( stderr,  " [START] %s : the path to store the xwd files is %s \n", name, path);
+        xwd_init(dpy, pXinfo->compress);
+
+        /* dump root window */
+        snprintf(filename, sizeof(filename), "%s/root_win.xwd", path);
+        xwd_dump_window(dpy, root_win, filename);
 
         for(i = 0; i < win_cnt; i++)
         {
-            fprintf( fd, "%3i %6ld  0x%-7lx %4i %4i %-30s %-30s %-20s %-40s\n",
-                    (w->idx+1),w->pid,w->winid,w->w,w->h, w->winname, w->appname_brief,w->ping_result,w->appname);
-
-            w = w->next;
+            w = &table->wins[i];
+            snprintf(filename, sizeof(filename), "%s/0x%-7lx.xwd", path, w->winid);
+            xwd_dump_window(dpy, w->winid, filename);
         }
+        xwd_fini(dpy);
+        fprintf( stderr,  " [FINISH] %s : the path to store the xwd files is %s \n", name, path);
     }
-    else if(val == XINFO_XWD_TOPVWINS)
+    else if(val == XINFO_XWD_WIN)
     {
         fprintf( stderr,  " [START] %s : the path to store the xwd files is %s \n", name, path);
 
-        /* dump root window */
-        snprintf(argument[2], 15,"0x%-7lx", root_win);
-        snprintf(argument[4], 255,"%s/root_win.xwd", path);
+        snprintf(filename, sizeof(filename), "%s/0x%-7x.xwd", path, pXinfo->win);
+        xwd_init(dpy, pXinfo->compress);
+        xwd_dump_window(dpy, pXinfo->win, filename);
+        xwd_fini(dpy);
 
-        switch(pid = fork())
-        {
-            case 0:
-                if (execv("/usr/bin/xwd", argument) == -1)
-                {
-                    fprintf(stderr, "execv error root xwd\n");
-                    exit(1);
-                }
-                break;
-            default:
-                break;
-        }
+        fprintf( stderr,  " [FINISH] %s : the path to store the xwd files is %s \n", name, path);
+    }
+    fprintf(stderr, "[%s] Finish to logging ", name);
+    if(path && file)
+        fprintf(stderr, "at %s/%s\n", path, file);
+    else
+        fprintf(stderr, "\n");
+    free(name);
+}
 
-        for(i = 0; i < win_cnt; i++)
+
+/*
+ * The client windows of frames : _E_USER_CREATED_WINDOW when the window
+ * manager sets it, else the first viewable, not override redirect window
+ * found breadth first under the frame. All the frames are searched at once,
+ * a batch of QueryTree and a batch of GetWindowAttributes per level of the
+ * trees, and a window destroyed on the way only ends its own branch. A
+ * frame without a client stands for itself.
+ */
+typedef struct _ClientSearch {
+    int idx;                /* of the frame */
+    Window win;
+} ClientSearch;
+
+    static void
+client_search_add(ClientSearch **list, int *num, int *size, int idx, Window win)
+{
+    if (*num == *size)
+    {
+        *size = *size ? *size * 2 : 64;
+        *list = realloc(*list, *size * sizeof(ClientSearch));
+        if (!*list)
         {
-            snprintf(argument[2], 15, "0x%-7lx", w->winid);
-            snprintf(argument[4], 255, "%s/0x%-7lx.xwd", path, w->winid);
+            fprintf(stderr, " alloc error \n");
+            exit(1);
+        }
+    }
+    (*list)[*num].idx = idx;
+    (*list)[*num].win = win;
+    (*num)++;
+}
 
-            switch(pid = fork())
-            {
-                case 0:
-                    if (execv("/usr/bin/xwd", argument) == -1)
-                    {
-                        fprintf(stderr, "execv error other xwd\n");
-                        exit(1);
-                    }
+    static void
+get_client_windows(const Window *frames, Window *clients, int num)
+{
+    xcb_get_property_cookie_t *ucw_cookies;
+    xcb_query_tree_cookie_t *tree_cookies = NULL;
+    xcb_get_window_attributes_cookie_t *attr_cookies = NULL;
+    ClientSearch *level = NULL, *children = NULL, *tmp;
+    int num_level = 0, size_level = 0;
+    int num_children = 0, size_children = 0;
+    int size_tree = 0, size_attr = 0;
+    int i, j;
+
+    if (!num)
+        return;
+
+    ucw_cookies = calloc(num, sizeof(xcb_get_property_cookie_t));
+    if (!ucw_cookies)
+    {
+        fprintf(stderr, " alloc error \n");
+        exit(1);
+    }
+
+    for (i = 0; i < num; i++)
+        ucw_cookies[i] = _send_get_property(frames[i], prop_user_created_win, XA_WINDOW, 1L);
+
+    for (i = 0; i < num; i++)
+    {
+        xcb_get_property_reply_t *reply = _get_property_reply(ucw_cookies[i]);
+
+        clients[i] = 0;
+        if (reply && reply->type == XA_WINDOW &&
+            xcb_get_property_value_length(reply) >= (int)sizeof(uint32_t))
+            clients[i] = *(uint32_t *)xcb_get_property_value(reply);
+        else
+            client_search_add(&level, &num_level, &size_level, i, frames[i]);
+        free(reply);
+    }
+    free(ucw_cookies);
+
+    while (num_level)
+    {
+        if (num_level > size_tree)
+        {
+            size_tree = num_level;
+            tree_cookies = realloc(tree_cookies, size_tree * sizeof(xcb_query_tree_cookie_t));
+            if (!tree_cookies)
+            {
+                fprintf(stderr, " alloc error \n");
+                exit(1);
+            }
+        }
+
+        for (i = 0; i < num_level; i++)
+            tree_cookies[i] = xcb_query_tree(xcb_conn, level[i].win);
+
+        /* the children in stacking order, bottom first */
+        num_children = 0;
+        for (i = 0; i < num_level; i++)
+        {
+            xcb_query_tree_reply_t *tree;
+            xcb_generic_error_t *err = NULL;
+            xcb_window_t *wins;
+
+            tree = xcb_query_tree_reply(xcb_conn, tree_cookies[i], &err);
+            if (err)
+                free(err);
+            if (!tree)
+                continue;
+
+            wins = xcb_query_tree_children(tree);
+            for (j = 0; j < xcb_query_tree_children_length(tree); j++)
+                client_search_add(&children, &num_children, &size_children, level[i].idx, wins[j]);
+            free(tree);
+        }
+
+        if (num_children > size_attr)
+        {
+            size_attr = num_children;
+            attr_cookies = realloc(attr_cookies, size_attr * sizeof(xcb_get_window_attributes_cookie_t));
+            if (!attr_cookies)
+            {
+                fprintf(stderr, " alloc error \n");
+                exit(1);
+            }
+        }
+
+        for (i = 0; i < num_children; i++)
+            attr_cookies[i] = xcb_get_window_attributes(xcb_conn, children[i].win);
+
+        for (i = 0; i < num_children; i++)
+        {
+            xcb_get_window_attributes_reply_t *attr;
+            xcb_generic_error_t *err = NULL;
+
+            attr = xcb_get_window_attributes_reply(xcb_conn, attr_cookies[i], &err);
+            if (err)
+                free(err);
+            if (attr && !clients[children[i].idx] &&
+                attr->map_state == XCB_MAP_STATE_VIEWABLE && !attr->override_redirect)
+                clients[children[i].idx] = children[i].win;
+            free(attr);
+        }
+
+        /* the next level, without the frames whose client was found */
+        num_level = 0;
+        for (i = 0; i < num_children; i++)
+            if (!clients[children[i].idx])
+                children[num_level++] = children[i];
+        tmp = level;
+        level = children;
+        children = tmp;
+        j = size_level;
+        size_level = size_children;
+        size_children = j;
+    }
+
+    for (i = 0; i < num; i++)
+        if (!clients[i])
+            clients[i] = frames[i];
+
+    free(level);
+    free(children);
+    free(tree_cookies);
+    free(attr_cookies);
+}
+
+/*
+ * The windows come and go while xinfo works on them : the errors of a window
+ * or a damage destroyed under it are dropped, any other error goes to the
+ * handler installed before.
+ */
+static XErrorHandler old_x_error = NULL;
+static int damage_error_base = -1;
+
+static int cb_x_error(Display *disp, XErrorEvent *ev)
+{
+    if (ev->error_code == BadWindow || ev->error_code == BadDrawable)
+        return 0;
+    if (damage_error_base >= 0 && ev->error_code == damage_error_base + BadDamage)
+        return 0;
+
+    return old_x_error ? old_x_error(disp, ev) : 0;
+}
+
+/*
+ * The absolute position of a window is worked out locally instead of with a
+ * TranslateCoordinates per window : the offsets of the window and of its
+ * ancestors are summed up to the root, and the outer rectangle of the window
+ * is clipped by every ancestor and at last by the screen on the way, which
+ * leaves the visible part. The frame is queried along with the window, so
+ * the walk of a client which is a direct child of its frame ends in the
+ * first batch, the deeper ones take a batch more per level.
+ */
+    static void
+walk_clip(WininfoCookies *cookies, int x, int y, int w, int h)
+{
+    int x2 = cookies->clip_x + cookies->clip_w;
+    int y2 = cookies->clip_y + cookies->clip_h;
+
+    if (cookies->clip_x < x)
+        cookies->clip_x = x;
+    if (cookies->clip_y < y)
+        cookies->clip_y = y;
+    if (x2 > x + w)
+        x2 = x + w;
+    if (y2 > y + h)
+        y2 = y + h;
+    cookies->clip_w = x2 > cookies->clip_x ? x2 - cookies->clip_x : 0;
+    cookies->clip_h = y2 > cookies->clip_y ? y2 - cookies->clip_y : 0;
+}
+
+/* move from the inside of the parent to the inside of its own parent */
+    static void
+walk_up(WininfoCookies *cookies, xcb_get_geometry_reply_t *parent)
+{
+    int dx = parent->x + parent->border_width;
+    int dy = parent->y + parent->border_width;
+
+    walk_clip(cookies, 0, 0, parent->width, parent->height);
+    cookies->off_x += dx;
+    cookies->off_y += dy;
+    cookies->clip_x += dx;
+    cookies->clip_y += dy;
+}
+
+    static void
+walk_finish(WininfoPtr w, WininfoCookies *cookies)
+{
+    walk_clip(cookies, 0, 0, DisplayWidth(dpy, screen), DisplayHeight(dpy, screen));
+
+    w->abs_x = cookies->off_x;
+    w->abs_y = cookies->off_y;
+    w->vis_x = cookies->clip_x;
+    w->vis_y = cookies->clip_y;
+    w->vis_w = cookies->clip_w;
+    w->vis_h = cookies->clip_h;
+    if (!w->vis_w || !w->vis_h)
+        w->screen_state = XINFO_SCREEN_OFF;
+    else if (w->vis_w == cookies->outer_w && w->vis_h == cookies->outer_h)
+        w->screen_state = XINFO_SCREEN_ON;
+    else
+        w->screen_state = XINFO_SCREEN_PARTIAL;
+
+    cookies->parent = None;
+}
+
+    static void
+send_wininfo_requests(WininfoPtr w, WininfoCookies *cookies)
+{
+    cookies->pid = _send_get_property(w->winid, prop_pid, XA_CARDINAL, 2L);
+    cookies->c_pid = _send_get_property(w->winid, prop_c_pid, XA_CARDINAL, 2L);
+    cookies->geometry = xcb_get_geometry(xcb_conn, w->winid);
+    cookies->tree = xcb_query_tree(xcb_conn, w->winid);
+    if (w->BDid != w->winid)
+        cookies->ancestor = xcb_get_geometry(xcb_conn, w->BDid);
+    cookies->type = _send_get_property(w->winid, prop_wm_type, XA_ATOM, 1L);
+    cookies->level = _send_get_property(w->winid, prop_level, XA_CARDINAL, 1L);
+    cookies->name = _send_get_property(w->winid, XA_WM_NAME, AnyPropertyType, 0x7fffffff);
+    cookies->wm_class = _send_get_property(w->winid, prop_class, AnyPropertyType, 0x7fffffff);
+}
+
+    static void
+collect_wininfo_replies(WininfoPtr w, WininfoCookies *cookies, StrArena *strings)
+{
+    char str[255];
+    xcb_generic_error_t *err = NULL;
+    xcb_get_property_reply_t *reply, *name, *wm_class;
+    xcb_get_geometry_reply_t *geometry, *frame = NULL;
+    xcb_query_tree_reply_t *tree;
+    unsigned int pid = 0;
+    const char *cmdline;
+
+    /* get pid */
+    reply = _get_property_reply(cookies->pid);
+    if (_get_property_card32(reply, XA_CARDINAL, &pid) < 1)
+    {
+        free(reply);
+        reply = _get_property_reply(cookies->c_pid);
+        if (_get_property_card32(reply, XA_CARDINAL, &pid) < 1)
+            pid = 0;
+    }
+    else
+        xcb_discard_reply(xcb_conn, cookies->c_pid.sequence);
+    free(reply);
+    w->pid = pid;
+
+    /* get the geometry info and depth*/
+    geometry = xcb_get_geometry_reply(xcb_conn, cookies->geometry, &err);
+    if (err)
+    {
+        free(err);
+        err = NULL;
+    }
+    tree = xcb_query_tree_reply(xcb_conn, cookies->tree, &err);
+    if (err)
+    {
+        free(err);
+        err = NULL;
+    }
+    if (w->BDid != w->winid)
+    {
+        frame = xcb_get_geometry_reply(xcb_conn, cookies->ancestor, &err);
+        if (err)
+        {
+            free(err);
+            err = NULL;
+        }
+    }
+
+    cookies->parent = None;
+    if (geometry)
+    {
+        w->w = geometry->width;
+        w->h = geometry->height;
+        w->rel_x = geometry->x;
+        w->rel_y = geometry->y;
+        w->depth = geometry->depth;
+
+        cookies->off_x = cookies->clip_x = geometry->x;
+        cookies->off_y = cookies->clip_y = geometry->y;
+        cookies->outer_w = cookies->clip_w = geometry->width + 2 * geometry->border_width;
+        cookies->outer_h = cookies->clip_h = geometry->height + 2 * geometry->border_width;
+        cookies->parent = tree ? tree->parent : None;
+
+        /* the frame is a child of the root */
+        if (frame && cookies->parent == w->BDid)
+        {
+            walk_up(cookies, frame);
+            cookies->parent = RootWindow(dpy, screen);
+        }
+        if (cookies->parent == RootWindow(dpy, screen))
+            walk_finish(w, cookies);
+    }
+    free(geometry);
+    free(tree);
+    free(frame);
+
+    reply = _get_property_reply(cookies->type);
+    get_type(reply, w->type);
+    free(reply);
+
+    reply = _get_property_reply(cookies->level);
+    get_level(reply, w->level);
+    free(reply);
+
+    /* get the winname */
+    name = _get_property_reply(cookies->name);
+    wm_class = _get_property_reply(cookies->wm_class);
+    str[0] = '\0';
+    get_winname(name, wm_class, str);
+    w->winname = arena_strdup(strings, str);
+    free(name);
+    free(wm_class);
+
+    /* get app_name from pid */
+    cmdline = procinfo_cmdline(w->pid);
+    if(cmdline)
+    {
+        w->appname = arena_strndup(strings, cmdline, 254);
+
+        snprintf(str, sizeof(str), "%s", w->appname);
+        get_appname_brief (str);
+        w->appname_brief = arena_strdup(strings, str);
+    }
+    else
+        w->appname = w->appname_brief = NULL;
+}
+
+/*
+ * Gather the information of the windows : send all requests first, then
+ * collect all replies.
+ */
+    static void
+query_wininfo(WininfoPtr *wins, int count, StrArena *strings)
+{
+    WininfoCookies *cookies;
+    int i, num;
+
+    if (count <= 0)
+        return;
+
+    cookies = calloc(count, sizeof(WininfoCookies));
+    if (!cookies)
+    {
+        fprintf(stderr, " alloc error \n");
+        exit(1);
+    }
+
+    for (i = 0; i < count; i++)
+        send_wininfo_requests(wins[i], &cookies[i]);
+
+    for (i = 0; i < count; i++)
+        collect_wininfo_replies(wins[i], &cookies[i], strings);
+
+    /* the windows deeper in their frame walk up a level per batch */
+    do
+    {
+        num = 0;
+        for (i = 0; i < count; i++)
+        {
+            if (!cookies[i].parent)
+                continue;
+            cookies[i].tree = xcb_query_tree(xcb_conn, cookies[i].parent);
+            cookies[i].ancestor = xcb_get_geometry(xcb_conn, cookies[i].parent);
+            num++;
+        }
+
+        for (i = 0; i < count; i++)
+        {
+            xcb_query_tree_reply_t *tree;
+            xcb_get_geometry_reply_t *parent;
+            xcb_generic_error_t *err = NULL;
+
+            if (!cookies[i].parent)
+                continue;
+
+            tree = xcb_query_tree_reply(xcb_conn, cookies[i].tree, &err);
+            if (err)
+            {
+                free(err);
+                err = NULL;
+            }
+            parent = xcb_get_geometry_reply(xcb_conn, cookies[i].ancestor, &err);
+            if (err)
+                free(err);
+
+            /* an ancestor was destroyed : the position stays unknown */
+            cookies[i].parent = None;
+            if (tree && parent)
+            {
+                walk_up(&cookies[i], parent);
+                cookies[i].parent = tree->parent;
+                if (cookies[i].parent == RootWindow(dpy, screen))
+                    walk_finish(wins[i], &cookies[i]);
+            }
+            free(tree);
+            free(parent);
+        }
+    } while (num);
+
+    free(cookies);
+}
+
+/*
+ * Watchdog : keep one connection open and ping all the mapped top level
+ * clients which support _NET_WM_PING on a fixed cadence. The window table is
+ * kept up to date from the SubstructureNotify events of the root window, so
+ * only new windows are queried. A window which does not answer for longer
+ * than the threshold is reported as hung, and as recovered when it answers
+ * again.
+ */
+#define WATCHDOG_HISTORY 32
+
+typedef struct _WatchdogEntry {
+    Window frame;           /* child of the root window */
+    Wininfo info;
+    int mapped;             /* -1 : unknown */
+    int queried;
+    int pingable;
+    int destroyed;
+    int hung;
+    struct timespec last_reply;
+    long rtt[WATCHDOG_HISTORY]; /* ring buffer of the round trip times in usec */
+    int rtt_head;
+    int rtt_num;
+} WatchdogEntry, *WatchdogEntryPtr;
+
+static WatchdogEntryPtr *wd_entries = NULL;
+static int wd_num = 0;
+static int wd_size = 0;
+static XidMap wd_map;           /* frame -> live entry */
+static XidMap wd_clients;       /* client -> live entry, for the WM_PROTOCOLS changes */
+static StrArena wd_strings;
+static volatile sig_atomic_t wd_quit = 0;
+
+    static void
+watchdog_signal(int sig)
+{
+    wd_quit = 1;
+}
+
+    static WatchdogEntryPtr
+watchdog_find(Window frame)
+{
+    return xidmap_find(&wd_map, frame);
+}
+
+    static void
+watchdog_destroy(WatchdogEntryPtr entry)
+{
+    if (!entry)
+        return;
+
+    /* freed by the next sweep */
+    entry->destroyed = TRUE;
+    xidmap_del(&wd_map, entry->frame);
+    if (entry->queried && xidmap_find(&wd_clients, entry->info.winid) == entry)
+        xidmap_del(&wd_clients, entry->info.winid);
+}
+
+    static WatchdogEntryPtr
+watchdog_add(Window frame, int mapped)
+{
+    WatchdogEntryPtr entry;
+
+    entry = watchdog_find(frame);
+    if (entry)
+    {
+        if (mapped >= 0)
+            entry->mapped = mapped;
+        return entry;
+    }
+
+    if (wd_num == wd_size)
+    {
+        wd_size = wd_size ? wd_size * 2 : 64;
+        wd_entries = realloc(wd_entries, wd_size * sizeof(WatchdogEntryPtr));
+        if (!wd_entries)
+        {
+            fprintf(stderr, " alloc error \n");
+            exit(1);
+        }
+    }
+
+    entry = calloc(1, sizeof(WatchdogEntry));
+    if (!entry)
+    {
+        fprintf(stderr, " alloc error \n");
+        exit(1);
+    }
+    entry->frame = frame;
+    entry->mapped = mapped;
+    entry->info.BDid = frame;
+    entry->info.winid = frame;
+    entry->info.ping_rtt = -1;
+    wd_entries[wd_num++] = entry;
+    xidmap_put(&wd_map, frame, entry);
+
+    return entry;
+}
+
+    static void
+watchdog_set_mapped(WatchdogEntryPtr entry, int mapped)
+{
+    if (!entry)
+        return;
+
+    /* do not count the time of being unmapped as a hang, and query the
+     * client again, it may have been reparented in between */
+    if (mapped && entry->mapped != TRUE)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &entry->last_reply);
+        entry->hung = FALSE;
+        entry->queried = FALSE;
+    }
+    entry->mapped = mapped;
+}
+
+    static void
+watchdog_event(XEvent *e)
+{
+    Window root_win = RootWindow(dpy, screen);
+
+    switch (e->type)
+    {
+        case CreateNotify:
+            if (e->xcreatewindow.parent == root_win)
+                watchdog_add(e->xcreatewindow.window, FALSE);
+            break;
+        case DestroyNotify:
+            watchdog_destroy(watchdog_find(e->xdestroywindow.window));
+            break;
+        case MapNotify:
+            if (e->xmap.event == root_win)
+                watchdog_set_mapped(watchdog_add(e->xmap.window, -1), TRUE);
+            break;
+        case UnmapNotify:
+            if (e->xunmap.event == root_win)
+                watchdog_set_mapped(watchdog_find(e->xunmap.window), FALSE);
+            break;
+        case ReparentNotify:
+            if (e->xreparent.parent == root_win)
+                watchdog_add(e->xreparent.window, -1);
+            else
+                watchdog_destroy(watchdog_find(e->xreparent.window));
+            break;
+        case PropertyNotify:
+            /* _NET_WM_PING can be added or removed at any time */
+            if (e->xproperty.atom == prop_wm_protocols)
+            {
+                WatchdogEntryPtr entry = xidmap_find(&wd_clients, e->xproperty.window);
+
+                if (entry)
+                    entry->queried = FALSE;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+    static void
+watchdog_sweep(void)
+{
+    int i, j;
+
+    for (i = 0, j = 0; i < wd_num; i++)
+    {
+        if (wd_entries[i]->destroyed)
+        {
+            free(wd_entries[i]);
+            continue;
+        }
+        wd_entries[j++] = wd_entries[i];
+    }
+    wd_num = j;
+}
+
+    static int
+_supports_ping(xcb_get_property_reply_t *reply)
+{
+    xcb_atom_t *atoms;
+    int i, num;
+
+    if (!reply || reply->type != XA_ATOM || reply->format != 32)
+        return FALSE;
+
+    atoms = (xcb_atom_t *)xcb_get_property_value(reply);
+    num = xcb_get_property_value_length(reply) / sizeof(xcb_atom_t);
+    for (i = 0; i < num; i++)
+        if (atoms[i] == prop_net_wm_ping)
+            return TRUE;
+
+    return FALSE;
+}
+
+/*
+ * Query the map state of the new windows, and the client window, the pid,
+ * the names and WM_PROTOCOLS of the new mapped windows in pipelined batches.
+ */
+    static void
+watchdog_query(void)
+{
+    xcb_get_window_attributes_cookie_t *attr_cookies;
+    xcb_get_property_cookie_t *proto_cookies;
+    Window *frames, *clients;
+    WininfoPtr *wins;
+    WatchdogEntryPtr *pending;
+    xcb_get_property_reply_t *reply;
+    int i, num = 0;
+
+    attr_cookies = calloc(wd_num + 1, sizeof(xcb_get_window_attributes_cookie_t));
+    frames = calloc(wd_num + 1, sizeof(Window));
+    clients = calloc(wd_num + 1, sizeof(Window));
+    proto_cookies = calloc(wd_num + 1, sizeof(xcb_get_property_cookie_t));
+    wins = calloc(wd_num + 1, sizeof(WininfoPtr));
+    pending = calloc(wd_num + 1, sizeof(WatchdogEntryPtr));
+    if (!attr_cookies || !frames || !clients || !proto_cookies || !wins || !pending)
+    {
+        fprintf(stderr, " alloc error \n");
+        exit(1);
+    }
+
+    for (i = 0; i < wd_num; i++)
+        wins[i] = &wd_entries[i]->info;
+    compact_strings(&wd_strings, wins, wd_num);
+
+    for (i = 0; i < wd_num; i++)
+        if (wd_entries[i]->mapped < 0)
+            attr_cookies[i] = xcb_get_window_attributes(xcb_conn, wd_entries[i]->frame);
+
+    for (i = 0; i < wd_num; i++)
+    {
+        WatchdogEntryPtr entry = wd_entries[i];
+
+        if (entry->mapped < 0)
+        {
+            xcb_get_window_attributes_reply_t *attr;
+            xcb_generic_error_t *err = NULL;
+
+            attr = xcb_get_window_attributes_reply(xcb_conn, attr_cookies[i], &err);
+            if (err)
+                free(err);
+            if (!attr)
+                watchdog_destroy(entry);
+            else
+                watchdog_set_mapped(entry, attr->map_state != IsUnmapped);
+            free(attr);
+        }
+
+        if (entry->mapped == TRUE && !entry->queried && !entry->destroyed)
+            pending[num++] = entry;
+    }
+
+    for (i = 0; i < num; i++)
+        frames[i] = pending[i]->frame;
+    get_client_windows(frames, clients, num);
+
+    for (i = 0; i < num; i++)
+    {
+        if (xidmap_find(&wd_clients, pending[i]->info.winid) == pending[i])
+            xidmap_del(&wd_clients, pending[i]->info.winid);
+        pending[i]->info.winid = clients[i];
+        xidmap_put(&wd_clients, clients[i], pending[i]);
+        XSelectInput(dpy, clients[i], PropertyChangeMask);
+
+        wins[i] = &pending[i]->info;
+        proto_cookies[i] = _send_get_property(pending[i]->info.winid, prop_wm_protocols, XA_ATOM, 32L);
+    }
+
+    /* the pids of the processes which exited since the last batch may have been reused */
+    procinfo_reset();
+    query_wininfo(wins, num, &wd_strings);
+
+    for (i = 0; i < num; i++)
+    {
+        reply = _get_property_reply(proto_cookies[i]);
+        pending[i]->pingable = _supports_ping(reply);
+        pending[i]->queried = TRUE;
+        free(reply);
+    }
+
+    free(attr_cookies);
+    free(frames);
+    free(clients);
+    free(proto_cookies);
+    free(wins);
+    free(pending);
+}
+
+    static void
+watchdog_timestamp(char *str, int len)
+{
+    struct timespec ts;
+    struct tm t;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    localtime_r(&ts.tv_sec, &t);
+    snprintf(str, len, "%04d-%02d-%02d %02d:%02d:%02d.%03ld",
+             t.tm_year + 1900, t.tm_mon + 1, t.tm_mday, t.tm_hour, t.tm_min, t.tm_sec,
+             ts.tv_nsec / 1000000);
+}
+
+    static void
+watchdog_report(FILE *fd, WatchdogEntryPtr entry, const char *event, long elapsed)
+{
+    char stamp[64];
+
+    watchdog_timestamp(stamp, sizeof(stamp));
+    if (entry->hung)
+        fprintf(fd, "%s [%-7s] 0x%-8lx pid %6ld %-30s : no reply for %ld ms\n", stamp, event,
+                entry->info.winid, entry->info.pid, entry->info.appname_brief ? entry->info.appname_brief : "",
+                elapsed);
+    else
+        fprintf(fd, "%s [%-7s] 0x%-8lx pid %6ld %-30s : hung for %ld ms, rtt %ld us\n", stamp, event,
+                entry->info.winid, entry->info.pid, entry->info.appname_brief ? entry->info.appname_brief : "",
+                elapsed, entry->info.ping_rtt);
+    fflush(fd);
+}
+
+    static void
+watchdog_update(FILE *fd, WatchdogEntryPtr entry, long threshold)
+{
+    struct timespec now;
+    long elapsed;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    elapsed = _elapsed_usec(&entry->last_reply, &now) / 1000;
+
+    if (entry->info.ping_rtt >= 0)
+    {
+        entry->rtt[entry->rtt_head] = entry->info.ping_rtt;
+        entry->rtt_head = (entry->rtt_head + 1) % WATCHDOG_HISTORY;
+        if (entry->rtt_num < WATCHDOG_HISTORY)
+            entry->rtt_num++;
+
+        if (entry->hung)
+        {
+            entry->hung = FALSE;
+            watchdog_report(fd, entry, "RECOVER", elapsed);
+        }
+        entry->last_reply = now;
+    }
+    else if (!entry->hung && elapsed > threshold)
+    {
+        entry->hung = TRUE;
+        watchdog_report(fd, entry, "HANG", elapsed);
+    }
+}
+
+    static void
+watchdog_summary(FILE *fd)
+{
+    int i, j;
+
+    fprintf(fd, "\n");
+    fprintf(fd, "----------------------------------[ watchdog ]--------------------------------------------------------------\n");
+    fprintf(fd, "    PID    WinID       AppName                        Samples  Min(us)  Avg(us)  Max(us)  State\n");
+    fprintf(fd, "------------------------------------------------------------------------------------------------------------\n");
+
+    for (i = 0; i < wd_num; i++)
+    {
+        WatchdogEntryPtr entry = wd_entries[i];
+        long min = 0, max = 0, sum = 0;
+
+        if (!entry->pingable || entry->destroyed)
+            continue;
+
+        for (j = 0; j < entry->rtt_num; j++)
+        {
+            if (!j || entry->rtt[j] < min)
+                min = entry->rtt[j];
+            if (entry->rtt[j] > max)
+                max = entry->rtt[j];
+            sum += entry->rtt[j];
+        }
+
+        fprintf(fd, " %6ld  0x%-8lx  %-30s %7d %8ld %8ld %8ld  %s\n",
+                entry->info.pid, entry->info.winid,
+                entry->info.appname_brief ? entry->info.appname_brief : "",
+                entry->rtt_num, min, entry->rtt_num ? sum / entry->rtt_num : 0, max,
+                entry->hung ? "Hung" : (entry->mapped == TRUE ? "Alive" : "Unmapped"));
+    }
+    fflush(fd);
+}
+
+    static void
+watchdog(XinfoPtr pXinfo)
+{
+    Window root_win = RootWindow(dpy, screen);
+    Window root_ret, parent_ret, *child_list = NULL;
+    unsigned int num_children;
+    WininfoPtr *wins = NULL;
+    WatchdogEntryPtr *pinged = NULL;
+    struct timespec *sent = NULL;
+    struct timespec start;
+    FILE *fd = pXinfo->output_fd;
+    Time base;
+    int i, num, size = 0;
+    XEvent e;
+
+    signal(SIGINT, watchdog_signal);
+    signal(SIGTERM, watchdog_signal);
+
+    /* the windows come and go while the watchdog is running */
+    old_x_error = XSetErrorHandler(cb_x_error);
+
+    /* the ping replies and the changes of the top level windows come to the root */
+    XSelectInput(dpy, root_win, SubstructureNotifyMask);
+
+    if (!XQueryTree(dpy, root_win, &root_ret, &parent_ret, &child_list, &num_children))
+        Fatal_Error("Can't query window tree.");
+    for (i = 0; i < (int)num_children; i++)
+        watchdog_add(child_list[i], -1);
+    if (child_list)
+        XFree(child_list);
+
+    fprintf(fd, "[%s] interval %ld ms, threshold %ld ms\n", pXinfo->xinfovalname, pXinfo->interval, pXinfo->threshold);
+    fflush(fd);
+
+    while (!wd_quit)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        watchdog_query();
+
+        if (wd_num > size)
+        {
+            size = wd_num;
+            wins = realloc(wins, size * sizeof(WininfoPtr));
+            pinged = realloc(pinged, size * sizeof(WatchdogEntryPtr));
+            sent = realloc(sent, size * sizeof(struct timespec));
+            if (!wins || !pinged || !sent)
+            {
+                fprintf(stderr, " alloc error \n");
+                exit(1);
+            }
+        }
+
+        for (i = 0, num = 0; i < wd_num; i++)
+        {
+            if (wd_entries[i]->mapped != TRUE || !wd_entries[i]->pingable || wd_entries[i]->destroyed)
+                continue;
+            pinged[num] = wd_entries[i];
+            wins[num++] = &wd_entries[i]->info;
+        }
+
+        base = send_pings(wins, num, sent);
+        collect_pings(wins, num, base, sent, pXinfo->interval, watchdog_event);
+
+        for (i = 0; i < num; i++)
+            if (!pinged[i]->destroyed && pinged[i]->mapped == TRUE)
+                watchdog_update(fd, pinged[i], pXinfo->threshold);
+
+        /* keep the cadence, handling the window changes until the next round */
+        while (!wd_quit && _next_event(&e, &start, pXinfo->interval))
+            watchdog_event(&e);
+
+        watchdog_sweep();
+    }
+
+    watchdog_summary(fd);
+
+    for (i = 0; i < wd_num; i++)
+        watchdog_destroy(wd_entries[i]);
+    watchdog_sweep();
+    free(wd_entries);
+    xidmap_free(&wd_map);
+    xidmap_free(&wd_clients);
+    arena_release(&wd_strings);
+    free(wins);
+    free(pinged);
+    free(sent);
+}
+
+/*
+ * Watch : keep a live model of the top level windows. The tree is scanned
+ * once, then the table is kept up to date from the SubstructureNotify events
+ * of the root window and the PropertyChange/StructureNotify events of the
+ * client windows. Only the windows which are new or whose properties changed
+ * are queried again, a snapshot is printed from the table without any request.
+ */
+typedef struct _WatchEntry {
+    Window frame;           /* child of the root window */
+    Wininfo info;           /* the client window */
+    int x, y, w, h, bw;     /* geometry of the frame */
+    int off_x, off_y;       /* position of the client in the frame */
+    int mapped;             /* -1 : unknown */
+    int queried;
+    int changed;            /* the properties of the client changed */
+} WatchEntry, *WatchEntryPtr;
+
+/* in stacking order, bottom first as XQueryTree */
+static WatchEntryPtr *wt_entries = NULL;
+static int wt_num = 0;
+static int wt_size = 0;
+static volatile sig_atomic_t wt_quit = 0;
+static volatile sig_atomic_t wt_dump = 0;
+static FILE *wt_fd = NULL;
+static XidMap wt_frames;        /* frame -> entry */
+static XidMap wt_clients;       /* client window -> entry */
+static StrArena wt_strings;
+
+    static void
+watch_signal(int sig)
+{
+    if (sig == SIGUSR1)
+        wt_dump = 1;
+    else
+        wt_quit = 1;
+}
+
+    static int
+watch_index(Window frame)
+{
+    int i;
+
+    for (i = 0; i < wt_num; i++)
+        if (wt_entries[i]->frame == frame)
+            return i;
+
+    return -1;
+}
+
+    static WatchEntryPtr
+watch_find(Window frame)
+{
+    return xidmap_find(&wt_frames, frame);
+}
+
+    static WatchEntryPtr
+watch_find_client(Window win)
+{
+    return xidmap_find(&wt_clients, win);
+}
+
+/* follow the client window of the frame, the frame itself if none */
+    static void
+watch_set_client(WatchEntryPtr entry, Window client)
+{
+    if (client == entry->info.winid)
+        return;
+
+    if (entry->info.winid != entry->frame)
+    {
+        XSelectInput(dpy, entry->info.winid, NoEventMask);
+        xidmap_del(&wt_clients, entry->info.winid);
+    }
+    if (client != entry->frame)
+    {
+        XSelectInput(dpy, client, PropertyChangeMask | StructureNotifyMask);
+        xidmap_put(&wt_clients, client, entry);
+    }
+    entry->info.winid = client;
+}
+
+    static void
+watch_report(WatchEntryPtr entry, const char *event, const char *fmt, ...)
+{
+    char stamp[64];
+    va_list args;
+
+    watchdog_timestamp(stamp, sizeof(stamp));
+    fprintf(wt_fd, "%s [%-7s] 0x%-8lx 0x%-8lx %-25s : ", stamp, event, entry->frame, entry->info.winid,
+            entry->info.appname_brief ? entry->info.appname_brief : "");
+    va_start(args, fmt);
+    vfprintf(wt_fd, fmt, args);
+    va_end(args);
+    fprintf(wt_fd, "\n");
+}
+
+/* move the entry at index idx right above the window above, to the bottom if None */
+    static void
+watch_restack(int idx, Window above)
+{
+    WatchEntryPtr entry = wt_entries[idx];
+    int dst;
+
+    memmove(&wt_entries[idx], &wt_entries[idx + 1], (wt_num - idx - 1) * sizeof(WatchEntryPtr));
+    wt_num--;
+
+    if (above)
+    {
+        dst = watch_index(above);
+        dst = dst < 0 ? wt_num : dst + 1;
+    }
+    else
+        dst = 0;
+
+    memmove(&wt_entries[dst + 1], &wt_entries[dst], (wt_num - dst) * sizeof(WatchEntryPtr));
+    wt_entries[dst] = entry;
+    wt_num++;
+}
+
+/* a new child of the root window goes on top of the stack */
+    static WatchEntryPtr
+watch_add(Window frame, int mapped)
+{
+    WatchEntryPtr entry;
+
+    entry = watch_find(frame);
+    if (entry)
+        return entry;
+
+    if (wt_num == wt_size)
+    {
+        wt_size = wt_size ? wt_size * 2 : 64;
+        wt_entries = realloc(wt_entries, wt_size * sizeof(WatchEntryPtr));
+        if (!wt_entries)
+        {
+            fprintf(stderr, " alloc error \n");
+            exit(1);
+        }
+    }
+
+    entry = calloc(1, sizeof(WatchEntry));
+    if (!entry)
+    {
+        fprintf(stderr, " alloc error \n");
+        exit(1);
+    }
+    entry->frame = frame;
+    entry->mapped = mapped;
+    entry->info.BDid = frame;
+    entry->info.winid = frame;
+    wt_entries[wt_num++] = entry;
+    xidmap_put(&wt_frames, frame, entry);
+
+    /* _E_USER_CREATED_WINDOW is set on the frame */
+    XSelectInput(dpy, frame, PropertyChangeMask);
+
+    return entry;
+}
+
+    static void
+watch_remove(int idx)
+{
+    WatchEntryPtr entry = wt_entries[idx];
+
+    watch_set_client(entry, entry->frame);
+    xidmap_del(&wt_frames, entry->frame);
+    free(entry);
+
+    memmove(&wt_entries[idx], &wt_entries[idx + 1], (wt_num - idx - 1) * sizeof(WatchEntryPtr));
+    wt_num--;
+}
+
+    static void
+watch_set_abs(WatchEntryPtr entry)
+{
+    entry->info.abs_x = entry->x + entry->bw + entry->off_x;
+    entry->info.abs_y = entry->y + entry->bw + entry->off_y;
+}
+
+    static void
+watch_configure(XConfigureEvent *ev)
+{
+    Window root_win = RootWindow(dpy, screen);
+    WatchEntryPtr entry;
+    int idx;
+
+    if (ev->event != root_win)
+    {
+        /* the client window inside its frame */
+        entry = watch_find_client(ev->window);
+        if (!entry || entry->info.winid == entry->frame)
+            return;
+
+        entry->off_x += ev->x - entry->info.rel_x;
+        entry->off_y += ev->y - entry->info.rel_y;
+        entry->info.rel_x = ev->x;
+        entry->info.rel_y = ev->y;
+        watch_set_abs(entry);
+        if (entry->info.w != ev->width || entry->info.h != ev->height)
+        {
+            entry->info.w = ev->width;
+            entry->info.h = ev->height;
+            if (entry->queried)
+                watch_report(entry, "RESIZE", "client %dx%d", ev->width, ev->height);
+        }
+        return;
+    }
+
+    idx = watch_index(ev->window);
+    if (idx < 0)
+        return;
+    entry = wt_entries[idx];
+
+    if (entry->x != ev->x || entry->y != ev->y || entry->w != ev->width ||
+        entry->h != ev->height || entry->bw != ev->border_width)
+    {
+        entry->x = ev->x;
+        entry->y = ev->y;
+        entry->w = ev->width;
+        entry->h = ev->height;
+        entry->bw = ev->border_width;
+        if (entry->info.winid == entry->frame)
+        {
+            entry->info.w = ev->width;
+            entry->info.h = ev->height;
+            entry->info.rel_x = ev->x;
+            entry->info.rel_y = ev->y;
+        }
+        watch_set_abs(entry);
+        if (entry->mapped == TRUE)
+            watch_report(entry, "CONFIG", "%d,%d %dx%d", ev->x, ev->y, ev->width, ev->height);
+    }
+
+    if ((idx ? wt_entries[idx - 1]->frame : None) != ev->above)
+    {
+        watch_restack(idx, ev->above);
+        if (entry->mapped == TRUE)
+            watch_report(entry, "RESTACK", "above 0x%lx", ev->above);
+    }
+}
+
+    static void
+watch_event(XEvent *e)
+{
+    Window root_win = RootWindow(dpy, screen);
+    WatchEntryPtr entry;
+    int idx;
+
+    switch (e->type)
+    {
+        case CreateNotify:
+            if (e->xcreatewindow.parent != root_win)
+                break;
+            entry = watch_add(e->xcreatewindow.window, FALSE);
+            entry->x = entry->info.rel_x = entry->info.abs_x = e->xcreatewindow.x;
+            entry->y = entry->info.rel_y = entry->info.abs_y = e->xcreatewindow.y;
+            entry->w = entry->info.w = e->xcreatewindow.width;
+            entry->h = entry->info.h = e->xcreatewindow.height;
+            entry->bw = e->xcreatewindow.border_width;
+            entry->off_x = entry->off_y = -entry->bw;
+            watch_report(entry, "CREATE", "%d,%d %dx%d", entry->x, entry->y, entry->w, entry->h);
+            break;
+        case DestroyNotify:
+            if (e->xdestroywindow.event == root_win)
+            {
+                idx = watch_index(e->xdestroywindow.window);
+                if (idx < 0)
                     break;
-                default:
+                watch_report(wt_entries[idx], "DESTROY", "");
+                watch_remove(idx);
+            }
+            else if ((entry = watch_find_client(e->xdestroywindow.window)))
+            {
+                /* look up the client window of the frame again */
+                watch_set_client(entry, entry->frame);
+                entry->queried = FALSE;
+                entry->changed = TRUE;
+            }
+            break;
+        case MapNotify:
+            if (e->xmap.event != root_win)
+                break;
+            entry = watch_add(e->xmap.window, -1);
+            entry->mapped = TRUE;
+            if (entry->queried)
+                watch_report(entry, "MAP", "");
+            break;
+        case UnmapNotify:
+            if (e->xunmap.event != root_win || !(entry = watch_find(e->xunmap.window)))
+                break;
+            entry->mapped = FALSE;
+            if (entry->queried)
+                watch_report(entry, "UNMAP", "");
+            break;
+        case ConfigureNotify:
+            watch_configure(&e->xconfigure);
+            break;
+        case CirculateNotify:
+            if (e->xcirculate.event != root_win)
+                break;
+            idx = watch_index(e->xcirculate.window);
+            if (idx < 0)
+                break;
+            if (e->xcirculate.place == PlaceOnBottom)
+                watch_restack(idx, None);
+            else if (idx != wt_num - 1)
+                watch_restack(idx, wt_entries[wt_num - 1]->frame);
+            break;
+        case ReparentNotify:
+            if (e->xreparent.event != root_win)
+            {
+                /* the client window moved into another frame */
+                if ((entry = watch_find_client(e->xreparent.window)))
+                {
+                    watch_set_client(entry, entry->frame);
+                    entry->queried = FALSE;
+                    entry->changed = TRUE;
+                }
+                break;
+            }
+            if (e->xreparent.parent == root_win)
+            {
+                entry = watch_add(e->xreparent.window, -1);
+                watch_report(entry, "REPARENT", "to root");
+            }
+            else if ((idx = watch_index(e->xreparent.window)) >= 0)
+            {
+                watch_report(wt_entries[idx], "REPARENT", "to 0x%lx", e->xreparent.parent);
+                watch_remove(idx);
+            }
+            break;
+        case PropertyNotify:
+            if (e->xproperty.atom != XA_WM_NAME && e->xproperty.atom != prop_class &&
+                e->xproperty.atom != prop_pid && e->xproperty.atom != prop_c_pid &&
+                e->xproperty.atom != prop_wm_type && e->xproperty.atom != prop_level &&
+                e->xproperty.atom != prop_user_created_win)
+                break;
+            entry = watch_find_client(e->xproperty.window);
+            if (!entry)
+                entry = watch_find(e->xproperty.window);
+            if (!entry || !entry->queried)
+                break;
+            entry->queried = FALSE;
+            entry->changed = TRUE;
+            break;
+        default:
+            break;
+    }
+}
+
+    static void
+watch_report_changes(WatchEntryPtr entry, Wininfo *old)
+{
+    if (old->winid != entry->info.winid)
+        watch_report(entry, "PROP", "client 0x%lx -> 0x%lx", old->winid, entry->info.winid);
+    if (old->pid != entry->info.pid)
+        watch_report(entry, "PROP", "pid %ld -> %ld", old->pid, entry->info.pid);
+    if (strcmp(old->winname ? old->winname : "", entry->info.winname ? entry->info.winname : ""))
+        watch_report(entry, "PROP", "name \"%s\" -> \"%s\"", old->winname ? old->winname : "",
+                     entry->info.winname ? entry->info.winname : "");
+    if (strcmp(old->type, entry->info.type))
+        watch_report(entry, "PROP", "type %s -> %s", old->type, entry->info.type);
+    if (strcmp(old->level, entry->info.level))
+        watch_report(entry, "PROP", "level %s -> %s", old->level, entry->info.level);
+}
+
+/*
+ * Query the map state and the geometry of the windows which came without
+ * them, and the client window information of the mapped windows which are
+ * new or changed, in pipelined batches.
+ */
+    static void
+watch_query(void)
+{
+    xcb_get_window_attributes_cookie_t *attr_cookies;
+    xcb_get_geometry_cookie_t *geom_cookies;
+    Window *frames, *clients;
+    WininfoPtr *wins;
+    WatchEntryPtr *pending;
+    Wininfo *old;
+    int i, num = 0, unknown = 0;
+
+    for (i = 0; i < wt_num; i++)
+    {
+        if (wt_entries[i]->mapped < 0)
+            unknown++;
+        else if (wt_entries[i]->mapped == TRUE && !wt_entries[i]->queried)
+            num++;
+    }
+    if (!unknown && !num)
+        return;
+
+    attr_cookies = calloc(wt_num, sizeof(xcb_get_window_attributes_cookie_t));
+    geom_cookies = calloc(wt_num, sizeof(xcb_get_geometry_cookie_t));
+    frames = calloc(wt_num, sizeof(Window));
+    clients = calloc(wt_num, sizeof(Window));
+    wins = calloc(wt_num, sizeof(WininfoPtr));
+    pending = calloc(wt_num, sizeof(WatchEntryPtr));
+    old = calloc(wt_num, sizeof(Wininfo));
+    if (!attr_cookies || !geom_cookies || !frames || !clients || !wins || !pending || !old)
+    {
+        fprintf(stderr, " alloc error \n");
+        exit(1);
+    }
+
+    for (i = 0; i < wt_num; i++)
+        wins[i] = &wt_entries[i]->info;
+    compact_strings(&wt_strings, wins, wt_num);
+
+    for (i = 0; i < wt_num; i++)
+    {
+        if (wt_entries[i]->mapped >= 0)
+            continue;
+        attr_cookies[i] = xcb_get_window_attributes(xcb_conn, wt_entries[i]->frame);
+        geom_cookies[i] = xcb_get_geometry(xcb_conn, wt_entries[i]->frame);
+    }
+
+    for (i = 0, num = 0; i < wt_num; i++)
+    {
+        WatchEntryPtr entry = wt_entries[i];
+
+        if (entry->mapped < 0)
+        {
+            xcb_get_window_attributes_reply_t *attr;
+            xcb_get_geometry_reply_t *geom;
+            xcb_generic_error_t *err = NULL;
+
+            attr = xcb_get_window_attributes_reply(xcb_conn, attr_cookies[i], &err);
+            if (err)
+            {
+                free(err);
+                err = NULL;
+            }
+            geom = xcb_get_geometry_reply(xcb_conn, geom_cookies[i], &err);
+            if (err)
+                free(err);
+
+            /* the DestroyNotify of a vanished window is on its way */
+            entry->mapped = attr ? attr->map_state != IsUnmapped : FALSE;
+            if (geom)
+            {
+                entry->x = geom->x;
+                entry->y = geom->y;
+                entry->w = geom->width;
+                entry->h = geom->height;
+                entry->bw = geom->border_width;
+            }
+            free(attr);
+            free(geom);
+        }
+
+        if (entry->mapped == TRUE && !entry->queried)
+            pending[num++] = entry;
+    }
+
+    for (i = 0; i < num; i++)
+        frames[i] = pending[i]->frame;
+    get_client_windows(frames, clients, num);
+
+    for (i = 0; i < num; i++)
+    {
+        WatchEntryPtr entry = pending[i];
+
+        /* keep the old values to report the changes */
+        old[i] = entry->info;
+        watch_set_client(entry, clients[i]);
+        wins[i] = &entry->info;
+    }
+
+    /* the pids of the processes which exited since the last batch may have been reused */
+    procinfo_reset();
+    query_wininfo(wins, num, &wt_strings);
+
+    for (i = 0; i < num; i++)
+    {
+        WatchEntryPtr entry = pending[i];
+
+        /* the client does not move in its frame without a ConfigureNotify */
+        entry->off_x = entry->info.abs_x - (entry->x + entry->bw);
+        entry->off_y = entry->info.abs_y - (entry->y + entry->bw);
+
+        if (entry->changed)
+            watch_report_changes(entry, &old[i]);
+        else if (wt_fd)
+            watch_report(entry, "MAP", "%s", entry->info.winname);
+
+        entry->queried = TRUE;
+        entry->changed = FALSE;
+    }
+
+    free(attr_cookies);
+    free(geom_cookies);
+    free(frames);
+    free(clients);
+    free(wins);
+    free(pending);
+    free(old);
+}
+
+    static void
+watch_snapshot(FILE *fd, const char *name)
+{
+    char stamp[64];
+    int i, no = 0;
+
+    watchdog_timestamp(stamp, sizeof(stamp));
+    fprintf(fd, "\n");
+    fprintf(fd, "----------------------------------[ %s %s ]-----------------------------------------------------------------------------------\n", name, stamp);
+    fprintf(fd, " No    PID  BorderID    WinID      w    h   Rel_x Rel_y Abs_x  Abs_y  Depth  Type   Level  WinName                   AppName\n");
+    fprintf(fd, "-----------------------------------------------------------------------------------------------------------------------------------------------\n");
+
+    /* top first as topvwins */
+    for (i = wt_num - 1; i >= 0; i--)
+    {
+        WatchEntryPtr entry = wt_entries[i];
+        WininfoPtr w = &entry->info;
+
+        if (entry->mapped != TRUE || !entry->queried)
+            continue;
+
+        fprintf(fd, "%3i %6ld  0x%-7lx 0x%-8lx %4i %4i %5i %5i %6i %6i %5i  %-7s  %-3s   %-25s %-25s\n",
+                ++no, w->pid, entry->frame, w->winid, w->w, w->h, w->rel_x, w->rel_y, w->abs_x, w->abs_y,
+                w->depth, w->type, w->level, w->winname ? w->winname : "",
+                w->appname_brief ? w->appname_brief : "");
+    }
+    fflush(fd);
+}
+
+    static void
+watch(XinfoPtr pXinfo)
+{
+    Window root_win = RootWindow(dpy, screen);
+    Window root_ret, parent_ret, *child_list = NULL;
+    unsigned int num_children;
+    struct timespec start;
+    FILE *fd = pXinfo->output_fd;
+    long tick = pXinfo->snapshot ? pXinfo->snapshot : 1000;
+    int i;
+    XEvent e;
+
+    signal(SIGINT, watch_signal);
+    signal(SIGTERM, watch_signal);
+    signal(SIGUSR1, watch_signal);
+
+    /* the windows come and go while the model is built */
+    old_x_error = XSetErrorHandler(cb_x_error);
+
+    /* select before the scan, so no change is lost in between */
+    XSelectInput(dpy, root_win, SubstructureNotifyMask);
+
+    if (!XQueryTree(dpy, root_win, &root_ret, &parent_ret, &child_list, &num_children))
+        Fatal_Error("Can't query window tree.");
+    for (i = 0; i < (int)num_children; i++)
+        watch_add(child_list[i], -1);
+    if (child_list)
+        XFree(child_list);
+
+    /* the initial scan is not reported as changes */
+    watch_query();
+    wt_fd = fd;
+
+    fprintf(fd, "[%s] %d windows, snapshot %s (SIGUSR1 : snapshot on demand)\n", pXinfo->xinfovalname, wt_num,
+            pXinfo->snapshot ? "periodic" : "on demand");
+    watch_snapshot(fd, pXinfo->xinfovalname);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (!wt_quit)
+    {
+        if (_next_event(&e, &start, tick))
+        {
+            watch_event(&e);
+
+            /* query the new and changed windows once the burst of events is handled */
+            if (!XPending(dpy))
+            {
+                watch_query();
+                fflush(fd);
+            }
+        }
+        else
+        {
+            if (pXinfo->snapshot)
+                watch_snapshot(fd, pXinfo->xinfovalname);
+            clock_gettime(CLOCK_MONOTONIC, &start);
+        }
+
+        if (wt_dump)
+        {
+            wt_dump = 0;
+            watch_snapshot(fd, pXinfo->xinfovalname);
+        }
+    }
+
+    watch_snapshot(fd, pXinfo->xinfovalname);
+
+    while (wt_num)
+        watch_remove(wt_num - 1);
+    free(wt_entries);
+    xidmap_free(&wt_frames);
+    xidmap_free(&wt_clients);
+    arena_release(&wt_strings);
+}
+
+/*
+ * Tree : the whole window hierarchy, walked breadth first. The QueryTree,
+ * GetWindowAttributes, GetGeometry and WM_NAME requests of all the windows
+ * of a level are sent at once and their replies collected after, so the
+ * walk costs one round trip per level of the tree, not per window.
+ */
+typedef struct _TreeNode {
+    Window win;
+    int parent;         /* index of the parent, -1 for the root */
+    int first_child;    /* the children of a node are contiguous, top first */
+    int num_children;
+    int level;
+    int x, y;           /* relative to the parent */
+    int abs_x, abs_y;
+    unsigned int w, h, border, depth;
+    int map_state;      /* -1 : destroyed during the walk */
+    int override_redirect;
+    int input_only;
+    const char *name;
+} TreeNode;
+
+static TreeNode *tr_nodes = NULL;
+static int tr_num = 0;
+static int tr_size = 0;
+static StrArena tr_strings;
+
+    static int
+tree_add(Window win, int parent)
+{
+    TreeNode *node;
+
+    if (tr_num == tr_size)
+    {
+        tr_size = tr_size ? tr_size * 2 : 256;
+        tr_nodes = realloc(tr_nodes, tr_size * sizeof(TreeNode));
+        if (!tr_nodes)
+        {
+            fprintf(stderr, " alloc error \n");
+            exit(1);
+        }
+    }
+
+    node = &tr_nodes[tr_num];
+    memset(node, 0, sizeof(TreeNode));
+    node->win = win;
+    node->parent = parent;
+    node->level = parent < 0 ? 0 : tr_nodes[parent].level + 1;
+    node->map_state = -1;
+
+    return tr_num++;
+}
+
+/* walk the level of the nodes [start, end), appending their children */
+    static void
+tree_walk_level(int start, int end)
+{
+    xcb_query_tree_cookie_t *tree_cookies;
+    xcb_get_window_attributes_cookie_t *attr_cookies;
+    xcb_get_geometry_cookie_t *geom_cookies;
+    xcb_get_property_cookie_t *name_cookies;
+    int num = end - start;
+    int i, j;
+
+    tree_cookies = calloc(num, sizeof(xcb_query_tree_cookie_t));
+    attr_cookies = calloc(num, sizeof(xcb_get_window_attributes_cookie_t));
+    geom_cookies = calloc(num, sizeof(xcb_get_geometry_cookie_t));
+    name_cookies = calloc(num, sizeof(xcb_get_property_cookie_t));
+    if (!tree_cookies || !attr_cookies || !geom_cookies || !name_cookies)
+    {
+        fprintf(stderr, " alloc error \n");
+        exit(1);
+    }
+
+    for (i = 0; i < num; i++)
+    {
+        Window win = tr_nodes[start + i].win;
+
+        tree_cookies[i] = xcb_query_tree(xcb_conn, win);
+        attr_cookies[i] = xcb_get_window_attributes(xcb_conn, win);
+        geom_cookies[i] = xcb_get_geometry(xcb_conn, win);
+        name_cookies[i] = _send_get_property(win, XA_WM_NAME, AnyPropertyType, 64L);
+    }
+
+    for (i = 0; i < num; i++)
+    {
+        int idx = start + i;
+        xcb_query_tree_reply_t *tree;
+        xcb_get_window_attributes_reply_t *attr;
+        xcb_get_geometry_reply_t *geom;
+        xcb_get_property_reply_t *name;
+        xcb_generic_error_t *err = NULL;
+        xcb_window_t *children;
+        char str[255] = {0,};
+
+        attr = xcb_get_window_attributes_reply(xcb_conn, attr_cookies[i], &err);
+        if (err)
+        {
+            free(err);
+            err = NULL;
+        }
+        if (attr)
+        {
+            tr_nodes[idx].map_state = attr->map_state;
+            tr_nodes[idx].override_redirect = attr->override_redirect;
+            tr_nodes[idx].input_only = attr->_class == XCB_WINDOW_CLASS_INPUT_ONLY;
+            free(attr);
+        }
+
+        geom = xcb_get_geometry_reply(xcb_conn, geom_cookies[i], &err);
+        if (err)
+        {
+            free(err);
+            err = NULL;
+        }
+        if (geom)
+        {
+            TreeNode *node = &tr_nodes[idx];
+
+            node->x = geom->x;
+            node->y = geom->y;
+            node->w = geom->width;
+            node->h = geom->height;
+            node->border = geom->border_width;
+            node->depth = geom->depth;
+
+            /* the children are placed inside the border of their parent */
+            if (node->parent >= 0)
+            {
+                TreeNode *parent = &tr_nodes[node->parent];
+
+                node->abs_x = parent->abs_x + (int)parent->border + node->x;
+                node->abs_y = parent->abs_y + (int)parent->border + node->y;
+            }
+            free(geom);
+        }
+
+        name = _get_property_reply(name_cookies[i]);
+        get_winname(name, NULL, str);
+        free(name);
+        if (str[0])
+            tr_nodes[idx].name = arena_strdup(&tr_strings, str);
+
+        tree = xcb_query_tree_reply(xcb_conn, tree_cookies[i], &err);
+        if (err)
+        {
+            free(err);
+            err = NULL;
+        }
+        if (!tree)
+            continue;
+
+        /* the stacking order is bottom first */
+        children = xcb_query_tree_children(tree);
+        tr_nodes[idx].first_child = tr_num;
+        tr_nodes[idx].num_children = xcb_query_tree_children_length(tree);
+        for (j = tr_nodes[idx].num_children - 1; j >= 0; j--)
+            tree_add(children[j], idx);
+        free(tree);
+    }
+
+    free(tree_cookies);
+    free(attr_cookies);
+    free(geom_cookies);
+    free(name_cookies);
+}
+
+    static void
+tree_print(FILE *fd, int idx)
+{
+    TreeNode *node = &tr_nodes[idx];
+    int i;
+
+    fprintf(fd, "%*s0x%lx %s%s%s  ", node->level * 2, "", node->win,
+            node->parent < 0 ? "(root)" : "\"", node->parent < 0 ? "" : (node->name ? node->name : ""),
+            node->parent < 0 ? "" : "\"");
+    if (node->map_state < 0)
+    {
+        fprintf(fd, "destroyed\n");
+        return;
+    }
+    fprintf(fd, "%ux%u+%d+%d  abs %d,%d  border %u  depth %u  %s%s%s",
+            node->w, node->h, node->x, node->y, node->abs_x, node->abs_y, node->border, node->depth,
+            Lookup(node->map_state, _map_states), node->override_redirect ? "  override" : "",
+            node->input_only ? "  InputOnly" : "");
+    if (node->num_children)
+        fprintf(fd, "  %d children", node->num_children);
+    fprintf(fd, "\n");
+
+    for (i = 0; i < node->num_children; i++)
+        tree_print(fd, node->first_child + i);
+}
+
+    static void
+tree(XinfoPtr pXinfo)
+{
+    Window root_win = RootWindow(dpy, screen);
+    FILE *fd = pXinfo->output_fd;
+    int start = 0, end, levels = 0;
+
+    /* the windows come and go while the tree is walked */
+    old_x_error = XSetErrorHandler(cb_x_error);
+
+    tree_add(root_win, -1);
+    while (start < tr_num)
+    {
+        end = tr_num;
+        tree_walk_level(start, end);
+        start = end;
+        levels++;
+    }
+
+    print_default(fd, root_win, tr_nodes[0].num_children);
+    fprintf(fd, "----------------------------------[ %s ]-------------------------------------------------------------------------------\n",
+            pXinfo->xinfovalname);
+    tree_print(fd, 0);
+    fprintf(fd, "\n%d windows, %d levels\n", tr_num, levels);
+
+    free(tr_nodes);
+    tr_nodes = NULL;
+    tr_num = tr_size = 0;
+    arena_release(&tr_strings);
+}
+
+    static void
+open_display(void)
+{
+    /* open a display and get a default screen */
+    dpy = XOpenDisplay(0);
+    if(!dpy)
+    {
+        printf("Fail to open display\n");
+        exit(0);
+    }
+    xcb_conn = XGetXCBConnection(dpy);
+
+    /* get a screen*/
+    screen = DefaultScreen(dpy);
+}
+
+/*
+ * Fill the table with the top level windows of the mode, top first.
+ */
+    static void
+scan_topwins(int wininfo_val, long timeout, WininfoTable *table)
+{
+    int i;
+    Window root_win, parent_win;
+    unsigned int num_children;
+    Window *child_list;
+    Window window;
+    xcb_get_window_attributes_cookie_t *attr_cookies = NULL;
+    Window *frames = NULL, *clients = NULL;
+    int *map_states = NULL;
+    int num = 0;
+    WininfoPtr *wins = NULL;
+    int visible_only;
+
+    /* get a root window id */
+    window = RootWindow(dpy, screen);
+
+    if(wininfo_val == XINFO_PING)
+        XSelectInput (dpy, window, ExposureMask|     SubstructureNotifyMask);
+
+    if(wininfo_val == XINFO_TOPVWINS || wininfo_val == XINFO_XWD_TOPVWINS || wininfo_val == XINFO_TOPVWINS_PROPS)
+        visible_only = TRUE;
+    else if(wininfo_val == XINFO_TOPWINS || wininfo_val == XINFO_PING)
+        visible_only = FALSE;
+    else
+    {
+        printf("Error . no valid win_state\n");
+        exit(1);
+    }
+
+    /* query a window tree */
+    if (!XQueryTree(dpy, window, &root_win, &parent_win, &child_list, &num_children))
+        Fatal_Error("Can't query window tree.");
+
+    /* gathering the wininfo infomation */
+    WininfoPtr cur_wininfo = NULL;
+    int map_state = IsUnmapped;
+
+    memset(table, 0, sizeof(WininfoTable));
+
+    /* send the map state requests of all children at once */
+    if (num_children)
+    {
+        attr_cookies = calloc(num_children, sizeof(xcb_get_window_attributes_cookie_t));
+        frames = calloc(num_children, sizeof(Window));
+        clients = calloc(num_children, sizeof(Window));
+        map_states = calloc(num_children, sizeof(int));
+        if (!attr_cookies || !frames || !clients || !map_states)
+        {
+            fprintf(stderr, " alloc error \n");
+            exit(1);
+        }
+    }
+
+    if (visible_only)
+        for (i = 0; i < (int)num_children; i++)
+            attr_cookies[i] = xcb_get_window_attributes(xcb_conn, child_list[i]);
+
+    /* the frames of the table, top first */
+    for (i = (int)num_children - 1; i >= 0; i--)
+    {
+        if (visible_only)
+        {
+            xcb_get_window_attributes_reply_t *attr;
+            xcb_generic_error_t *err = NULL;
+
+            /* figure out whether the window is mapped or not */
+            attr = xcb_get_window_attributes_reply(xcb_conn, attr_cookies[i], &err);
+            if (err)
+                free(err);
+            map_state = attr ? attr->map_state : IsUnmapped;
+            free(attr);
+
+            if(!map_state)
+                continue;
+        }
+
+        frames[num] = child_list[i];
+        map_states[num++] = map_state;
+    }
+
+    /* check the window generated in client side not is done by window manager */
+    get_client_windows(frames, clients, num);
+
+    for (i = 0; i < num; i++)
+    {
+        cur_wininfo = wininfo_table_add(table, frames[i], clients[i]);
+        if (visible_only)
+            cur_wininfo->map_state = Lookup(map_states[i], _map_states);
+    }
+
+    free(attr_cookies);
+    free(frames);
+    free(clients);
+    free(map_states);
+
+    if (child_list)
+        XFree((char *)child_list);
+
+    if (table->num == 0)
+        return;
+
+    /* check other infomation out */
+    wins = calloc(table->num, sizeof(WininfoPtr));
+    if (!wins)
+    {
+        fprintf(stderr, " alloc error \n");
+        exit(1);
+    }
+
+    for(i = 0; i < table->num; i++)
+        wins[i] = &table->wins[i];
+
+    query_wininfo(wins, table->num, &table->strings);
+
+    /* ping test info */
+    if(wininfo_val == XINFO_PING)
+        ping_wininfo(wins, table->num, timeout);
+
+    free(wins);
+}
+
+/*
+ * Occlusion : the visible part of every viewable top level window once the
+ * windows stacked above it are taken away. The frames are walked top first
+ * keeping the union of the bounding regions seen so far, so every window
+ * costs one subtraction and one union of y-x banded regions. The geometry,
+ * the class and the Shape rectangles of all the frames are requested in one
+ * batch.
+ */
+#define OCCLUSION_MOSTLY_HIDDEN 10 /* percent */
+
+#define OCCLUSION_COLUMNS "no", "pid", "border_id", "winid", "x", "y", "w", "h", "area", "visible", \
+                          "visible_pct", "shaped", "state", "winname", "appname"
+
+static const char *const _occlusion_columns[] = { OCCLUSION_COLUMNS, NULL };
+
+typedef struct _OcclusionCookies {
+    xcb_get_geometry_cookie_t geometry;
+    xcb_get_window_attributes_cookie_t attr;
+    xcb_shape_get_rectangles_cookie_t shape;
+} OcclusionCookies;
+
+    static long
+region_area(Region region)
+{
+    long area = 0;
+    long i;
+
+    for (i = 0; i < region->numRects; i++)
+        area += (long)(region->rects[i].x2 - region->rects[i].x1) *
+                (region->rects[i].y2 - region->rects[i].y1);
+
+    return area;
+}
+
+/* the bounding region of the frame in root coordinates */
+    static void
+occlusion_region(Region region, xcb_get_geometry_reply_t *geom, xcb_shape_get_rectangles_reply_t *shape, int *shaped)
+{
+    xcb_rectangle_t *rects;
+    XRectangle rect;
+    int i, num;
+
+    rect.x = geom->x;
+    rect.y = geom->y;
+    rect.width = geom->width + 2 * geom->border_width;
+    rect.height = geom->height + 2 * geom->border_width;
+    *shaped = FALSE;
+
+    if (!shape)
+    {
+        XUnionRectWithRegion(&rect, region, region);
+        return;
+    }
+
+    /* the rectangles are relative to the inside of the border */
+    rects = xcb_shape_get_rectangles_rectangles(shape);
+    num = xcb_shape_get_rectangles_rectangles_length(shape);
+    for (i = 0; i < num; i++)
+    {
+        XRectangle r;
+
+        r.x = geom->x + geom->border_width + rects[i].x;
+        r.y = geom->y + geom->border_width + rects[i].y;
+        r.width = rects[i].width;
+        r.height = rects[i].height;
+        if (r.x != rect.x || r.y != rect.y || r.width != rect.width || r.height != rect.height)
+            *shaped = TRUE;
+        XUnionRectWithRegion(&r, region, region);
+    }
+    if (num != 1)
+        *shaped = TRUE;
+}
+
+    static void
+occlusion(XinfoPtr pXinfo)
+{
+    const xcb_query_extension_reply_t *ext;
+    Window root_win = RootWindow(dpy, screen);
+    FILE *fd = pXinfo->output_fd;
+    WininfoTable table;
+    OcclusionCookies *cookies = NULL;
+    Region covered, region, visible, screen_region;
+    XRectangle rect;
+    WriterPtr wr = NULL;
+    int has_shape;
+    int num_visible = 0, num_partial = 0, num_mostly = 0, num_hidden = 0;
+    long hidden_area = 0;
+    int i;
+
+    scan_topwins(XINFO_TOPVWINS, pXinfo->timeout, &table);
+
+    ext = xcb_get_extension_data(xcb_conn, &xcb_shape_id);
+    has_shape = ext && ext->present;
+
+    if (table.num)
+    {
+        cookies = calloc(table.num, sizeof(OcclusionCookies));
+        if (!cookies)
+        {
+            fprintf(stderr, " alloc error \n");
+            exit(1);
+        }
+    }
+    for (i = 0; i < table.num; i++)
+    {
+        cookies[i].geometry = xcb_get_geometry(xcb_conn, table.wins[i].BDid);
+        cookies[i].attr = xcb_get_window_attributes(xcb_conn, table.wins[i].BDid);
+        if (has_shape)
+            cookies[i].shape = xcb_shape_get_rectangles(xcb_conn, table.wins[i].BDid, XCB_SHAPE_SK_BOUNDING);
+    }
+
+    covered = XCreateRegion();
+    region = XCreateRegion();
+    visible = XCreateRegion();
+    screen_region = XCreateRegion();
+    rect.x = rect.y = 0;
+    rect.width = DisplayWidth(dpy, screen);
+    rect.height = DisplayHeight(dpy, screen);
+    XUnionRectWithRegion(&rect, screen_region, screen_region);
+
+    if (pXinfo->format != XINFO_FORMAT_TEXT)
+        wr = writer_open(fd, pXinfo->format, _occlusion_columns);
+    else
+    {
+        print_default(fd, root_win, table.num);
+        fprintf(fd, "----------------------------------[ %s ]-------------------------------------------------------------------------------------------------------------\n",
+                pXinfo->xinfovalname);
+        fprintf(fd, " No    PID  BorderID    WinID     Geometry                Area(px) Visible(px) Visible  Shape  State          WinName                   AppName\n");
+        fprintf(fd, "-----------------------------------------------------------------------------------------------------------------------------------------------------------\n");
+    }
+
+    for (i = 0; i < table.num; i++)
+    {
+        WininfoPtr w = &table.wins[i];
+        xcb_get_geometry_reply_t *geom;
+        xcb_get_window_attributes_reply_t *attr;
+        xcb_shape_get_rectangles_reply_t *shape = NULL;
+        xcb_generic_error_t *err = NULL;
+        const char *state;
+        char geometry[64];
+        long area, vis_area;
+        double percent;
+        int shaped;
+
+        geom = xcb_get_geometry_reply(xcb_conn, cookies[i].geometry, &err);
+        if (err)
+        {
+            free(err);
+            err = NULL;
+        }
+        attr = xcb_get_window_attributes_reply(xcb_conn, cookies[i].attr, &err);
+        if (err)
+        {
+            free(err);
+            err = NULL;
+        }
+        if (has_shape)
+        {
+            shape = xcb_shape_get_rectangles_reply(xcb_conn, cookies[i].shape, &err);
+            if (err)
+                free(err);
+        }
+
+        /* destroyed since the scan */
+        if (!geom || !attr)
+        {
+            free(geom);
+            free(attr);
+            free(shape);
+            continue;
+        }
+
+        XDestroyRegion(region);
+        region = XCreateRegion();
+        occlusion_region(region, geom, shape, &shaped);
+        area = region_area(region);
+
+        /* on the screen and not under the windows above */
+        XIntersectRegion(region, screen_region, visible);
+        XSubtractRegion(visible, covered, visible);
+        vis_area = region_area(visible);
+
+        /* an InputOnly window has no content to hide the ones below */
+        if (attr->_class != XCB_WINDOW_CLASS_INPUT_ONLY)
+            XUnionRegion(covered, region, covered);
+
+        percent = area ? vis_area * 100.0 / area : 0;
+        if (!vis_area)
+        {
+            state = "Hidden";
+            num_hidden++;
+            hidden_area += area;
+        }
+        else if (percent < OCCLUSION_MOSTLY_HIDDEN)
+        {
+            state = "Mostly hidden";
+            num_mostly++;
+        }
+        else if (vis_area == area)
+        {
+            state = "Visible";
+            num_visible++;
+        }
+        else
+        {
+            state = "Partial";
+            num_partial++;
+        }
+
+        if (wr)
+        {
+            writer_long(wr, i + 1);
+            writer_long(wr, w->pid);
+            writer_xid(wr, w->BDid);
+            writer_xid(wr, w->winid);
+            writer_long(wr, geom->x);
+            writer_long(wr, geom->y);
+            writer_long(wr, geom->width + 2 * geom->border_width);
+            writer_long(wr, geom->height + 2 * geom->border_width);
+            writer_long(wr, area);
+            writer_long(wr, vis_area);
+            writer_double(wr, percent);
+            writer_long(wr, shaped);
+            writer_str(wr, state);
+            writer_str(wr, w->winname);
+            writer_str(wr, w->appname_brief);
+            writer_end(wr);
+        }
+        else
+        {
+            snprintf(geometry, sizeof(geometry), "%dx%d+%d+%d", geom->width + 2 * geom->border_width,
+                     geom->height + 2 * geom->border_width, geom->x, geom->y);
+            fprintf(fd, "%3i %6ld  0x%-7lx 0x%-8lx %-22s %9ld %11ld %6.1f%%  %-5s  %-13s  %-25s %-25s\n",
+                    i + 1, w->pid, w->BDid, w->winid, geometry, area, vis_area, percent,
+                    shaped ? "yes" : "no", state, w->winname ? w->winname : "",
+                    w->appname_brief ? w->appname_brief : "");
+        }
+
+        free(geom);
+        free(attr);
+        free(shape);
+    }
+
+    if (wr)
+        writer_close(wr);
+    else
+    {
+        fprintf(fd, "\n%d visible, %d partial, %d mostly hidden (< %d%%), %d hidden", num_visible, num_partial,
+                num_mostly, OCCLUSION_MOSTLY_HIDDEN, num_hidden);
+        fprintf(fd, " : %ld px of mapped windows fully hidden\n", hidden_area);
+    }
+
+    XDestroyRegion(covered);
+    XDestroyRegion(region);
+    XDestroyRegion(visible);
+    XDestroyRegion(screen_region);
+    free(cookies);
+    wininfo_table_free(&table);
+    procinfo_reset();
+}
+
+/*
+ * Overdraw : how many viewable top level windows cover every pixel of the
+ * screen, the work a compositor does when it paints all of them. The outer
+ * rectangles of the top level windows, the frames with their decorations and
+ * borders as in occlusion, are rasterized at screen resolution, the summary
+ * gives the average and the most layers and the area under n layers or more,
+ * and the per pixel counts can be saved as a PGM heatmap.
+ */
+#define OVERDRAW_COLUMNS "layers", "area", "area_pct", "at_least", "at_least_pct"
+
+static const char *const _overdraw_columns[] = { OVERDRAW_COLUMNS, NULL };
+
+    static void
+overdraw(XinfoPtr pXinfo)
+{
+    Window root_win = RootWindow(dpy, screen);
+    FILE *fd = pXinfo->output_fd;
+    WininfoTable table;
+    OverdrawPtr od;
+    const OverdrawStats *stats;
+    xcb_get_geometry_cookie_t *cookies = NULL;
+    XRectangle *rects = NULL;
+    struct timespec start, end;
+    WriterPtr wr = NULL;
+    long total, at_least;
+    int num_alpha = 0;
+    int levels;
+    int i;
+
+    scan_topwins(XINFO_TOPVWINS, pXinfo->timeout, &table);
+
+    if (table.num)
+    {
+        cookies = calloc(table.num, sizeof(xcb_get_geometry_cookie_t));
+        rects = calloc(table.num, sizeof(XRectangle));
+        if (!cookies || !rects)
+        {
+            fprintf(stderr, " alloc error \n");
+            exit(1);
+        }
+    }
+    for (i = 0; i < table.num; i++)
+        cookies[i] = xcb_get_geometry(xcb_conn, table.wins[i].BDid);
+
+    /* the frames are children of the root, a gone one stays empty */
+    for (i = 0; i < table.num; i++)
+    {
+        xcb_get_geometry_reply_t *geom;
+        xcb_generic_error_t *err = NULL;
+
+        geom = xcb_get_geometry_reply(xcb_conn, cookies[i], &err);
+        if (err)
+            free(err);
+        if (geom)
+        {
+            rects[i].x = geom->x;
+            rects[i].y = geom->y;
+            rects[i].width = geom->width + 2 * geom->border_width;
+            rects[i].height = geom->height + 2 * geom->border_width;
+        }
+        free(geom);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    od = overdraw_new(DisplayWidth(dpy, screen), DisplayHeight(dpy, screen));
+    for (i = 0; i < table.num; i++)
+    {
+        overdraw_add(od, rects[i].x, rects[i].y, rects[i].width, rects[i].height);
+        if (table.wins[i].depth == 32)
+            num_alpha++;
+    }
+    stats = overdraw_resolve(od);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    total = (long)stats->width * stats->height;
+    levels = stats->max < OVERDRAW_LEVELS ? stats->max : OVERDRAW_LEVELS;
+
+    if (pXinfo->format != XINFO_FORMAT_TEXT)
+        wr = writer_open(fd, pXinfo->format, _overdraw_columns);
+    else
+    {
+        print_default(fd, root_win, table.num);
+        fprintf(fd, "----------------------------------[ %s ]------------------------------------\n",
+                pXinfo->xinfovalname);
+        fprintf(fd, "  Screen                 : %dx%d (%ld px)\n", stats->width, stats->height, total);
+        fprintf(fd, "  Windows                : %d viewable, %d with alpha (depth 32)\n", table.num, num_alpha);
+        fprintf(fd, "  Covered area           : %ld px (%.1f%%)\n", stats->covered,
+                stats->covered * 100.0 / total);
+        fprintf(fd, "  Average layers         : %.2f on the screen, %.2f on the covered area\n",
+                (double)stats->layers / total, stats->covered ? (double)stats->layers / stats->covered : 0);
+        fprintf(fd, "  Max layers             : %d\n", stats->max);
+        fprintf(fd, "  Rasterized in          : %.2f ms\n", _elapsed_usec(&start, &end) / 1000.0);
+        fprintf(fd, "\n Layers     Area(px)    Area  At least(px)  At least\n");
+        fprintf(fd, "-----------------------------------------------------\n");
+    }
+
+    /* the rows go up the layers, at least n is what is left from n */
+    at_least = total;
+    for (i = 0; i <= levels; i++)
+    {
+        if (wr)
+        {
+            writer_long(wr, i);
+            writer_long(wr, stats->area[i]);
+            writer_double(wr, stats->area[i] * 100.0 / total);
+            writer_long(wr, at_least);
+            writer_double(wr, at_least * 100.0 / total);
+            writer_end(wr);
+        }
+        else
+            fprintf(fd, " %s%5d %12ld %6.1f%% %13ld %8.1f%%\n", i == OVERDRAW_LEVELS ? ">=" : "  ", i,
+                    stats->area[i], stats->area[i] * 100.0 / total, at_least, at_least * 100.0 / total);
+        at_least -= stats->area[i];
+    }
+
+    if (wr)
+        writer_close(wr);
+
+    if (pXinfo->heatmap)
+    {
+        FILE *heatmap = fopen(pXinfo->heatmap, "wb");
+
+        if (!heatmap)
+            fprintf(stderr, "Error - can open file %s\n", pXinfo->heatmap);
+        else
+        {
+            int ret = overdraw_write_pgm(od, heatmap);
+
+            /* closed even when the write failed */
+            if (fclose(heatmap) != 0 || ret < 0)
+                fprintf(stderr, "Error - can write file %s\n", pXinfo->heatmap);
+            else if (!wr)
+                fprintf(fd, "\nHeatmap : %s (gray level = layers)\n", pXinfo->heatmap);
+        }
+    }
+
+    overdraw_free(od);
+    free(cookies);
+    free(rects);
+    wininfo_table_free(&table);
+    procinfo_reset();
+}
+
+/*
+ * Server side memory per application, from the X-Resource extension. The
+ * resources and the pixmap bytes of all the clients are requested in one
+ * batch, and the pids of all of them in a single QueryClientIds when the
+ * server has XRes 1.2. A client is also joined to the top level windows by
+ * the resource base of the client window ids, which names it and gives its
+ * _NET_WM_PID on an older server. The clients of a pid are summed and the
+ * applications are sorted by their pixmap bytes.
+ */
+#define XRES_COLUMNS "no", "pid", "clients", "resource_base", "windows", "pixmaps", "gcs", "pictures", \
+                     "others", "pixmap_bytes", "appname"
+
+static const char *const _xres_columns[] = { XRES_COLUMNS, NULL };
+
+enum XRES_TYPE
+{
+    XRES_WINDOW,
+    XRES_PIXMAP,
+    XRES_GC,
+    XRES_PICTURE,
+    NUM_XRES_TYPES
+};
+
+static char *_xres_type_names[NUM_XRES_TYPES] = { "WINDOW", "PIXMAP", "GC", "PICTURE" };
+
+typedef struct _XresClient {
+    uint32_t base;              /* resource base of the client */
+    long pid;                   /* -1 : unknown */
+    const char *appname;        /* in the strings of the window table */
+    long count[NUM_XRES_TYPES];
+    long others;
+    uint64_t pixmap_bytes;
+} XresClient, *XresClientPtr;
+
+typedef struct _XresApp {
+    long pid;                   /* -1 : unknown, one entry per client */
+    uint32_t base;              /* resource base of the first client */
+    const char *appname;
+    int clients;
+    long count[NUM_XRES_TYPES];
+    long others;
+    uint64_t pixmap_bytes;
+} XresApp, *XresAppPtr;
+
+typedef struct _XresCookies {
+    xcb_res_query_client_resources_cookie_t resources;
+    xcb_res_query_client_pixmap_bytes_cookie_t pixmap_bytes;
+} XresCookies;
+
+    static long
+xres_resources(const long *count, long others)
+{
+    return count[XRES_WINDOW] + count[XRES_PIXMAP] + count[XRES_GC] + count[XRES_PICTURE] + others;
+}
+
+/*
+ * One sample of all the clients with the top level windows of the moment in
+ * table. Returns the number of clients in *out, to free, -1 on error.
+ */
+/* the client of a resource base, -1 if none. The XidMap can't hold the base
+ * 0 of the server itself, which has a slot of its own */
+    static int
+xres_index(XidMap *map, int server, Window base)
+{
+    if (!base)
+        return server;
+
+    return (int)(intptr_t)xidmap_find(map, base) - 1;
+}
+
+    static int
+xres_sample(long timeout, WininfoTable *table, XresClientPtr *out)
+{
+    const xcb_query_extension_reply_t *ext;
+    xcb_res_query_version_cookie_t version_cookie;
+    xcb_res_query_clients_cookie_t clients_cookie;
+    xcb_res_query_client_ids_cookie_t ids_cookie;
+    xcb_res_query_version_reply_t *version;
+    xcb_res_query_clients_reply_t *clients_reply;
+    xcb_res_query_client_ids_reply_t *ids;
+    xcb_res_client_t *clients;
+    xcb_res_client_id_spec_t *specs = NULL;
+    xcb_generic_error_t *err = NULL;
+    Atom type_atoms[NUM_XRES_TYPES];
+    XresCookies *cookies = NULL;
+    XresClient *res = NULL;
+    XidMap client_map;
+    int server = -1;
+    int has_ids;
+    int num_clients, num = 0;
+    char str[255];
+    int i, j;
+
+    ext = xcb_get_extension_data(xcb_conn, &xcb_res_id);
+    if (!ext || !ext->present)
+    {
+        fprintf(stderr, "Error : no X-Resource extension \n");
+        return -1;
+    }
+
+    version_cookie = xcb_res_query_version(xcb_conn, XCB_RES_MAJOR_VERSION, XCB_RES_MINOR_VERSION);
+    clients_cookie = xcb_res_query_clients(xcb_conn);
+    version = xcb_res_query_version_reply(xcb_conn, version_cookie, &err);
+    if (err)
+    {
+        free(err);
+        err = NULL;
+    }
+    clients_reply = xcb_res_query_clients_reply(xcb_conn, clients_cookie, &err);
+    if (err)
+    {
+        free(err);
+        err = NULL;
+    }
+    if (!version || !clients_reply)
+    {
+        fprintf(stderr, "Error : fail to query the X-Resource clients \n");
+        free(version);
+        free(clients_reply);
+        return -1;
+    }
+    has_ids = version->server_major > 1 || (version->server_major == 1 && version->server_minor >= 2);
+    free(version);
+
+    /* a type no client ever created has no atom, and stays None */
+    XInternAtoms(dpy, _xres_type_names, NUM_XRES_TYPES, True, type_atoms);
+
+    scan_topwins(XINFO_TOPWINS, timeout, table);
+
+    clients = xcb_res_query_clients_clients(clients_reply);
+    num_clients = xcb_res_query_clients_clients_length(clients_reply);
+    if (num_clients)
+    {
+        cookies = calloc(num_clients, sizeof(XresCookies));
+        specs = calloc(num_clients, sizeof(xcb_res_client_id_spec_t));
+        res = calloc(num_clients, sizeof(XresClient));
+        if (!cookies || !specs || !res)
+        {
+            fprintf(stderr, " alloc error \n");
+            exit(1);
+        }
+    }
+
+    /* all the requests of all the clients before the first reply */
+    memset(&client_map, 0, sizeof(XidMap));
+    for (i = 0; i < num_clients; i++)
+    {
+        cookies[i].resources = xcb_res_query_client_resources(xcb_conn, clients[i].resource_base);
+        cookies[i].pixmap_bytes = xcb_res_query_client_pixmap_bytes(xcb_conn, clients[i].resource_base);
+        specs[i].client = clients[i].resource_base;
+        specs[i].mask = XCB_RES_CLIENT_ID_MASK_LOCAL_CLIENT_PID;
+        res[i].base = clients[i].resource_base;
+        res[i].pid = -1;
+        if (clients[i].resource_base)
+            xidmap_put(&client_map, clients[i].resource_base, (void *)(intptr_t)(i + 1));
+        else
+            server = i;
+    }
+    if (has_ids && num_clients)
+        ids_cookie = xcb_res_query_client_ids(xcb_conn, num_clients, specs);
+
+    /* the windows name the clients, their _NET_WM_PID stands in for an old server */
+    for (i = 0; i < table->num && num_clients; i++)
+    {
+        WininfoPtr w = &table->wins[i];
+        int idx = xres_index(&client_map, server, w->winid & ~clients[0].resource_mask);
+
+        if (idx < 0)
+            continue;
+        if (!res[idx].appname)
+            res[idx].appname = w->appname_brief;
+        if (res[idx].pid < 0 && w->pid > 0)
+            res[idx].pid = w->pid;
+    }
+
+    if (has_ids && num_clients)
+    {
+        ids = xcb_res_query_client_ids_reply(xcb_conn, ids_cookie, &err);
+        if (err)
+        {
+            free(err);
+            err = NULL;
+        }
+        if (ids)
+        {
+            xcb_res_client_id_value_iterator_t it = xcb_res_query_client_ids_ids_iterator(ids);
+
+            for (; it.rem; xcb_res_client_id_value_next(&it))
+            {
+                int idx = xres_index(&client_map, server, it.data->spec.client);
+
+                if (idx >= 0 && (it.data->spec.mask & XCB_RES_CLIENT_ID_MASK_LOCAL_CLIENT_PID) &&
+                    xcb_res_client_id_value_value_length(it.data) >= 1)
+                    res[idx].pid = *xcb_res_client_id_value_value(it.data);
+            }
+            free(ids);
+        }
+    }
+
+    for (i = 0; i < num_clients; i++)
+    {
+        xcb_res_query_client_resources_reply_t *resources;
+        xcb_res_query_client_pixmap_bytes_reply_t *bytes;
+        xcb_res_type_t *types;
+        XresClientPtr c;
+        int num_types;
+
+        resources = xcb_res_query_client_resources_reply(xcb_conn, cookies[i].resources, &err);
+        if (err)
+        {
+            free(err);
+            err = NULL;
+        }
+        bytes = xcb_res_query_client_pixmap_bytes_reply(xcb_conn, cookies[i].pixmap_bytes, &err);
+        if (err)
+        {
+            free(err);
+            err = NULL;
+        }
+
+        /* gone since the list of the clients */
+        if (!resources || !bytes)
+        {
+            free(resources);
+            free(bytes);
+            continue;
+        }
+
+        /* packed in place, num never passes i */
+        c = &res[num++];
+        if (c != &res[i])
+            *c = res[i];
+
+        types = xcb_res_query_client_resources_types(resources);
+        num_types = xcb_res_query_client_resources_types_length(resources);
+        for (j = 0; j < num_types; j++)
+        {
+            int t;
+
+            for (t = 0; t < NUM_XRES_TYPES; t++)
+                if (type_atoms[t] != None && types[j].resource_type == type_atoms[t])
                     break;
+            if (t < NUM_XRES_TYPES)
+                c->count[t] += types[j].count;
+            else
+                c->others += types[j].count;
+        }
+        c->pixmap_bytes = bytes->bytes + ((uint64_t)bytes->bytes_overflow << 32);
+
+        /* the clients without a window are named by their command line */
+        if (!c->appname && c->pid > 0)
+        {
+            const char *cmdline = procinfo_cmdline(c->pid);
+
+            if (cmdline)
+            {
+                snprintf(str, sizeof(str), "%s", cmdline);
+                get_appname_brief(str);
+                c->appname = arena_strdup(&table->strings, str);
+            }
+        }
+
+        free(resources);
+        free(bytes);
+    }
+
+    xidmap_free(&client_map);
+    free(cookies);
+    free(specs);
+    free(clients_reply);
+
+    *out = res;
+    return num;
+}
+
+    static int
+xres_app_cmp(const void *a, const void *b)
+{
+    const XresApp *x = a, *y = b;
+    long x_num = xres_resources(x->count, x->others);
+    long y_num = xres_resources(y->count, y->others);
+
+    if (x->pixmap_bytes != y->pixmap_bytes)
+        return x->pixmap_bytes < y->pixmap_bytes ? 1 : -1;
+    if (x_num != y_num)
+        return x_num < y_num ? 1 : -1;
+    return 0;
+}
+
+    static void
+xres(XinfoPtr pXinfo)
+{
+    Window root_win = RootWindow(dpy, screen);
+    FILE *fd = pXinfo->output_fd;
+    WininfoTable table;
+    XresClient *clients = NULL;
+    XresApp *apps = NULL;
+    XidMap app_map;
+    WriterPtr wr = NULL;
+    int num_clients, num_apps = 0;
+    uint64_t total_bytes = 0;
+    int i, t;
+
+    num_clients = xres_sample(pXinfo->timeout, &table, &clients);
+    if (num_clients < 0)
+        return;
+
+    if (num_clients)
+    {
+        apps = calloc(num_clients, sizeof(XresApp));
+        if (!apps)
+        {
+            fprintf(stderr, " alloc error \n");
+            exit(1);
+        }
+    }
+
+    memset(&app_map, 0, sizeof(XidMap));
+    for (i = 0; i < num_clients; i++)
+    {
+        XresClientPtr c = &clients[i];
+        XresAppPtr app = NULL;
+
+        if (c->pid > 0)
+            app = xidmap_find(&app_map, c->pid);
+        if (!app)
+        {
+            app = &apps[num_apps++];
+            app->pid = c->pid;
+            app->base = c->base;
+            if (c->pid > 0)
+                xidmap_put(&app_map, c->pid, app);
+        }
+        if (!app->appname)
+            app->appname = c->appname;
+        app->clients++;
+        for (t = 0; t < NUM_XRES_TYPES; t++)
+            app->count[t] += c->count[t];
+        app->others += c->others;
+        app->pixmap_bytes += c->pixmap_bytes;
+        total_bytes += c->pixmap_bytes;
+    }
+
+    if (num_apps)
+        qsort(apps, num_apps, sizeof(XresApp), xres_app_cmp);
+
+    if (pXinfo->format != XINFO_FORMAT_TEXT)
+        wr = writer_open(fd, pXinfo->format, _xres_columns);
+    else
+    {
+        print_default(fd, root_win, table.num);
+        fprintf(fd, "----------------------------------[ %s ]--------------------------------------------------------------------\n",
+                pXinfo->xinfovalname);
+        fprintf(fd, " No    PID  Clients  ResBase     Windows  Pixmaps      GCs Pictures   Others   Pixmap(KB)  AppName\n");
+        fprintf(fd, "------------------------------------------------------------------------------------------------------------\n");
+    }
+
+    for (i = 0; i < num_apps; i++)
+    {
+        XresAppPtr app = &apps[i];
+
+        if (wr)
+        {
+            writer_long(wr, i + 1);
+            write_long_or_null(wr, app->pid > 0 ? app->pid : -1);
+            writer_long(wr, app->clients);
+            writer_xid(wr, app->base);
+            writer_long(wr, app->count[XRES_WINDOW]);
+            writer_long(wr, app->count[XRES_PIXMAP]);
+            writer_long(wr, app->count[XRES_GC]);
+            writer_long(wr, app->count[XRES_PICTURE]);
+            writer_long(wr, app->others);
+            writer_long(wr, (long)app->pixmap_bytes);
+            writer_str(wr, app->appname);
+            writer_end(wr);
+        }
+        else
+        {
+            fprintf(fd, "%3i", i + 1);
+            print_long_column(fd, 6, app->pid > 0 ? app->pid : -1);
+            fprintf(fd, " %8d  0x%-8x %8ld %8ld %8ld %8ld %8ld %12lu  %s\n", app->clients, app->base,
+                    app->count[XRES_WINDOW], app->count[XRES_PIXMAP], app->count[XRES_GC],
+                    app->count[XRES_PICTURE], app->others, (unsigned long)(app->pixmap_bytes / 1024),
+                    app->appname ? app->appname : "");
+        }
+    }
+
+    if (wr)
+        writer_close(wr);
+    else
+        fprintf(fd, "\n%d clients, %d applications : %lu KB of pixmaps\n", num_clients, num_apps,
+                (unsigned long)(total_bytes / 1024));
+
+    xidmap_free(&app_map);
+    free(clients);
+    free(apps);
+    wininfo_table_free(&table);
+    procinfo_reset();
+}
+
+/*
+ * Leakwatch : sample the X-Resource usage of all the clients on a fixed
+ * cadence over one connection and look for steady growth. Every client
+ * keeps a ring of its last samples, the growth of its pixmap bytes and of
+ * its resources is the least squares slope over the ring, and it is steady
+ * when the line fits the samples well. A client which grows steadily faster
+ * than the threshold is reported as leaking, and as stable when it stops.
+ * A client is forgotten with its samples as soon as it is gone.
+ */
+#define LEAKWATCH_SAMPLES 120       /* ring of the last samples of a client */
+#define LEAKWATCH_MIN_SAMPLES 10    /* before a trend is trusted */
+#define LEAKWATCH_MIN_FIT 0.8       /* r squared of a steady growth */
+#define LEAKWATCH_RES_SLOPE 100     /* resources per hour */
+
+typedef struct _LeakEntry {
+    uint32_t base;              /* resource base of the client */
+    long pid;
+    char appname[64];
+    double time[LEAKWATCH_SAMPLES];     /* hours since the start */
+    double bytes[LEAKWATCH_SAMPLES];
+    double resources[LEAKWATCH_SAMPLES];
+    int head;
+    int num;
+    int seen;                   /* in the last sample */
+    int leaking;
+    double bytes_slope;         /* per hour */
+    double res_slope;
+    double fit;                 /* r squared of the worst growth */
+} LeakEntry, *LeakEntryPtr;
+
+static LeakEntryPtr *lw_entries = NULL;
+static int lw_num = 0;
+static int lw_size = 0;
+static XidMap lw_map;           /* resource base -> entry */
+static LeakEntryPtr lw_server = NULL; /* resource base 0, not in lw_map */
+static volatile sig_atomic_t lw_quit = 0;
+
+    static void
+leakwatch_signal(int sig)
+{
+    lw_quit = 1;
+}
+
+/* least squares slope of y over the samples of the entry, r squared in *fit */
+    static double
+leakwatch_slope(LeakEntryPtr entry, const double *y, double *fit)
+{
+    double mx = 0, my = 0, sxx = 0, syy = 0, sxy = 0;
+    int i;
+
+    for (i = 0; i < entry->num; i++)
+    {
+        mx += entry->time[i];
+        my += y[i];
+    }
+    mx /= entry->num;
+    my /= entry->num;
+
+    for (i = 0; i < entry->num; i++)
+    {
+        sxx += (entry->time[i] - mx) * (entry->time[i] - mx);
+        syy += (y[i] - my) * (y[i] - my);
+        sxy += (entry->time[i] - mx) * (y[i] - my);
+    }
+
+    if (sxx == 0 || syy == 0)
+    {
+        *fit = 0;
+        return 0;
+    }
+    *fit = sxy * sxy / (sxx * syy);
+
+    return sxy / sxx;
+}
+
+    static LeakEntryPtr
+leakwatch_add(XresClientPtr c)
+{
+    LeakEntryPtr entry;
+
+    entry = c->base ? xidmap_find(&lw_map, c->base) : lw_server;
+    if (entry)
+    {
+        /* the resource base of a gone client was given to a new one */
+        if (entry->pid != c->pid)
+        {
+            entry->num = entry->head = 0;
+            entry->leaking = FALSE;
+            entry->appname[0] = '\0';
+        }
+    }
+    else
+    {
+        if (lw_num == lw_size)
+        {
+            lw_size = lw_size ? lw_size * 2 : 64;
+            lw_entries = realloc(lw_entries, lw_size * sizeof(LeakEntryPtr));
+            if (!lw_entries)
+            {
+                fprintf(stderr, " alloc error \n");
+                exit(1);
+            }
+        }
+
+        entry = calloc(1, sizeof(LeakEntry));
+        if (!entry)
+        {
+            fprintf(stderr, " alloc error \n");
+            exit(1);
+        }
+        entry->base = c->base;
+        lw_entries[lw_num++] = entry;
+        if (c->base)
+            xidmap_put(&lw_map, c->base, entry);
+        else
+            lw_server = entry;
+    }
+
+    entry->pid = c->pid;
+    if (c->appname && !entry->appname[0])
+        snprintf(entry->appname, sizeof(entry->appname), "%s", c->appname);
+
+    return entry;
+}
+
+    static void
+leakwatch_report(FILE *fd, LeakEntryPtr entry, const char *event)
+{
+    char stamp[64];
+    int last = (entry->head + LEAKWATCH_SAMPLES - 1) % LEAKWATCH_SAMPLES;
+
+    watchdog_timestamp(stamp, sizeof(stamp));
+    fprintf(fd, "%s [%-7s] 0x%-8x pid %6ld %-30s : %+.0f KB/h pixmaps (%.0f KB), %+.0f resources/h (%.0f), fit %.2f over %.1f min\n",
+            stamp, event, entry->base, entry->pid, entry->appname, entry->bytes_slope / 1024,
+            entry->bytes[last] / 1024, entry->res_slope, entry->resources[last], entry->fit,
+            (entry->time[last] - entry->time[entry->num == LEAKWATCH_SAMPLES ? entry->head : 0]) * 60);
+    fflush(fd);
+}
+
+    static void
+leakwatch_update(FILE *fd, LeakEntryPtr entry, XresClientPtr c, double now, long threshold)
+{
+    double bytes_fit, res_fit;
+    int leaking;
+
+    entry->time[entry->head] = now;
+    entry->bytes[entry->head] = c->pixmap_bytes;
+    entry->resources[entry->head] = xres_resources(c->count, c->others);
+    entry->head = (entry->head + 1) % LEAKWATCH_SAMPLES;
+    if (entry->num < LEAKWATCH_SAMPLES)
+        entry->num++;
+    entry->seen = TRUE;
+
+    if (entry->num < LEAKWATCH_MIN_SAMPLES)
+        return;
+
+    entry->bytes_slope = leakwatch_slope(entry, entry->bytes, &bytes_fit);
+    entry->res_slope = leakwatch_slope(entry, entry->resources, &res_fit);
+
+    leaking = FALSE;
+    entry->fit = 0;
+    if (entry->bytes_slope >= threshold * 1024.0 && bytes_fit >= LEAKWATCH_MIN_FIT)
+    {
+        leaking = TRUE;
+        entry->fit = bytes_fit;
+    }
+    if (entry->res_slope >= LEAKWATCH_RES_SLOPE && res_fit >= LEAKWATCH_MIN_FIT)
+    {
+        leaking = TRUE;
+        if (res_fit > entry->fit)
+            entry->fit = res_fit;
+    }
+
+    if (leaking != entry->leaking)
+    {
+        entry->leaking = leaking;
+        if (!leaking)
+            entry->fit = bytes_fit > res_fit ? bytes_fit : res_fit;
+        leakwatch_report(fd, entry, leaking ? "LEAK" : "STABLE");
+    }
+}
+
+/* forget the clients which were not in the last sample */
+    static void
+leakwatch_sweep(FILE *fd)
+{
+    int i, j;
+
+    for (i = 0, j = 0; i < lw_num; i++)
+    {
+        LeakEntryPtr entry = lw_entries[i];
+
+        if (!entry->seen)
+        {
+            if (entry->leaking)
+                leakwatch_report(fd, entry, "GONE");
+            if (entry == lw_server)
+                lw_server = NULL;
+            else
+                xidmap_del(&lw_map, entry->base);
+            free(entry);
+            continue;
+        }
+        entry->seen = FALSE;
+        lw_entries[j++] = entry;
+    }
+    lw_num = j;
+}
+
+    static void
+leakwatch_summary(FILE *fd)
+{
+    int i;
+
+    fprintf(fd, "\n");
+    fprintf(fd, "----------------------------------[ leakwatch ]-------------------------------------------------------------\n");
+    fprintf(fd, "    PID  ResBase    AppName                        Samples  Pixmap(KB)    KB/h  Resources  Res/h  State\n");
+    fprintf(fd, "------------------------------------------------------------------------------------------------------------\n");
+
+    for (i = 0; i < lw_num; i++)
+    {
+        LeakEntryPtr entry = lw_entries[i];
+        int last = (entry->head + LEAKWATCH_SAMPLES - 1) % LEAKWATCH_SAMPLES;
+
+        fprintf(fd, " %6ld  0x%-8x %-30s %7d %11.0f %7.0f %10.0f %6.0f  %s\n",
+                entry->pid, entry->base, entry->appname, entry->num, entry->bytes[last] / 1024,
+                entry->bytes_slope / 1024, entry->resources[last], entry->res_slope,
+                entry->leaking ? "Leaking" : (entry->num < LEAKWATCH_MIN_SAMPLES ? "Learning" : "Stable"));
+    }
+    fflush(fd);
+}
+
+    static void
+leakwatch(XinfoPtr pXinfo)
+{
+    FILE *fd = pXinfo->output_fd;
+    struct timespec begin, start, now, wait;
+    WininfoTable table;
+    XresClient *clients;
+    long elapsed;
+    int i, num;
+
+    signal(SIGINT, leakwatch_signal);
+    signal(SIGTERM, leakwatch_signal);
+
+    /* the windows come and go while they are scanned */
+    old_x_error = XSetErrorHandler(cb_x_error);
+
+    fprintf(fd, "[%s] interval %ld ms, threshold %ld KB/h or %d resources/h\n", pXinfo->xinfovalname,
+            pXinfo->interval, pXinfo->leak, LEAKWATCH_RES_SLOPE);
+    fflush(fd);
+
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    while (!lw_quit)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        num = xres_sample(pXinfo->timeout, &table, &clients);
+        if (num < 0)
+            break;
+
+        for (i = 0; i < num; i++)
+            leakwatch_update(fd, leakwatch_add(&clients[i]), &clients[i],
+                             _elapsed_usec(&begin, &start) / 3600e6, pXinfo->leak);
+        leakwatch_sweep(fd);
+
+        free(clients);
+        wininfo_table_free(&table);
+        procinfo_reset();
+
+        /* keep the cadence, a signal cuts the wait */
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        elapsed = _elapsed_usec(&start, &now) / 1000;
+        if (!lw_quit && elapsed < pXinfo->interval)
+        {
+            wait.tv_sec = (pXinfo->interval - elapsed) / 1000;
+            wait.tv_nsec = ((pXinfo->interval - elapsed) % 1000) * 1000000;
+            nanosleep(&wait, NULL);
+        }
+    }
+
+    leakwatch_summary(fd);
+
+    for (i = 0; i < lw_num; i++)
+        free(lw_entries[i]);
+    free(lw_entries);
+    xidmap_free(&lw_map);
+    lw_server = NULL;
+}
+
+/*
+ * Damage : how often and how much the viewable top level windows repaint.
+ * A Damage object reporting the raw rectangles is put on every client
+ * window and on its frame, so the events come without any request from
+ * xinfo and are counted as they are read. The damage of a frame includes
+ * the one of its client, the difference is the decoration. Damages with the
+ * same server timestamp are one update, so the updates per second are the
+ * frames per second of the window. The machine formats tell the records apart
+ * by their kind : a "window" per window, an "app" per process with the sums
+ * of its windows, and one "total" with the events and the sampling time, the
+ * fields which do not apply to a kind are null.
+ */
+#define DAMAGE_COLUMNS "record", "no", "pid", "border_id", "winid", "windows", "updates", "updates_per_sec", \
+                       "mpix_per_sec", "frame_updates_per_sec", "frame_mpix_per_sec", "events", "sec", \
+                       "winname", "appname"
+
+static const char *const _damage_columns[] = { DAMAGE_COLUMNS, NULL };
+
+typedef struct _DamageCounter {
+    Damage damage;
+    long events;
+    long updates;
+    Time last;              /* server time of the last update */
+    double area;            /* damaged pixels */
+} DamageCounter, *DamageCounterPtr;
+
+typedef struct _DamageEntry {
+    WininfoPtr info;
+    DamageCounter client;
+    DamageCounter frame;    /* no damage when the client is the frame */
+} DamageEntry, *DamageEntryPtr;
+
+typedef struct _DamageApp {
+    long pid;
+    const char *appname;
+    int windows;
+    double updates;         /* per second */
+    double mpix;            /* per second */
+} DamageApp, *DamageAppPtr;
+
+    static int
+damage_entry_cmp(const void *a, const void *b)
+{
+    const DamageEntry *x = a, *y = b;
+
+    if (x->client.area != y->client.area)
+        return x->client.area < y->client.area ? 1 : -1;
+    if (x->client.updates != y->client.updates)
+        return x->client.updates < y->client.updates ? 1 : -1;
+    return 0;
+}
+
+    static int
+damage_app_cmp(const void *a, const void *b)
+{
+    const DamageApp *x = a, *y = b;
+
+    if (x->mpix != y->mpix)
+        return x->mpix < y->mpix ? 1 : -1;
+    if (x->updates != y->updates)
+        return x->updates < y->updates ? 1 : -1;
+    return 0;
+}
+
+    static void
+damage(XinfoPtr pXinfo)
+{
+    Window root_win = RootWindow(dpy, screen);
+    FILE *fd = pXinfo->output_fd;
+    WininfoTable table;
+    DamageEntry *entries = NULL;
+    DamageApp *apps = NULL;
+    XidMap counters, app_map;
+    struct timespec start, end;
+    WriterPtr wr = NULL;
+    int event_base, error_base;
+    long events = 0;
+    double sec;
+    int num_apps = 0;
+    int i;
+    XEvent e;
+
+    if (!XDamageQueryExtension(dpy, &event_base, &error_base))
+    {
+        fprintf(stderr, "Error : no DAMAGE extension \n");
+        return;
+    }
+
+    /* the windows come and go while they are sampled */
+    damage_error_base = error_base;
+    old_x_error = XSetErrorHandler(cb_x_error);
+
+    scan_topwins(XINFO_TOPVWINS, pXinfo->timeout, &table);
+
+    if (table.num)
+    {
+        entries = calloc(table.num, sizeof(DamageEntry));
+        apps = calloc(table.num, sizeof(DamageApp));
+        if (!entries || !apps)
+        {
+            fprintf(stderr, " alloc error \n");
+            exit(1);
+        }
+    }
+
+    memset(&counters, 0, sizeof(XidMap));
+    for (i = 0; i < table.num; i++)
+    {
+        WininfoPtr w = &table.wins[i];
+
+        entries[i].info = w;
+        entries[i].client.damage = XDamageCreate(dpy, w->winid, XDamageReportRawRectangles);
+        xidmap_put(&counters, entries[i].client.damage, &entries[i].client);
+        if (w->BDid != w->winid)
+        {
+            entries[i].frame.damage = XDamageCreate(dpy, w->BDid, XDamageReportRawRectangles);
+            xidmap_put(&counters, entries[i].frame.damage, &entries[i].frame);
+        }
+    }
+    XFlush(dpy);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (_next_event(&e, &start, pXinfo->interval))
+    {
+        XDamageNotifyEvent *ev = (XDamageNotifyEvent *)&e;
+        DamageCounterPtr c;
+
+        if (e.type != event_base + XDamageNotify)
+            continue;
+        c = xidmap_find(&counters, ev->damage);
+        if (!c)
+            continue;
+
+        c->events++;
+        if (ev->timestamp != c->last)
+        {
+            c->updates++;
+            c->last = ev->timestamp;
+        }
+        c->area += (double)ev->area.width * ev->area.height;
+        events++;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    sec = _elapsed_usec(&start, &end) / 1e6;
+
+    for (i = 0; i < table.num; i++)
+    {
+        XDamageDestroy(dpy, entries[i].client.damage);
+        if (entries[i].frame.damage)
+            XDamageDestroy(dpy, entries[i].frame.damage);
+    }
+    XSync(dpy, False);
+
+    if (table.num)
+        qsort(entries, table.num, sizeof(DamageEntry), damage_entry_cmp);
+
+    if (pXinfo->format != XINFO_FORMAT_TEXT)
+        wr = writer_open(fd, pXinfo->format, _damage_columns);
+    else
+    {
+        print_default(fd, root_win, table.num);
+        fprintf(fd, "----------------------------------[ %s ]-------------------------------------------------------------------------------\n",
+                pXinfo->xinfovalname);
+        fprintf(fd, " No    PID  BorderID    WinID     Updates  Upd/s   MPix/s  Frame Upd/s  Frame MPix/s  WinName                   AppName\n");
+        fprintf(fd, "---------------------------------------------------------------------------------------------------------------------------\n");
+    }
+
+    memset(&app_map, 0, sizeof(XidMap));
+    for (i = 0; i < table.num; i++)
+    {
+        DamageEntryPtr entry = &entries[i];
+        WininfoPtr w = entry->info;
+        DamageAppPtr app = NULL;
+        DamageCounterPtr frame = entry->frame.damage ? &entry->frame : &entry->client;
+
+        if (w->pid > 0)
+            app = xidmap_find(&app_map, w->pid);
+        if (!app)
+        {
+            app = &apps[num_apps++];
+            app->pid = w->pid;
+            app->appname = w->appname_brief;
+            if (w->pid > 0)
+                xidmap_put(&app_map, w->pid, app);
+        }
+        app->windows++;
+        app->updates += entry->client.updates / sec;
+        app->mpix += entry->client.area / 1e6 / sec;
+
+        if (wr)
+        {
+            writer_str(wr, "window");
+            writer_long(wr, i + 1);
+            write_long_or_null(wr, w->pid);
+            writer_xid(wr, w->BDid);
+            writer_xid(wr, w->winid);
+            writer_null(wr);
+            writer_long(wr, entry->client.updates);
+            writer_double(wr, entry->client.updates / sec);
+            writer_double(wr, entry->client.area / 1e6 / sec);
+            writer_double(wr, frame->updates / sec);
+            writer_double(wr, frame->area / 1e6 / sec);
+            writer_long(wr, entry->client.events);
+            writer_null(wr);
+            writer_str(wr, w->winname);
+            writer_str(wr, w->appname_brief);
+            writer_end(wr);
+        }
+        else
+            fprintf(fd, "%3i %6ld  0x%-7lx 0x%-8lx %8ld %6.1f %8.2f %12.1f %13.2f  %-25s %-25s\n",
+                    i + 1, w->pid, w->BDid, w->winid, entry->client.updates, entry->client.updates / sec,
+                    entry->client.area / 1e6 / sec, frame->updates / sec, frame->area / 1e6 / sec,
+                    w->winname ? w->winname : "", w->appname_brief ? w->appname_brief : "");
+    }
+
+    if (num_apps)
+        qsort(apps, num_apps, sizeof(DamageApp), damage_app_cmp);
+
+    if (wr)
+    {
+        for (i = 0; i < num_apps; i++)
+        {
+            writer_str(wr, "app");
+            writer_long(wr, i + 1);
+            write_long_or_null(wr, apps[i].pid);
+            writer_null(wr);
+            writer_null(wr);
+            writer_long(wr, apps[i].windows);
+            writer_null(wr);
+            writer_double(wr, apps[i].updates);
+            writer_double(wr, apps[i].mpix);
+            writer_null(wr);
+            writer_null(wr);
+            writer_null(wr);
+            writer_null(wr);
+            writer_null(wr);
+            writer_str(wr, apps[i].appname);
+            writer_end(wr);
+        }
+
+        writer_str(wr, "total");
+        writer_null(wr);
+        writer_null(wr);
+        writer_null(wr);
+        writer_null(wr);
+        writer_long(wr, table.num);
+        writer_null(wr);
+        writer_null(wr);
+        writer_null(wr);
+        writer_null(wr);
+        writer_null(wr);
+        writer_long(wr, events);
+        writer_double(wr, sec);
+        writer_null(wr);
+        writer_null(wr);
+        writer_end(wr);
+
+        writer_close(wr);
+    }
+    else
+    {
+        fprintf(fd, "\n    PID  Windows   Upd/s   MPix/s  AppName\n");
+        fprintf(fd, "------------------------------------------------\n");
+        for (i = 0; i < num_apps; i++)
+            fprintf(fd, " %6ld %8d %7.1f %8.2f  %s\n", apps[i].pid, apps[i].windows, apps[i].updates,
+                    apps[i].mpix, apps[i].appname ? apps[i].appname : "");
+        fprintf(fd, "\n%ld damage events in %.2f s\n", events, sec);
+    }
+
+    xidmap_free(&counters);
+    xidmap_free(&app_map);
+    free(entries);
+    free(apps);
+    wininfo_table_free(&table);
+    procinfo_reset();
+}
+
+/*
+ * Launch : the latency of the new top level windows from their creation to
+ * their first frame. The root is watched for CreateNotify, and every new
+ * window gets PropertyChange/StructureNotify and a Damage reporting when it
+ * is first drawn, so its first _NET_WM_PID, WM_NAME, map and damage are
+ * stamped as their events are read. A window reparented into a frame of the
+ * window manager stays the one measured and the frame is dropped. With
+ * --exec the command is started by xinfo, and the first frame of a window
+ * of its pid ends the measure, which is then taken from the fork.
+ */
+enum LAUNCH_STAMP
+{
+    LAUNCH_CREATE,
+    LAUNCH_PID,
+    LAUNCH_NAME,
+    LAUNCH_MAP,
+    LAUNCH_FRAME,
+    NUM_LAUNCH_STAMPS
+};
+
+static const char *_launch_stamp_names[NUM_LAUNCH_STAMPS] = { "create", "pid", "name", "map", "first frame" };
+
+typedef struct _LaunchEntry {
+    Window win;
+    Damage damage;
+    long pid;
+    int stamped;                /* mask of the LAUNCH_STAMPs */
+    struct timespec stamp[NUM_LAUNCH_STAMPS];
+} LaunchEntry, *LaunchEntryPtr;
+
+typedef struct _LaunchApp {
+    char appname[255];
+    int launches;
+    int num[NUM_LAUNCH_STAMPS];
+    double sum[NUM_LAUNCH_STAMPS];  /* msec from the create */
+    double max;                     /* msec to the first frame */
+} LaunchApp, *LaunchAppPtr;
+
+static XidMap ln_wins;          /* window -> entry */
+static XidMap ln_damages;       /* damage -> entry */
+static LaunchApp *ln_apps = NULL;
+static int ln_num_apps = 0;
+static int ln_size_apps = 0;
+static volatile sig_atomic_t ln_quit = 0;
+
+/* the command started by --exec */
+static pid_t ln_child = 0;
+static struct timespec ln_fork;
+
+    static void
+launch_signal(int sig)
+{
+    ln_quit = 1;
+}
+
+    static void
+launch_stamp(LaunchEntryPtr entry, int stamp)
+{
+    if (entry->stamped & (1 << stamp))
+        return;
+    clock_gettime(CLOCK_MONOTONIC, &entry->stamp[stamp]);
+    entry->stamped |= 1 << stamp;
+}
+
+    static double
+launch_ms(LaunchEntryPtr entry, int stamp, struct timespec *from)
+{
+    return _elapsed_usec(from, &entry->stamp[stamp]) / 1000.0;
+}
+
+    static void
+launch_read_pid(LaunchEntryPtr entry)
+{
+    xcb_get_property_reply_t *reply;
+    unsigned int pid;
+
+    reply = _get_property_reply(_send_get_property(entry->win, prop_pid, XA_CARDINAL, 1L));
+    if (_get_property_card32(reply, XA_CARDINAL, &pid) == 1)
+    {
+        entry->pid = pid;
+        launch_stamp(entry, LAUNCH_PID);
+    }
+    free(reply);
+}
+
+    static void
+launch_add(Window win)
+{
+    xcb_get_property_reply_t *name;
+    LaunchEntryPtr entry;
+
+    if (xidmap_find(&ln_wins, win))
+        return;
+
+    entry = calloc(1, sizeof(LaunchEntry));
+    if (!entry)
+    {
+        fprintf(stderr, " alloc error \n");
+        exit(1);
+    }
+    entry->win = win;
+    launch_stamp(entry, LAUNCH_CREATE);
+
+    XSelectInput(dpy, win, PropertyChangeMask | StructureNotifyMask);
+    entry->damage = XDamageCreate(dpy, win, XDamageReportNonEmpty);
+    xidmap_put(&ln_wins, win, entry);
+    xidmap_put(&ln_damages, entry->damage, entry);
+
+    /* set between the create and the selection of the events */
+    launch_read_pid(entry);
+    name = _get_property_reply(_send_get_property(win, XA_WM_NAME, AnyPropertyType, 0L));
+    if (name && name->type != None)
+        launch_stamp(entry, LAUNCH_NAME);
+    free(name);
+}
+
+    static void
+launch_remove(LaunchEntryPtr entry)
+{
+    xidmap_del(&ln_wins, entry->win);
+    xidmap_del(&ln_damages, entry->damage);
+    free(entry);
+}
+
+/* stop following a window which is still alive */
+    static void
+launch_release(LaunchEntryPtr entry)
+{
+    XSelectInput(dpy, entry->win, NoEventMask);
+    XDamageDestroy(dpy, entry->damage);
+    launch_remove(entry);
+}
+
+    static LaunchAppPtr
+launch_app(const char *appname)
+{
+    int i;
+
+    for (i = 0; i < ln_num_apps; i++)
+        if (!strcmp(ln_apps[i].appname, appname))
+            return &ln_apps[i];
+
+    if (ln_num_apps == ln_size_apps)
+    {
+        ln_size_apps = ln_size_apps ? ln_size_apps * 2 : 16;
+        ln_apps = realloc(ln_apps, ln_size_apps * sizeof(LaunchApp));
+        if (!ln_apps)
+        {
+            fprintf(stderr, " alloc error \n");
+            exit(1);
+        }
+    }
+    memset(&ln_apps[ln_num_apps], 0, sizeof(LaunchApp));
+    snprintf(ln_apps[ln_num_apps].appname, sizeof(ln_apps[ln_num_apps].appname), "%s", appname);
+
+    return &ln_apps[ln_num_apps++];
+}
+
+    static void
+launch_report(FILE *fd, LaunchEntryPtr entry, const char *event, const char *appname, struct timespec *from)
+{
+    char stamp[64];
+    int i;
+
+    watchdog_timestamp(stamp, sizeof(stamp));
+    fprintf(fd, "%s [%-7s] 0x%-8lx pid %6ld %-30s :", stamp, event, entry->win, entry->pid, appname);
+    for (i = from == &entry->stamp[LAUNCH_CREATE] ? LAUNCH_PID : LAUNCH_CREATE; i < NUM_LAUNCH_STAMPS; i++)
+    {
+        if (entry->stamped & (1 << i))
+            fprintf(fd, " %s +%.1f ms%s", _launch_stamp_names[i], launch_ms(entry, i, from),
+                    i < NUM_LAUNCH_STAMPS - 1 ? "," : "");
+        else
+            fprintf(fd, " %s -%s", _launch_stamp_names[i], i < NUM_LAUNCH_STAMPS - 1 ? "," : "");
+    }
+    fprintf(fd, "\n");
+    fflush(fd);
+}
+
+/* the first frame of a window ends its launch */
+    static void
+launch_done(FILE *fd, LaunchEntryPtr entry)
+{
+    const char *cmdline = entry->pid > 0 ? procinfo_cmdline(entry->pid) : NULL;
+    LaunchAppPtr app;
+    char str[255];
+    int i;
+
+    snprintf(str, sizeof(str), "%s", cmdline ? cmdline : "-");
+    if (cmdline)
+        get_appname_brief(str);
+
+    launch_stamp(entry, LAUNCH_FRAME);
+    launch_report(fd, entry, "LAUNCH", str, &entry->stamp[LAUNCH_CREATE]);
+
+    app = launch_app(str);
+    app->launches++;
+    for (i = LAUNCH_PID; i < NUM_LAUNCH_STAMPS; i++)
+    {
+        if (!(entry->stamped & (1 << i)))
+            continue;
+        app->num[i]++;
+        app->sum[i] += launch_ms(entry, i, &entry->stamp[LAUNCH_CREATE]);
+    }
+    if (launch_ms(entry, LAUNCH_FRAME, &entry->stamp[LAUNCH_CREATE]) > app->max)
+        app->max = launch_ms(entry, LAUNCH_FRAME, &entry->stamp[LAUNCH_CREATE]);
+
+    /* end to end from the fork of --exec */
+    if (ln_child && entry->pid == ln_child)
+    {
+        launch_report(fd, entry, "EXEC", str, &ln_fork);
+        ln_quit = 1;
+    }
+
+    launch_release(entry);
+    procinfo_reset();
+}
+
+    static void
+launch_event(FILE *fd, XEvent *e, int damage_event)
+{
+    Window root_win = RootWindow(dpy, screen);
+    LaunchEntryPtr entry;
+
+    if (e->type == damage_event + XDamageNotify)
+    {
+        entry = xidmap_find(&ln_damages, ((XDamageNotifyEvent *)e)->damage);
+        if (entry)
+            launch_done(fd, entry);
+        return;
+    }
+
+    switch (e->type)
+    {
+        case CreateNotify:
+            if (e->xcreatewindow.parent == root_win && !e->xcreatewindow.override_redirect)
+                launch_add(e->xcreatewindow.window);
+            break;
+        case ReparentNotify:
+            /* the frame the window manager made for a client is not a launch */
+            if (e->xreparent.parent != root_win && xidmap_find(&ln_wins, e->xreparent.window))
+            {
+                entry = xidmap_find(&ln_wins, e->xreparent.parent);
+                if (entry)
+                    launch_release(entry);
             }
-            w = w->next;
+            break;
+        case MapNotify:
+            entry = xidmap_find(&ln_wins, e->xmap.window);
+            if (entry)
+                launch_stamp(entry, LAUNCH_MAP);
+            break;
+        case PropertyNotify:
+            entry = xidmap_find(&ln_wins, e->xproperty.window);
+            if (!entry || e->xproperty.state != PropertyNewValue)
+                break;
+            if (e->xproperty.atom == prop_pid && !(entry->stamped & (1 << LAUNCH_PID)))
+                launch_read_pid(entry);
+            else if (e->xproperty.atom == XA_WM_NAME)
+                launch_stamp(entry, LAUNCH_NAME);
+            break;
+        case DestroyNotify:
+            /* the Damage goes with the window */
+            entry = xidmap_find(&ln_wins, e->xdestroywindow.window);
+            if (entry)
+                launch_remove(entry);
+            break;
+        default:
+            break;
+    }
+}
+
+    static void
+launch_summary(FILE *fd)
+{
+    int i, j;
+
+    fprintf(fd, "\n");
+    fprintf(fd, "----------------------------------[ launch ]--------------------------------------------------------------\n");
+    fprintf(fd, " AppName                        Launches   Pid(ms)  Name(ms)   Map(ms) Frame(ms)   Max(ms)\n");
+    fprintf(fd, "----------------------------------------------------------------------------------------------------------\n");
+
+    for (i = 0; i < ln_num_apps; i++)
+    {
+        LaunchAppPtr app = &ln_apps[i];
+
+        fprintf(fd, " %-30s %8d", app->appname, app->launches);
+        for (j = LAUNCH_PID; j < NUM_LAUNCH_STAMPS; j++)
+        {
+            if (app->num[j])
+                fprintf(fd, " %9.1f", app->sum[j] / app->num[j]);
+            else
+                fprintf(fd, " %9s", "-");
         }
-        fprintf( stderr,  " [FINISH] %s : the path to store the xwd files is %s \n", name, path);
+        fprintf(fd, " %9.1f\n", app->max);
+    }
+    fflush(fd);
+}
+
+    static void
+launch(XinfoPtr pXinfo)
+{
+    Window root_win = RootWindow(dpy, screen);
+    FILE *fd = pXinfo->output_fd;
+    struct timespec start;
+    int event_base, error_base;
+    int status;
+    int i;
+    XEvent e;
+
+    if (!XDamageQueryExtension(dpy, &event_base, &error_base))
+    {
+        fprintf(stderr, "Error : no DAMAGE extension \n");
+        return;
+    }
+
+    signal(SIGINT, launch_signal);
+    signal(SIGTERM, launch_signal);
+
+    /* the windows come and go while they are followed */
+    damage_error_base = error_base;
+    old_x_error = XSetErrorHandler(cb_x_error);
+
+    XSelectInput(dpy, root_win, SubstructureNotifyMask);
+    XSync(dpy, False);
+
+    if (pXinfo->exec)
+    {
+        char *cmd;
+
+        /* exec in the shell so the pid of the windows is the one of the child */
+        cmd = malloc(strlen(pXinfo->exec) + sizeof("exec "));
+        if (!cmd)
+        {
+            fprintf(stderr, " alloc error \n");
+            exit(1);
+        }
+        sprintf(cmd, "exec %s", pXinfo->exec);
+
+        clock_gettime(CLOCK_MONOTONIC, &ln_fork);
+        ln_child = fork();
+        if (ln_child < 0)
+        {
+            fprintf(stderr, "Error : fail to fork \n");
+            free(cmd);
+            return;
+        }
+        if (ln_child == 0)
+        {
+            close(ConnectionNumber(dpy));
+            execl("/bin/sh", "sh", "-c", cmd, (char *)NULL);
+            _exit(127);
+        }
+        free(cmd);
+        fprintf(fd, "[%s] pid %d : %s\n", pXinfo->xinfovalname, (int)ln_child, pXinfo->exec);
+    }
+    else
+        fprintf(fd, "[%s] waiting for new windows\n", pXinfo->xinfovalname);
+    fflush(fd);
+
+    while (!ln_quit)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        while (!ln_quit && _next_event(&e, &start, pXinfo->interval))
+            launch_event(fd, &e, event_base);
+
+        if (ln_child && waitpid(ln_child, &status, WNOHANG) == ln_child)
+        {
+            fprintf(fd, "[%s] pid %d exited with %d before its first frame\n", pXinfo->xinfovalname,
+                    (int)ln_child, WIFEXITED(status) ? WEXITSTATUS(status) : -1);
+            ln_child = 0;
+            break;
+        }
+    }
+
+    launch_summary(fd);
+
+    for (i = 0; i < ln_wins.size; i++)
+        if (ln_wins.keys[i])
+            free(ln_wins.vals[i]);
+    xidmap_free(&ln_wins);
+    xidmap_free(&ln_damages);
+    free(ln_apps);
+}
+
+/*
+ * Input latency : how long a window takes to show the answer to an input.
+ * The pointer is moved to the middle of the window and synthetic events are
+ * injected with XTest, a click, a motion or a key, and the first damage of
+ * the window after the injection is its answer. Before every probe the
+ * damage is emptied and the pending events are dropped, so an earlier repaint
+ * does not count, and a window which does not repaint within the timeout has
+ * lost the probe. A lost probe counts as an endless latency in the median
+ * and the p99, so the run fails when the p99 is over the threshold or more
+ * than 1% of the probes are lost.
+ *
+ * A key goes to the focus, so the window is given the focus once before the
+ * probes and keeps it after the run, the focus before is not restored.
+ */
+#define INPUTLAT_COLUMNS "probe", "latency_us"
+#define INPUTLAT_LOST LONG_MAX /* latency of a lost probe */
+
+static const char *const _inputlat_columns[] = { INPUTLAT_COLUMNS, NULL };
+
+    static const char *
+inputlat_ms(char *str, int len, long usec)
+{
+    if (usec == INPUTLAT_LOST)
+        snprintf(str, len, "lost");
+    else
+        snprintf(str, len, "%.2f ms", usec / 1000.0);
+
+    return str;
+}
+
+    static int
+inputlat_cmp(const void *a, const void *b)
+{
+    long x = *(const long *)a, y = *(const long *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+    static void
+inputlat(XinfoPtr pXinfo)
+{
+    Window root_win = RootWindow(dpy, screen);
+    Window win = pXinfo->win, child;
+    FILE *fd = pXinfo->output_fd;
+    XWindowAttributes attr;
+    struct timespec sent, now;
+    Damage damage;
+    KeyCode keycode = 0;
+    WriterPtr wr = NULL;
+    long *latency;
+    int event_base, error_base, major, minor;
+    int center_x, center_y;
+    int num = 0, lost = 0;
+    int i;
+    XEvent e;
+
+    if (!XTestQueryExtension(dpy, &event_base, &error_base, &major, &minor))
+    {
+        fprintf(stderr, "Error : no XTEST extension \n");
+        pXinfo->status = 1;
+        return;
+    }
+    if (!XDamageQueryExtension(dpy, &event_base, &error_base))
+    {
+        fprintf(stderr, "Error : no DAMAGE extension \n");
+        pXinfo->status = 1;
+        return;
+    }
+
+    if (!XGetWindowAttributes(dpy, win, &attr) ||
+        !XTranslateCoordinates(dpy, win, root_win, attr.width / 2, attr.height / 2, &center_x, &center_y, &child))
+    {
+        fprintf(stderr, "Error : no window 0x%lx \n", win);
+        pXinfo->status = 1;
+        return;
+    }
+
+    if (strcmp(pXinfo->input, "button") && strcmp(pXinfo->input, "motion"))
+    {
+        KeySym keysym = XStringToKeysym(pXinfo->input);
+
+        if (keysym != NoSymbol)
+            keycode = XKeysymToKeycode(dpy, keysym);
+        if (!keycode)
+        {
+            fprintf(stderr, "Error : no key for %s \n", pXinfo->input);
+            pXinfo->status = 1;
+            return;
+        }
+    }
+
+    latency = calloc(pXinfo->count, sizeof(long));
+    if (!latency)
+    {
+        fprintf(stderr, " alloc error \n");
+        exit(1);
+    }
+
+    damage = XDamageCreate(dpy, win, XDamageReportNonEmpty);
+    XTestFakeMotionEvent(dpy, screen, center_x, center_y, 0);
+    /* the focus is not given back, see above */
+    if (keycode)
+        XSetInputFocus(dpy, win, RevertToPointerRoot, CurrentTime);
+    XSync(dpy, False);
+
+    if (pXinfo->format != XINFO_FORMAT_TEXT)
+        wr = writer_open(fd, pXinfo->format, _inputlat_columns);
+    else
+        fprintf(fd, "[%s] 0x%lx %dx%d, %s, %d probes, timeout %ld ms\n", pXinfo->xinfovalname, win, attr.width,
+                attr.height, pXinfo->input, pXinfo->count, pXinfo->timeout);
+
+    for (i = 0; i < pXinfo->count; i++)
+    {
+        long usec = -1;
+
+        /* forget the repaints before the probe */
+        XDamageSubtract(dpy, damage, None, None);
+        XSync(dpy, False);
+        while (XPending(dpy))
+            XNextEvent(dpy, &e);
+
+        if (keycode)
+        {
+            XTestFakeKeyEvent(dpy, keycode, True, 0);
+            XTestFakeKeyEvent(dpy, keycode, False, 0);
+        }
+        else if (!strcmp(pXinfo->input, "button"))
+        {
+            XTestFakeButtonEvent(dpy, Button1, True, 0);
+            XTestFakeButtonEvent(dpy, Button1, False, 0);
+        }
+        else
+            XTestFakeMotionEvent(dpy, screen, center_x + (i & 1 ? 1 : -1), center_y, 0);
+        clock_gettime(CLOCK_MONOTONIC, &sent);
+        XFlush(dpy);
+
+        while (_next_event(&e, &sent, pXinfo->timeout))
+        {
+            if (e.type == event_base + XDamageNotify && ((XDamageNotifyEvent *)&e)->damage == damage)
+            {
+                clock_gettime(CLOCK_MONOTONIC, &now);
+                usec = _elapsed_usec(&sent, &now);
+                break;
+            }
+        }
+
+        if (usec >= 0)
+            num++;
+        else
+            lost++;
+        latency[i] = usec >= 0 ? usec : INPUTLAT_LOST;
+
+        if (wr)
+        {
+            writer_long(wr, i + 1);
+            write_long_or_null(wr, usec);
+            writer_end(wr);
+        }
+        else if (usec >= 0)
+            fprintf(fd, "  probe %3d : %8.2f ms\n", i + 1, usec / 1000.0);
+        else
+            fprintf(fd, "  probe %3d : lost\n", i + 1);
+        fflush(fd);
+
+        /* let the window settle before the next probe */
+        if (i < pXinfo->count - 1)
+        {
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            while (_next_event(&e, &now, pXinfo->interval))
+                ;
+        }
+    }
+
+    XDamageDestroy(dpy, damage);
+    XSync(dpy, False);
+
+    if (num)
+    {
+        int count = pXinfo->count;
+        long median, p99;
+        char min_str[32], median_str[32], p99_str[32], max_str[32];
+
+        /* the lost probes sort last */
+        qsort(latency, count, sizeof(long), inputlat_cmp);
+        median = latency[count / 2];
+        if (count % 2 == 0 && median != INPUTLAT_LOST)
+            median = (latency[count / 2 - 1] + median) / 2;
+        /* nearest rank */
+        p99 = latency[(count * 99 + 99) / 100 - 1];
+
+        inputlat_ms(p99_str, sizeof(p99_str), p99);
+        if (!wr)
+        {
+            fprintf(fd, "\n Probes  : %d sent, %d answered, %d lost\n", count, num, lost);
+            fprintf(fd, " Latency : min %s, median %s, p99 %s, max %s\n",
+                    inputlat_ms(min_str, sizeof(min_str), latency[0]),
+                    inputlat_ms(median_str, sizeof(median_str), median), p99_str,
+                    inputlat_ms(max_str, sizeof(max_str), latency[count - 1]));
+        }
+        if (p99 > pXinfo->threshold * 1000)
+        {
+            fprintf(stderr, "[%s] p99 %s over the threshold %ld ms, %d of %d probes lost\n", pXinfo->xinfovalname,
+                    p99_str, pXinfo->threshold, lost, count);
+            pXinfo->status = 1;
+        }
+    }
+    else
+    {
+        if (!wr)
+            fprintf(fd, "\n Probes  : %d sent, none answered\n", pXinfo->count);
+        pXinfo->status = 1;
+    }
+
+    if (wr)
+        writer_close(wr);
+    free(latency);
+}
+
+    void
+display_topwins(XinfoPtr pXinfo)
+{
+    WininfoTable table;
+
+    int wininfo_val = pXinfo->xinfo_val;
+
+    open_display();
+
+    //    /* set a error handler */
+    //    m_old_error = XSetErrorHandler(cb_x_error);
+
+    if(wininfo_val == XINFO_WATCHDOG)
+    {
+        init_atoms();
+        watchdog(pXinfo);
+        return;
+    }
+
+    if(wininfo_val == XINFO_WATCH)
+    {
+        init_atoms();
+        watch(pXinfo);
+        return;
+    }
+
+    if(wininfo_val == XINFO_TREE)
+    {
+        tree(pXinfo);
+        return;
+    }
+
+    if(wininfo_val == XINFO_OCCLUSION)
+    {
+        init_atoms();
+        occlusion(pXinfo);
+        return;
+    }
+
+    if(wininfo_val == XINFO_OVERDRAW)
+    {
+        init_atoms();
+        overdraw(pXinfo);
+        return;
+    }
+
+    if(wininfo_val == XINFO_XRES)
+    {
+        init_atoms();
+        xres(pXinfo);
+        return;
+    }
+
+    if(wininfo_val == XINFO_LEAKWATCH)
+    {
+        init_atoms();
+        leakwatch(pXinfo);
+        return;
+    }
+
+    if(wininfo_val == XINFO_DAMAGE)
+    {
+        init_atoms();
+        damage(pXinfo);
+        return;
+    }
+
+    if(wininfo_val == XINFO_LAUNCH)
+    {
+        init_atoms();
+        launch(pXinfo);
+        return;
+    }
+
+    if(wininfo_val == XINFO_INPUTLAT)
+    {
+        inputlat(pXinfo);
+        return;
+    }
+
+    /* XINFO_XWD_WIN do not need to gethering window information */
+    if(wininfo_val == XINFO_XWD_WIN)
+    {
+        gen_output(pXinfo, NULL);
+        return;
+    }
+
+    /* get a properties */
+    init_atoms();
+
+    scan_topwins(wininfo_val, pXinfo->timeout, &table);
+    if (table.num == 0)
+        return;
+
+    gen_output(pXinfo, &table);
+
+    wininfo_table_free(&table);
+    procinfo_reset();
+
+}
+
+/*
+ * -diff : compare two snapshots, or a snapshot with a live scan of its mode,
+ * and print the deltas only.  The windows are joined on the frame id through
+ * a hash map, so the diff stays linear in the number of windows.
+ */
+static FILE *df_fd;
+
+    static void
+diff_report(WininfoPtr w, const char *event, const char *fmt, ...)
+{
+    va_list args;
+
+    fprintf(df_fd, "[%-7s] 0x%-8lx 0x%-8lx %-25s : ", event, w->BDid, w->winid,
+            w->appname_brief ? w->appname_brief : "");
+    va_start(args, fmt);
+    vfprintf(df_fd, fmt, args);
+    va_end(args);
+    fprintf(df_fd, "\n");
+}
+
+/* the nearest window above which is in both tables, None for the top one */
+    static void
+diff_above(WininfoTable *table, XidMap *other, Window *above)
+{
+    Window last = None;
+    int i;
+
+    for (i = 0; i < table->num; i++)
+    {
+        if (!xidmap_find(other, table->wins[i].BDid))
+            continue;
+        above[i] = last;
+        last = table->wins[i].BDid;
+    }
+}
+
+    static int
+diff_changes(WininfoPtr old, WininfoPtr w, Window old_above, Window above)
+{
+    int changes = 0;
+
+    if (old->w != w->w || old->h != w->h || old->abs_x != w->abs_x || old->abs_y != w->abs_y)
+    {
+        diff_report(w, "GEOM", "%dx%d+%d+%d -> %dx%d+%d+%d", old->w, old->h, old->abs_x, old->abs_y,
+                    w->w, w->h, w->abs_x, w->abs_y);
+        changes++;
+    }
+    if (old_above != above)
+    {
+        diff_report(w, "STACK", "above 0x%lx -> 0x%lx", old_above, above);
+        changes++;
+    }
+    if (old->winid != w->winid)
+    {
+        diff_report(w, "CLIENT", "0x%lx -> 0x%lx", old->winid, w->winid);
+        changes++;
+    }
+    if (old->pid != w->pid)
+    {
+        diff_report(w, "PID", "%ld -> %ld", old->pid, w->pid);
+        changes++;
+    }
+    if (strcmp(old->type, w->type))
+    {
+        diff_report(w, "TYPE", "%s -> %s", old->type, w->type);
+        changes++;
+    }
+    if (strcmp(old->level, w->level))
+    {
+        diff_report(w, "LEVEL", "%s -> %s", old->level, w->level);
+        changes++;
     }
-    else if(val == XINFO_XWD_WIN)
+    if (old->map_state && w->map_state && strcmp(old->map_state, w->map_state))
     {
-        fprintf( stderr,  " [START] %s : the path to store the xwd files is %s \n", name, path);
-
-        snprintf(argument[2], 15, "0x%-7x", pXinfo->win);
-        snprintf(argument[4], 255, "%s/0x%-7x.xwd", path, pXinfo->win);
-
-        switch(pid = fork())
-        {
-            case 0:
-                if (execv("/usr/bin/xwd", argument) == -1)
-                {
-                    fprintf(stderr, "execv error window xwd\n");
-                    exit(1);
-                }
-                break;
-            default:
-                break;
-        }
-        fprintf( stderr,  " [FINISH] %s : the path to store the xwd files is %s \n", name, path);
+        diff_report(w, "MAP", "%s -> %s", old->map_state, w->map_state);
+        changes++;
+    }
+    if (screen_state_name(old->screen_state) && screen_state_name(w->screen_state) &&
+        old->screen_state != w->screen_state)
+    {
+        diff_report(w, "SCREEN", "%s -> %s", screen_state_name(old->screen_state),
+                    screen_state_name(w->screen_state));
+        changes++;
+    }
+    if (strcmp(old->winname ? old->winname : "", w->winname ? w->winname : ""))
+    {
+        diff_report(w, "NAME", "\"%s\" -> \"%s\"", old->winname ? old->winname : "",
+                    w->winname ? w->winname : "");
+        changes++;
     }
-    fprintf(stderr, "[%s] Finish to logging ", name);
-    if(path && file)
-        fprintf(stderr, "at %s/%s\n", path, file);
-    else
-        fprintf(stderr, "\n");
-    free(name);
-    if (argument[1])
-        free (argument[1]);
-    if(argument[2])
-        free(argument[2]);
-    if(argument[3])
-        free(argument[3]);
-    if(argument[4])
-        free(argument[4]);
-}
 
+    return changes;
+}
 
-static Window get_client_window(Window parent)
+    static void
+diff_tables(WininfoTable *old, WininfoTable *cur)
 {
-    Window win = 0, root, p2;
-    Window *children = NULL;
-    XWindowAttributes attr;
-    unsigned int num;
+    XidMap old_map, cur_map;
+    Window *old_above, *cur_above;
+    char *matched;
+    int added = 0, removed = 0, changed = 0;
     int i;
 
-    if (!XQueryTree(dpy, parent, &root, &p2, &children, &num))
-        Fatal_Error("Can't query top-level window tree.");
+    memset(&old_map, 0, sizeof(XidMap));
+    memset(&cur_map, 0, sizeof(XidMap));
+    for (i = 0; i < old->num; i++)
+        xidmap_put(&old_map, old->wins[i].BDid, (void *)(intptr_t)(i + 1));
+    for (i = 0; i < cur->num; i++)
+        xidmap_put(&cur_map, cur->wins[i].BDid, (void *)(intptr_t)(i + 1));
+
+    old_above = calloc(old->num + 1, sizeof(Window));
+    cur_above = calloc(cur->num + 1, sizeof(Window));
+    matched = calloc(old->num + 1, sizeof(char));
+    if (!old_above || !cur_above || !matched)
+    {
+        fprintf(stderr, " alloc error \n");
+        exit(1);
+    }
+    diff_above(old, &cur_map, old_above);
+    diff_above(cur, &old_map, cur_above);
 
-    for (i = 0; i < (int)num; i++)
+    for (i = 0; i < cur->num; i++)
     {
-        if (!XGetWindowAttributes(dpy, children[i], &attr))
-            continue;
+        WininfoPtr w = &cur->wins[i];
+        int idx = (int)(intptr_t)xidmap_find(&old_map, w->BDid) - 1;
 
-        if ((attr.map_state == IsViewable) &&
-            (attr.override_redirect == False))
-        {
-            win = children[i];
-            free(children);
-            return win;
-        }
-        else
+        if (idx < 0)
         {
-            win = get_client_window(children[i]);
-            if (win)
-            {
-                free(children);
-                return win;
-            }
+            diff_report(w, "ADD", "pid %ld, %dx%d+%d+%d, %s %s \"%s\"", w->pid, w->w, w->h, w->abs_x, w->abs_y,
+                        w->type, w->level, w->winname ? w->winname : "");
+            added++;
+            continue;
         }
+
+        matched[idx] = TRUE;
+        if (diff_changes(&old->wins[idx], w, old_above[idx], cur_above[i]))
+            changed++;
     }
 
-    free(children);
-    return 0;
-}
+    for (i = 0; i < old->num; i++)
+    {
+        WininfoPtr w = &old->wins[i];
 
+        if (matched[i])
+            continue;
+        diff_report(w, "DEL", "pid %ld, %dx%d+%d+%d, %s %s \"%s\"", w->pid, w->w, w->h, w->abs_x, w->abs_y,
+                    w->type, w->level, w->winname ? w->winname : "");
+        removed++;
+    }
 
-static Window get_user_created_window(Window win)
-{
+    fprintf(df_fd, "\n%d added, %d removed, %d changed, %d unchanged\n",
+            added, removed, changed, cur->num - added - changed);
 
-    Atom type_ret = 0;
-    int ret, size_ret = 0;
-    unsigned long num_ret = 0, bytes = 0;
-    unsigned char *prop_ret = NULL;
-    unsigned int xid;
-    Atom prop_user_created_win;
-    Window client;
+    free(old_above);
+    free(cur_above);
+    free(matched);
+    xidmap_free(&old_map);
+    xidmap_free(&cur_map);
+}
+
+    void
+diff_snapshot(XinfoPtr pXinfo, const char *old_path, const char *new_path)
+{
+    const SnapHeader *old_header, *cur_header = NULL;
+    WininfoTable old, cur;
+    size_t old_size, cur_size = 0;
+    char stamp[64];
 
-    prop_user_created_win = XInternAtom(dpy, "_E_USER_CREATED_WINDOW", False);
+    df_fd = pXinfo->output_fd;
 
-    ret = XGetWindowProperty(dpy, win, prop_user_created_win, 0L, 1L,
-            False, XA_WINDOW, &type_ret, &size_ret,
-            &num_ret, &bytes, &prop_ret);
+    old_header = load_snapshot(old_path, &old, &old_size);
+    if (!old_header)
+    {
+        pXinfo->status = 1;
+        return;
+    }
 
-    if( ret != Success )
+    if (new_path)
     {
-        if( prop_ret ) XFree( (void*)prop_ret );
-        goto fallback;
+        cur_header = load_snapshot(new_path, &cur, &cur_size);
+        if (!cur_header)
+        {
+            free(old.wins);
+            free(old.usage);
+            snap_unmap(old_header, old_size);
+            pXinfo->status = 1;
+            return;
+        }
     }
-    else if( !prop_ret )
+    else
     {
-        goto fallback;
+        /* the live side is scanned in the mode of the snapshot */
+        open_display();
+        init_atoms();
+        scan_topwins(old_header->mode, pXinfo->timeout, &cur);
     }
 
-    memcpy( &xid, prop_ret, sizeof(unsigned int) );
-    XFree( (void *)prop_ret );
+    snapshot_time(old_header, stamp, sizeof(stamp));
+    fprintf(df_fd, " \n");
+    fprintf(df_fd, "  Old                    : %s (%s, %s, %d windows)\n", old_path,
+            Lookup(old_header->mode, _snap_modes), stamp, old.num);
+    if (cur_header)
+    {
+        snapshot_time(cur_header, stamp, sizeof(stamp));
+        fprintf(df_fd, "  New                    : %s (%s, %s, %d windows)\n", new_path,
+                Lookup(cur_header->mode, _snap_modes), stamp, cur.num);
+    }
+    else
+        fprintf(df_fd, "  New                    : live (%s, %d windows)\n",
+                Lookup(old_header->mode, _snap_modes), cur.num);
+    fprintf(df_fd, "\n");
 
-    return xid;
+    diff_tables(&old, &cur);
 
-fallback:
-    client = get_client_window(win);
-    if (client) return client;
-    else return win;
+    free(old.wins);
+    free(old.usage);
+    snap_unmap(old_header, old_size);
+    if (cur_header)
+    {
+        free(cur.wins);
+        free(cur.usage);
+        snap_unmap(cur_header, cur_size);
+    }
+    else
+    {
+        wininfo_table_free(&cur);
+        procinfo_reset();
+    }
 }
 
-#if 0
-static int cb_x_error(Display *disp, XErrorEvent *ev)
+/*
+ * -record : scan the top level windows periodically and append every scan
+ * to a record log as the changes against the scan before, see RecHeader.
+ * -replay : rebuild the table of a record at a given time.
+ */
+#define REC_KEY_INTERVAL 60 /* frames between the key frames */
+
+static const Wininfo rec_empty;     /* a new window is encoded against it */
+static volatile sig_atomic_t rc_quit = 0;
+
+    static void
+record_signal(int sig)
 {
-    return 0;
+    rc_quit = 1;
 }
-#endif
 
-    void
-display_topwins(XinfoPtr pXinfo)
+    static int
+rec_str_differ(const char *a, const char *b)
 {
-    int i;
-    int rel_x, rel_y, abs_x, abs_y;
-    unsigned int width, height, border, depth;
-    Window root_win, parent_win;
-    unsigned int num_children;
-    Window *child_list;
-    long *pid = NULL;
-    //    char *command_name = NULL;
-    //    char *class_name = NULL;
-    Atom actual_type;
-    int actual_format;
-    unsigned long nitems, bytes_after;
-    Window window;
+    if (!a || !b)
+        return a != b;
+    return strcmp(a, b) != 0;
+}
 
-    int wininfo_val = pXinfo->xinfo_val;
+    static unsigned int
+rec_row_mask(const Wininfo *old, const Wininfo *w)
+{
+    unsigned int mask = 0;
+
+    if (old->pid != w->pid)
+        mask |= REC_PID;
+    if (old->winid != w->winid)
+        mask |= REC_WINID;
+    if (old->w != w->w)
+        mask |= REC_W;
+    if (old->h != w->h)
+        mask |= REC_H;
+    if (old->rel_x != w->rel_x)
+        mask |= REC_REL_X;
+    if (old->rel_y != w->rel_y)
+        mask |= REC_REL_Y;
+    if (old->abs_x != w->abs_x)
+        mask |= REC_ABS_X;
+    if (old->abs_y != w->abs_y)
+        mask |= REC_ABS_Y;
+    if (old->depth != w->depth)
+        mask |= REC_DEPTH;
+    if (strcmp(old->type, w->type))
+        mask |= REC_TYPE;
+    if (strcmp(old->level, w->level))
+        mask |= REC_LEVEL;
+    if (map_state_code(old->map_state) != map_state_code(w->map_state))
+        mask |= REC_MAP_STATE;
+    if (rec_str_differ(old->winname, w->winname))
+        mask |= REC_WINNAME;
+    if (rec_str_differ(old->appname_brief, w->appname_brief))
+        mask |= REC_APPNAME;
+    if (rec_str_differ(old->appname, w->appname))
+        mask |= REC_COMMAND;
+    if (old->screen_state != w->screen_state || old->vis_x != w->vis_x || old->vis_y != w->vis_y ||
+        old->vis_w != w->vis_w || old->vis_h != w->vis_h)
+        mask |= REC_SCREEN;
+
+    return mask;
+}
 
-    /* open a display and get a default screen */
-    dpy = XOpenDisplay(0);
-    if(!dpy)
+    static void
+rec_put_row(RecBuf *buf, unsigned int mask, const Wininfo *w)
+{
+    rec_put_uint(buf, mask);
+    if (mask & REC_PID)
+        rec_put_int(buf, w->pid);
+    if (mask & REC_WINID)
+        rec_put_uint(buf, w->winid);
+    if (mask & REC_W)
+        rec_put_int(buf, w->w);
+    if (mask & REC_H)
+        rec_put_int(buf, w->h);
+    if (mask & REC_REL_X)
+        rec_put_int(buf, w->rel_x);
+    if (mask & REC_REL_Y)
+        rec_put_int(buf, w->rel_y);
+    if (mask & REC_ABS_X)
+        rec_put_int(buf, w->abs_x);
+    if (mask & REC_ABS_Y)
+        rec_put_int(buf, w->abs_y);
+    if (mask & REC_DEPTH)
+        rec_put_uint(buf, w->depth);
+    if (mask & REC_TYPE)
+        rec_put_str(buf, w->type);
+    if (mask & REC_LEVEL)
+        rec_put_str(buf, w->level);
+    if (mask & REC_MAP_STATE)
+        rec_put_uint(buf, map_state_code(w->map_state));
+    if (mask & REC_WINNAME)
+        rec_put_str(buf, w->winname);
+    if (mask & REC_APPNAME)
+        rec_put_str(buf, w->appname_brief);
+    if (mask & REC_COMMAND)
+        rec_put_str(buf, w->appname);
+    if (mask & REC_SCREEN)
     {
-        printf("Fail to open display\n");
-        exit(0);
+        rec_put_uint(buf, w->screen_state);
+        rec_put_int(buf, w->vis_x);
+        rec_put_int(buf, w->vis_y);
+        rec_put_int(buf, w->vis_w);
+        rec_put_int(buf, w->vis_h);
     }
+}
 
-    /* get a screen*/
-    screen = DefaultScreen(dpy);
-
-    /* get a root window id */
-    window = RootWindow(dpy, screen);
-
-    //    /* set a error handler */
-    //    m_old_error = XSetErrorHandler(cb_x_error);
-
-    if(wininfo_val == XINFO_PING)
-        XSelectInput (dpy, window, ExposureMask|     SubstructureNotifyMask);
-
-    /* XINFO_XWD_WIN do not need to gethering window information */
-    if(wininfo_val == XINFO_XWD_WIN)
+    static void
+rec_get_row(RecCursor *cur, Wininfo *w)
+{
+    unsigned int mask = rec_get_uint(cur);
+    unsigned int code;
+    const char *str;
+
+    if (mask & REC_PID)
+        w->pid = rec_get_int(cur);
+    if (mask & REC_WINID)
+        w->winid = rec_get_uint(cur);
+    if (mask & REC_W)
+        w->w = rec_get_int(cur);
+    if (mask & REC_H)
+        w->h = rec_get_int(cur);
+    if (mask & REC_REL_X)
+        w->rel_x = rec_get_int(cur);
+    if (mask & REC_REL_Y)
+        w->rel_y = rec_get_int(cur);
+    if (mask & REC_ABS_X)
+        w->abs_x = rec_get_int(cur);
+    if (mask & REC_ABS_Y)
+        w->abs_y = rec_get_int(cur);
+    if (mask & REC_DEPTH)
+        w->depth = rec_get_uint(cur);
+    if (mask & REC_TYPE)
     {
-        gen_output(pXinfo, NULL);
-        return;
+        str = rec_get_str(cur);
+        snprintf(w->type, sizeof(w->type), "%s", str ? str : "");
+    }
+    if (mask & REC_LEVEL)
+    {
+        str = rec_get_str(cur);
+        snprintf(w->level, sizeof(w->level), "%s", str ? str : "");
+    }
+    if (mask & REC_MAP_STATE)
+    {
+        code = rec_get_uint(cur);
+        w->map_state = code == IsUnmapped || code == IsUnviewable || code == IsViewable ?
+                       Lookup(code, _map_states) : NULL;
+    }
+    if (mask & REC_WINNAME)
+        w->winname = rec_get_str(cur);
+    if (mask & REC_APPNAME)
+        w->appname_brief = rec_get_str(cur);
+    if (mask & REC_COMMAND)
+        w->appname = rec_get_str(cur);
+    if (mask & REC_SCREEN)
+    {
+        w->screen_state = rec_get_uint(cur);
+        w->vis_x = rec_get_int(cur);
+        w->vis_y = rec_get_int(cur);
+        w->vis_w = rec_get_int(cur);
+        w->vis_h = rec_get_int(cur);
     }
+}
 
-    /* query a window tree */
-    if (!XQueryTree(dpy, window, &root_win, &parent_win, &child_list, &num_children))
-        Fatal_Error("Can't query window tree.");
+/* encode cur against prev, against an empty table for a key frame (prev NULL) */
+    static void
+rec_encode(RecBuf *buf, WininfoTable *prev, WininfoTable *cur)
+{
+    int i, idx, cursor = 0, run = 0;
+    unsigned int mask;
 
-    /* get a properties */
-    prop_pid = XInternAtom(dpy, "_NET_WM_PID", False);
-    prop_c_pid = XInternAtom(dpy, "X_CLIENT_PID", False);
-    prop_class = XInternAtom(dpy, "WM_CLASS", False);
-    prop_command = XInternAtom(dpy, "WM_COMMAND", False);
+    buf->len = 0;
+    rec_put_uint(buf, cur->num);
 
-    init_atoms();
+    for (i = 0; i < cur->num; i++)
+    {
+        WininfoPtr w = &cur->wins[i];
+        WininfoPtr old = prev ? xidmap_find(&prev->map, w->BDid) : NULL;
 
-    /* gathering the wininfo infomation */
-    WininfoPtr prev_wininfo = NULL;
-    WininfoPtr cur_wininfo = NULL;
-    WininfoPtr origin_wininfo = NULL;
-    int map_state;
+        /* the map has the client windows too */
+        if (old && old->BDid != w->BDid)
+            old = NULL;
+        idx = old ? old - prev->wins : -1;
+        mask = rec_row_mask(old ? old : &rec_empty, w);
 
-    /* Make the wininfo list */
-    for (i = (int)num_children - 1; i >= 0; i--)
-    {
-        if(wininfo_val == XINFO_TOPVWINS || wininfo_val == XINFO_XWD_TOPVWINS || wininfo_val == XINFO_TOPVWINS_PROPS)
+        if (old && idx == cursor + run && !mask)
         {
-            /* figure out whether the window is mapped or not */
-            map_state = get_map_status(child_list[i]);
-            if(!map_state)
-                continue;
-            else
-            {
-                cur_wininfo = alloc_wininfo();
-                cur_wininfo->map_state = (char*) calloc(1, 255*sizeof(char));
-                snprintf(cur_wininfo->map_state, 255, "  %s  ",  Lookup(map_state, _map_states));
-
-                /* get the winid */
-                cur_wininfo->winid = child_list[i];
-                cur_wininfo->BDid = child_list[i];
-            }
+            run++;
+            continue;
         }
-        else if(wininfo_val == XINFO_TOPWINS || wininfo_val == XINFO_PING)
-        {
-            cur_wininfo = alloc_wininfo();
 
-            /* get the winid */
-            cur_wininfo->winid = child_list[i];
-            cur_wininfo->BDid = child_list[i];
-        }
-        else
+        if (run)
         {
-            printf("Error . no valid win_state\n");
-            exit(1);
+            rec_put_uint(buf, ((uint64_t)run << 1) | 1);
+            cursor += run;
+            run = 0;
         }
 
-        if(prev_wininfo)
+        if (old)
         {
-            prev_wininfo->next = cur_wininfo;
-            cur_wininfo->prev = prev_wininfo;
+            rec_put_uint(buf, (uint64_t)(idx + 1) << 1);
+            cursor = idx + 1;
         }
         else
-            origin_wininfo = cur_wininfo;
-
-        /* set the pre_wininfo is the cur_wininfo now */
-        prev_wininfo = cur_wininfo;
+        {
+            rec_put_uint(buf, 0);
+            rec_put_uint(buf, w->BDid);
+        }
+        rec_put_row(buf, mask, w);
     }
 
-    if (origin_wininfo == NULL)
-    {
-        if (child_list) free(child_list);
-        return;
-    }
+    if (run)
+        rec_put_uint(buf, ((uint64_t)run << 1) | 1);
+}
 
-    /* check the window generated in client side not is done by window manager */
-    WininfoPtr w = origin_wininfo;
-    Window winid = 0;
-    for(i = 0; i < win_cnt; i++)
-    {
-        winid = get_user_created_window(w->winid);
-        w->winid = winid;
+/* decode a frame against prev into next, the strings stay in the mapping */
+    static int
+rec_decode(const RecFrame *frame, WininfoTable *prev, WininfoTable *next)
+{
+    RecCursor cur;
+    uint64_t count, tag, n;
+    int prev_num = frame->kind == REC_KEY ? 0 : prev->num;
+    int cursor = 0;
 
-        /* move to the next wininfo */
-        w = w->next;
-    }
+    cur.pos = (const unsigned char *)(frame + 1);
+    cur.end = cur.pos + frame->size;
+    cur.error = 0;
+
+    count = rec_get_uint(&cur);
+    if (cur.error || count > (uint64_t)prev_num + frame->size)
+        return -1;
 
+    if ((int)count > next->size)
+    {
+        next->size = count;
+        next->wins = realloc(next->wins, next->size * sizeof(Wininfo));
+        if (!next->wins)
+        {
+            fprintf(stderr, " alloc error \n");
+            exit(1);
+        }
+    }
+    next->num = 0;
 
-    /* check other infomation out  */
-    w = origin_wininfo;
-    for(i = 0; i < win_cnt; i++)
+    while ((uint64_t)next->num < count && !cur.error)
     {
-        /* get pid */
-        if (XGetWindowProperty(dpy, w->winid, prop_pid,
-                    0, 2L,
-                    False, XA_CARDINAL,
-                    &actual_type, &actual_format, &nitems,
-                    &bytes_after, (unsigned char **)&pid) == Success
-                && nitems && pid != NULL)
+        WininfoPtr w = &next->wins[next->num];
+
+        tag = rec_get_uint(&cur);
+        if (tag & 1)
         {
-            w->pid = *pid;
+            n = tag >> 1;
+            if (!n || n > count - next->num || n > (uint64_t)(prev_num - cursor))
+                return -1;
+            memcpy(w, &prev->wins[cursor], n * sizeof(Wininfo));
+            next->num += n;
+            cursor += n;
+            continue;
         }
-        else if (XGetWindowProperty(dpy, w->winid, prop_c_pid,
-                    0, 2L,
-                    False, XA_CARDINAL,
-                    &actual_type, &actual_format, &nitems,
-                    &bytes_after, (unsigned char **)&pid) == Success
-                && nitems && pid != NULL)
+
+        if (!tag)
         {
-            w->pid = *pid;
+            *w = rec_empty;
+            w->BDid = rec_get_uint(&cur);
+            w->ping_rtt = -1;
         }
         else
         {
-            w->pid = 0;
+            if ((tag >> 1) > (uint64_t)prev_num)
+                return -1;
+            cursor = tag >> 1;
+            *w = prev->wins[cursor - 1];
         }
+        rec_get_row(&cur, w);
+        next->num++;
+    }
 
-        Window child;
-        /* get the geometry info and depth*/
-        if (XGetGeometry(dpy, w->winid, &root_win, &rel_x, &rel_y, &width, &height, &border, &depth))
-        {
-            w->w = width;
-            w->h = height;
-            w->rel_x = rel_x;
-            w->rel_y = rel_y;
+    return cur.error || cur.pos != cur.end ? -1 : 0;
+}
 
-            if (XTranslateCoordinates (dpy, w->winid, root_win, 0 ,0, &abs_x, &abs_y, &child))
-            {
-                w->abs_x = abs_x -border;
-                w->abs_y = abs_y - border;
-            }
-        }
+    static int64_t
+rec_now(void)
+{
+    struct timespec ts;
 
-        /* get the depth */
-        w->depth = depth;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
 
-        get_type(w->winid, w->type);
-        get_level(w->winid, w->level);
+    void
+record_topwins(XinfoPtr pXinfo)
+{
+    WininfoTable prev, cur;
+    RecBuf buf;
+    RecFilePtr rf;
+    FILE *index;
+    char index_path[512];
+    struct timespec start, now, wait;
+    long elapsed;
+    int frames = 0, keys = 0;
+    uint32_t kind;
+    size_t bytes = sizeof(RecHeader);
+
+    snprintf(index_path, sizeof(index_path), "%s/%s%s", pXinfo->pathname, pXinfo->filename, REC_INDEX_SUFFIX);
+    index = fopen(index_path, "wb");
+    if (!index)
+    {
+        fprintf(stderr, "Error - can open file %s\n", index_path);
+        return;
+    }
 
-        /* get the winname */
-        w->winname = (char*) calloc(1, 255*sizeof(char));
-        get_winname(w->winid, w->winname);
-#if 0
-        /* get app_name from WM_COMMAND or WM_CLASS */
-        w->appname = (char*) calloc(1, 255*sizeof(char));
-        if (XGetWindowProperty(dpy, w->winid, prop_command,
-                    0, 10000000L,
-                    False, AnyPropertyType,
-                    &actual_type, &actual_format, &nitems,
-                    &bytes_after, (unsigned char **)&command_name) == Success
-                && nitems && command_name != NULL)
-        {
-            strncpy(w->appname, command_name, strlen(command_name)+1);
-        }
-        else
-        {
-            if (XGetWindowProperty(dpy, w->winid, prop_class,
-                        0, 10000000L,
-                        False, AnyPropertyType,
-                        &actual_type, &actual_format, &nitems,
-                        &bytes_after, (unsigned char **)&class_name) == Success
-                    && nitems && class_name != NULL)
-            {
-                strncpy(w->appname, class_name, strlen(class_name)+1);
-            }
-            else
-            {
-                if (w->appname)
-                    free (w->appname);
-                w->appname = NULL;
-            }
-        }
-        if(command_name)
-        {
-            XFree(command_name);
-            command_name = NULL;
-        }
-        if(class_name)
-        {
-            XFree(class_name);
-            class_name = NULL;
-        }
+    open_display();
+    init_atoms();
 
-        if (w->appname) {
-            w->appname_brief = (char*) calloc(1, 255*sizeof(char));
+    signal(SIGINT, record_signal);
+    signal(SIGTERM, record_signal);
 
-            strncpy(w->appname_brief, w->appname, 255*sizeof(char));
+    /* the windows come and go while they are scanned */
+    old_x_error = XSetErrorHandler(cb_x_error);
 
-            get_appname_brief (w->appname_brief);
-        }
-#else
-        /* get app_name from pid */
-        if(w->pid)
-        {
-            w->appname = (char*) calloc(1, 255*sizeof(char));
-            if (w->appname)
-            {
-                get_appname_from_pid(w->pid, w->appname);
-                w->appname_brief = (char*) calloc(1, 255*sizeof(char));
+    rf = rec_open(pXinfo->output_fd, index, XINFO_TOPVWINS, RootWindow(dpy, screen), rec_now(), pXinfo->interval);
+    if (!rf)
+    {
+        fprintf(stderr, "fail to write the record\n");
+        fclose(index);
+        return;
+    }
 
-                strncpy(w->appname_brief, w->appname, 255*sizeof(char));
+    fprintf(stderr, "[%s] every %ld ms at %s/%s\n", pXinfo->xinfovalname, pXinfo->interval,
+            pXinfo->pathname, pXinfo->filename);
 
-                get_appname_brief (w->appname_brief);
-            }
-        }
-        else
-            w->appname = NULL;
-#endif
-        if (pid)
+    memset(&prev, 0, sizeof(WininfoTable));
+    memset(&buf, 0, sizeof(RecBuf));
+
+    while (!rc_quit)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        scan_topwins(XINFO_TOPVWINS, pXinfo->timeout, &cur);
+        procinfo_reset();
+
+        kind = frames % REC_KEY_INTERVAL ? REC_DELTA : REC_KEY;
+        rec_encode(&buf, kind == REC_KEY ? NULL : &prev, &cur);
+        if (rec_append(rf, kind, rec_now(), &buf))
         {
-            XFree(pid);
-            pid = NULL;
+            fprintf(stderr, "fail to write the record\n");
+            wininfo_table_free(&cur);
+            break;
         }
+        frames++;
+        keys += kind == REC_KEY;
+        bytes += sizeof(RecFrame) + ((buf.len + 7) & ~(size_t)7);
+
+        wininfo_table_free(&prev);
+        prev = cur;
 
-        /* ping test info */
-        if(wininfo_val == XINFO_PING)
+        /* keep the cadence, a signal cuts the wait */
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        elapsed = (now.tv_sec - start.tv_sec) * 1000 + (now.tv_nsec - start.tv_nsec) / 1000000;
+        if (!rc_quit && elapsed < pXinfo->interval)
         {
-            struct timespec tim, tim2;
-            tim.tv_sec = 0;
-            tim.tv_nsec = 50000000;
-            Send_Ping_to_Window(w->winid);
-            nanosleep(&tim, &tim2);
-            w->ping_result = (char*) calloc(1, 255*sizeof(char));
-            if(Ping_Event_Loop())
-                snprintf(w->ping_result, sizeof("  Success  "), "  Success  ");
-            else
-                snprintf(w->ping_result, sizeof("  Fail  "), "  Fail  ");
+            wait.tv_sec = (pXinfo->interval - elapsed) / 1000;
+            wait.tv_nsec = ((pXinfo->interval - elapsed) % 1000) * 1000000;
+            nanosleep(&wait, NULL);
         }
-
-        /* move to the next wininfo */
-        w = w->next;
     }
 
+    fprintf(stderr, "[%s] %d frames, %d key frames, %zu bytes\n", pXinfo->xinfovalname, frames, keys, bytes);
 
+    wininfo_table_free(&prev);
+    free(buf.data);
+    rec_close(rf);
+}
 
-    /* ping test */
-    gen_output(pXinfo, origin_wininfo);
+/*
+ * The replay time : +<sec> from the start of the record, HH:MM:SS on the
+ * day the record started or YYYY-MM-DD HH:MM:SS. A time in seconds covers
+ * the frames of the whole second.
+ */
+    static int
+parse_record_time(const RecHeader *header, const char *str, int64_t *time)
+{
+    time_t start = header->start / 1000;
+    struct tm t;
+    double sec;
+    char end;
 
-    if (child_list)
-        XFree((char *)child_list);
+    if (str[0] == '+')
+    {
+        if (sscanf(str + 1, "%lf%c", &sec, &end) != 1 || sec < 0)
+            return -1;
+        *time = header->start + (int64_t)(sec * 1000);
+        return 0;
+    }
+
+    localtime_r(&start, &t);
+    if (sscanf(str, "%d-%d-%d %d:%d:%d%c", &t.tm_year, &t.tm_mon, &t.tm_mday,
+               &t.tm_hour, &t.tm_min, &t.tm_sec, &end) == 6)
+    {
+        t.tm_year -= 1900;
+        t.tm_mon -= 1;
+    }
+    else if (sscanf(str, "%d:%d:%d%c", &t.tm_hour, &t.tm_min, &t.tm_sec, &end) != 3)
+        return -1;
+    t.tm_isdst = -1;
 
-    free_wininfo(origin_wininfo);
+    *time = (int64_t)mktime(&t) * 1000 + 999;
+    return 0;
+}
+
+    static void
+record_time(int64_t msec, char *stamp, size_t size)
+{
+    time_t sec = msec / 1000;
+    struct tm t;
+    size_t len;
 
+    localtime_r(&sec, &t);
+    len = strftime(stamp, size, "%Y-%m-%d %H:%M:%S", &t);
+    snprintf(stamp + len, size - len, ".%03d", (int)(msec % 1000));
 }
 
+    void
+replay_record(XinfoPtr pXinfo, const char *path)
+{
+    const RecHeader *header;
+    const RecFrame *frame, *last = NULL, *shown = NULL;
+    WininfoTable prev, next, tmp;
+    Xinfo info;
+    FILE *fd = pXinfo->output_fd;
+    char stamp[64];
+    int64_t at = INT64_MAX;
+    int frames = 0, keys = 0, decoded = 0;
+    size_t size;
+
+    header = rec_map(path, &size);
+    if (!header)
+    {
+        pXinfo->status = 1;
+        return;
+    }
+
+    if (pXinfo->at && parse_record_time(header, pXinfo->at, &at))
+    {
+        fprintf(stderr, "Error : invalid time %s\n", pXinfo->at);
+        rec_unmap(header, size);
+        pXinfo->status = 1;
+        return;
+    }
+
+    /* only the frame headers are read to sum the record up */
+    for (frame = rec_first(header, size); frame; frame = rec_next(header, size, frame))
+    {
+        frames++;
+        keys += frame->kind == REC_KEY;
+        last = frame;
+    }
+
+    memset(&prev, 0, sizeof(WininfoTable));
+    memset(&next, 0, sizeof(WininfoTable));
+    for (frame = rec_seek(header, size, path, at); frame && frame->time <= at; frame = rec_next(header, size, frame))
+    {
+        if (rec_decode(frame, &prev, &next))
+        {
+            fprintf(stderr, "%s : broken frame at offset %ld\n", path, (long)((const char *)frame - (const char *)header));
+            pXinfo->status = 1;
+            break;
+        }
+        tmp = prev;
+        prev = next;
+        next = tmp;
+        shown = frame;
+        decoded++;
+    }
+
+    record_time(header->start, stamp, sizeof(stamp));
+    fprintf(fd, " \n");
+    fprintf(fd, "  Record file            : %s\n", path);
+    fprintf(fd, "  Record start           : %s\n", stamp);
+    if (last)
+    {
+        record_time(last->time, stamp, sizeof(stamp));
+        fprintf(fd, "  Record end             : %s\n", stamp);
+    }
+    fprintf(fd, "  Frames                 : %d (%d key frames, every %ld ms)\n", frames, keys, (long)header->interval);
+    fprintf(fd, "  Root window id         : 0x%x\n", header->root);
+
+    if (!shown)
+    {
+        fprintf(fd, "\nNo frame at this time\n");
+        goto out;
+    }
 
+    record_time(shown->time, stamp, sizeof(stamp));
+    fprintf(fd, "  Frame time             : %s (%d frames decoded)\n", stamp, decoded);
+    fprintf(fd, "\n");
+    fprintf(fd, "%d Top level windows\n", prev.num);
 
+    memset(&info, 0, sizeof(Xinfo));
+    info.xinfo_val = header->mode;
+    info.xinfovalname = (char *)Lookup(header->mode, _snap_modes);
+    print_wininfo_table(fd, &info, &prev);
 
+out:
+    free(prev.wins);
+    free(next.wins);
+    rec_unmap(header, size);
+}
@@ -0,0 +1,290 @@
+/**************************************************************************
+
+xinfo
+
+Copyright 2014-2018 Samsung Electronics co., Ltd. All Rights Reserved.
+
+Contact: SooChan Lim <sc1.lim@samsung.com>
+Contact: Gwan-gyeong Mun <kk.moon@samsung.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sub license, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice (including the
+next paragraph) shall be included in all copies or substantial portions
+of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+**************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <xinfo.h>
+
+/*
+ * Buffered record writer of the machine readable formats : JSON Lines, CSV
+ * (RFC 4180) and TSV. The fields of a record are escaped straight into one
+ * fixed buffer which is written out when it is full, nothing is allocated per
+ * field or per record. The field names come from the column list in order.
+ */
+
+#define WRITER_BUF_SIZE 65536
+
+struct _Writer {
+    FILE *fd;
+    int format;
+    const char *const *columns;
+    int field;          /* index of the next field of the record */
+    size_t pos;
+    char buf[WRITER_BUF_SIZE];
+};
+
+    static void
+_flush(WriterPtr w)
+{
+    if (w->pos)
+        fwrite(w->buf, 1, w->pos, w->fd);
+    w->pos = 0;
+}
+
+    static void
+_putc(WriterPtr w, char c)
+{
+    if (w->pos == WRITER_BUF_SIZE)
+        _flush(w);
+    w->buf[w->pos++] = c;
+}
+
+    static void
+_puts(WriterPtr w, const char *str, size_t len)
+{
+    if (WRITER_BUF_SIZE - w->pos < len)
+    {
+        _flush(w);
+        if (len > WRITER_BUF_SIZE)
+        {
+            fwrite(str, 1, len, w->fd);
+            return;
+        }
+    }
+    memcpy(w->buf + w->pos, str, len);
+    w->pos += len;
+}
+
+    static void
+_json_string(WriterPtr w, const char *str, size_t len)
+{
+    static const char hex[] = "0123456789abcdef";
+    size_t i;
+
+    _putc(w, '"');
+    for (i = 0; i < len; i++)
+    {
+        unsigned char c = str[i];
+
+        switch (c)
+        {
+            case '"': _puts(w, "\\\"", 2); break;
+            case '\\': _puts(w, "\\\\", 2); break;
+            case '\n': _puts(w, "\\n", 2); break;
+            case '\r': _puts(w, "\\r", 2); break;
+            case '\t': _puts(w, "\\t", 2); break;
+            default:
+                if (c < 0x20)
+                {
+                    _puts(w, "\\u00", 4);
+                    _putc(w, hex[c >> 4]);
+                    _putc(w, hex[c & 0xf]);
+                }
+                else
+                    _putc(w, c);
+                break;
+        }
+    }
+    _putc(w, '"');
+}
+
+    static void
+_csv_string(WriterPtr w, const char *str, size_t len)
+{
+    size_t i;
+
+    /* quote only the fields which need it */
+    if (!memchr(str, ',', len) && !memchr(str, '"', len) &&
+        !memchr(str, '\n', len) && !memchr(str, '\r', len))
+    {
+        _puts(w, str, len);
+        return;
+    }
+
+    _putc(w, '"');
+    for (i = 0; i < len; i++)
+    {
+        if (str[i] == '"')
+            _putc(w, '"');
+        _putc(w, str[i]);
+    }
+    _putc(w, '"');
+}
+
+    static void
+_tsv_string(WriterPtr w, const char *str, size_t len)
+{
+    size_t i;
+
+    for (i = 0; i < len; i++)
+    {
+        switch (str[i])
+        {
+            case '\t': _puts(w, "\\t", 2); break;
+            case '\n': _puts(w, "\\n", 2); break;
+            case '\r': _puts(w, "\\r", 2); break;
+            case '\\': _puts(w, "\\\\", 2); break;
+            default: _putc(w, str[i]); break;
+        }
+    }
+}
+
+/* the separator and the name of the next field */
+    static void
+_field(WriterPtr w)
+{
+    const char *name = w->columns[w->field];
+
+    if (w->format == XINFO_FORMAT_JSONL)
+    {
+        _putc(w, w->field ? ',' : '{');
+        _json_string(w, name ? name : "", name ? strlen(name) : 0);
+        _putc(w, ':');
+    }
+    else if (w->field)
+        _putc(w, w->format == XINFO_FORMAT_CSV ? ',' : '\t');
+
+    if (name)
+        w->field++;
+}
+
+/*
+ * Open a writer of the format on fd. The columns are NULL terminated, the CSV
+ * and TSV formats start with a header line of them.
+ */
+    WriterPtr
+writer_open(FILE *fd, int format, const char *const *columns)
+{
+    WriterPtr w;
+    int i;
+
+    w = calloc(1, sizeof(Writer));
+    if (!w)
+    {
+        fprintf(stderr, " alloc error \n");
+        exit(1);
+    }
+    w->fd = fd;
+    w->format = format;
+    w->columns = columns;
+
+    if (format == XINFO_FORMAT_CSV || format == XINFO_FORMAT_TSV)
+    {
+        for (i = 0; columns[i]; i++)
+        {
+            if (i)
+                _putc(w, format == XINFO_FORMAT_CSV ? ',' : '\t');
+            _puts(w, columns[i], strlen(columns[i]));
+        }
+        _putc(w, '\n');
+    }
+
+    return w;
+}
+
+    void
+writer_strn(WriterPtr w, const char *str, size_t len)
+{
+    _field(w);
+
+    if (!str)
+    {
+        if (w->format == XINFO_FORMAT_JSONL)
+            _puts(w, "null", 4);
+        return;
+    }
+
+    len = strnlen(str, len);
+    if (w->format == XINFO_FORMAT_JSONL)
+        _json_string(w, str, len);
+    else if (w->format == XINFO_FORMAT_CSV)
+        _csv_string(w, str, len);
+    else
+        _tsv_string(w, str, len);
+}
+
+    void
+writer_str(WriterPtr w, const char *str)
+{
+    writer_strn(w, str, (size_t)-1);
+}
+
+    void
+writer_long(WriterPtr w, long val)
+{
+    char num[24];
+
+    _field(w);
+    _puts(w, num, snprintf(num, sizeof(num), "%ld", val));
+}
+
+/* a window id, "0x..." as in the text output */
+    void
+writer_xid(WriterPtr w, unsigned long xid)
+{
+    char num[24];
+
+    writer_strn(w, num, snprintf(num, sizeof(num), "0x%lx", xid));
+}
+
+    void
+writer_double(WriterPtr w, double val)
+{
+    char num[32];
+
+    _field(w);
+    _puts(w, num, snprintf(num, sizeof(num), "%.2f", val));
+}
+
+/* null in JSON, an empty field in CSV and TSV */
+    void
+writer_null(WriterPtr w)
+{
+    writer_strn(w, NULL, 0);
+}
+
+    void
+writer_end(WriterPtr w)
+{
+    if (w->format == XINFO_FORMAT_JSONL)
+        _putc(w, '}');
+    _putc(w, '\n');
+    w->field = 0;
+}
+
+    void
+writer_close(WriterPtr w)
+{
+    _flush(w);
+    fflush(w->fd);
+    free(w);
+}
@@ -36,8 +36,23 @@ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include <xinfo.h>
 #include <time.h>
 #include <string.h>
+#include <sys/wait.h>
+
+#define DEFAULT_PING_TIMEOUT 1000 /* msec */
+#define DEFAULT_WATCHDOG_INTERVAL 1000 /* msec */
+#define DEFAULT_WATCHDOG_THRESHOLD 3000 /* msec */
+#define DEFAULT_LEAKWATCH_THRESHOLD 1024 /* KB/h */
+#define DEFAULT_INPUTLAT_PROBES 20
+#define DEFAULT_INPUTLAT_THRESHOLD 50 /* msec, p99 */
 
 void display_topwins(XinfoPtr pXinfo);
+void dump_snapshot(XinfoPtr pXinfo, const char *path);
+void diff_snapshot(XinfoPtr pXinfo, const char *old_path, const char *new_path);
+void record_topwins(XinfoPtr pXinfo);
+void replay_record(XinfoPtr pXinfo, const char *path);
+
+/* the names of XINFO_FORMAT, also the extension of the output file */
+static const char *formats[] = { "text", "jsonl", "csv", "tsv", "bin" };
 
 static long parse_long (char *s)
 {
@@ -60,7 +75,7 @@ static void free_xinfo(XinfoPtr pXinfo)
 	if(pXinfo)
 	{
 		fd = pXinfo->output_fd;
-		if(fd != stderr)
+		if(fd != stderr && fd != stdout)
 			fclose(fd);
 		free(pXinfo);
 	}
@@ -132,6 +147,9 @@ make_directory(XinfoPtr pXinfo, char *args)
 			}
 			break;
 		default:
+			/* the dump files are written into the directory right after */
+			if (pid > 0)
+				waitpid(pid, NULL, 0);
 			break;
 	}
 	free (argument [0]);
@@ -196,6 +214,60 @@ init_xinfo(XinfoPtr pXinfo, int xinfo_val, char* args)
 		case XINFO_TOPVWINS_PROPS:
 				snprintf(pXinfo->xinfovalname, 255, "%s", "topvwins_props");
 				break;
+		case XINFO_WATCHDOG:
+				snprintf(pXinfo->xinfovalname, 255, "%s", "watchdog");
+				break;
+		case XINFO_WATCH:
+				snprintf(pXinfo->xinfovalname, 255, "%s", "watch");
+				break;
+		case XINFO_TREE:
+				snprintf(pXinfo->xinfovalname, 255, "%s", "tree");
+				break;
+		case XINFO_OCCLUSION:
+				snprintf(pXinfo->xinfovalname, 255, "%s", "occlusion");
+				break;
+		case XINFO_OVERDRAW:
+				snprintf(pXinfo->xinfovalname, 255, "%s", "overdraw");
+				break;
+		case XINFO_XRES:
+				snprintf(pXinfo->xinfovalname, 255, "%s", "xres");
+				break;
+		case XINFO_LEAKWATCH:
+				snprintf(pXinfo->xinfovalname, 255, "%s", "leakwatch");
+				break;
+		case XINFO_DAMAGE:
+				snprintf(pXinfo->xinfovalname, 255, "%s", "damage");
+				break;
+		case XINFO_LAUNCH:
+				snprintf(pXinfo->xinfovalname, 255, "%s", "launch");
+				break;
+		case XINFO_DUMP:
+				snprintf(pXinfo->xinfovalname, 255, "%s", "dump");
+				/* args is the snapshot file to read */
+				pXinfo->output_fd = stdout;
+				goto out;
+		case XINFO_DIFF:
+				snprintf(pXinfo->xinfovalname, 255, "%s", "diff");
+				/* args is the old snapshot, the new one is the next argument */
+				pXinfo->output_fd = stdout;
+				goto out;
+		case XINFO_RECORD:
+				snprintf(pXinfo->xinfovalname, 255, "%s", "record");
+				/* the record and its index are always files */
+				if (!args)
+					args = ".";
+				break;
+		case XINFO_REPLAY:
+				snprintf(pXinfo->xinfovalname, 255, "%s", "replay");
+				/* args is the record file to read */
+				pXinfo->output_fd = stdout;
+				goto out;
+		case XINFO_INPUTLAT:
+				snprintf(pXinfo->xinfovalname, 255, "%s", "inputlat");
+				/* args is the window to probe */
+				pXinfo->output_fd = stdout;
+				pXinfo->win = parse_long(args);
+				goto out;
 		default:
 				break;
 	}
@@ -213,7 +285,8 @@ init_xinfo(XinfoPtr pXinfo, int xinfo_val, char* args)
 	/* set the path and output_fd */
 	if(!args)
 	{
-		pXinfo->output_fd = stderr;
+		/* the binary snapshot is not for the terminal */
+		pXinfo->output_fd = pXinfo->format == XINFO_FORMAT_BIN ? stdout : stderr;
 		pXinfo->filename = NULL;
 		pXinfo->pathname = NULL;
 		goto out;
@@ -232,9 +305,12 @@ init_xinfo(XinfoPtr pXinfo, int xinfo_val, char* args)
 		}
 
 		snprintf(pXinfo->pathname, 255, "%s", args);
-		snprintf(pXinfo->filename, 255, "%s_%02d%02d-%02d%02d%02d.log", pXinfo->xinfovalname, t->tm_mon+1, t->tm_mday, t->tm_hour, t->tm_min, t->tm_sec);
+		snprintf(pXinfo->filename, 255, "%s_%02d%02d-%02d%02d%02d.%s", pXinfo->xinfovalname, t->tm_mon+1, t->tm_mday, t->tm_hour, t->tm_min, t->tm_sec,
+				pXinfo->xinfo_val == XINFO_RECORD ? "rec" :
+				pXinfo->format == XINFO_FORMAT_TEXT ? "log" : formats[pXinfo->format]);
 		snprintf(full_pathfile, 255, "%s/%s", pXinfo->pathname, pXinfo->filename);
-		pXinfo->output_fd = fopen(full_pathfile, "a+");
+		pXinfo->output_fd = fopen(full_pathfile,
+				pXinfo->format == XINFO_FORMAT_BIN || pXinfo->xinfo_val == XINFO_RECORD ? "wb" : "a+");
 		if(pXinfo->output_fd == NULL)
 		{
 			fprintf(stderr, "Error - can open file \n");
@@ -257,10 +333,39 @@ usage()
 	fprintf(stderr,"where options include: \n");
 	fprintf(stderr,"    -topwins [output_path]      : print all top level windows. (default output_path : stdout) \n");
 	fprintf(stderr,"    -topvwins [output_path]     : print all top level visible windows (default output_path : stdout) \n");
-	fprintf(stderr,"    -ping or -p [output_path]   : ping test for all top level windows (default output_path : stdout) \n");
+	fprintf(stderr,"    -ping or -p [output_path]   : ping test for all top level windows, reports the round trip time (default output_path : stdout) \n");
 	fprintf(stderr,"    -xwd_topvwins [output_path] : dump topvwins (default output_path : current working directory) \n");
 	fprintf(stderr,"    -xwd_win [window id] : dump window id (a xwd file stores in current working directory) \n");
 	fprintf(stderr,"    -topvwins_props : print all top level visible windows's property \n");
+	fprintf(stderr,"    -tree [output_path]         : print the whole window tree with the geometry and the map state (default output_path : stdout) \n");
+	fprintf(stderr,"    -occlusion [output_path]    : print the visible part of the top level visible windows under the windows above (default output_path : stdout) \n");
+	fprintf(stderr,"    -overdraw [output_path]     : print how many top level visible windows cover the pixels of the screen (default output_path : stdout) \n");
+	fprintf(stderr,"    -xres [output_path]         : print the X server resources and pixmap bytes of every application (default output_path : stdout) \n");
+	fprintf(stderr,"    -leakwatch [output_path]    : sample the X server resources of the clients every interval and report the steady growths (default output_path : stdout) \n");
+	fprintf(stderr,"    -damage [output_path]       : count the repaints of the top level visible windows over the interval (default output_path : stdout) \n");
+	fprintf(stderr,"    -launch [output_path]       : time the new top level windows from the create to the first frame (default output_path : stdout) \n");
+	fprintf(stderr,"    -inputlat [window id]       : inject input with XTest and time the first repaint of the window, fails if the p99 is over the threshold \n");
+	fprintf(stderr,"    -watchdog [output_path]     : ping top level windows periodically and report hang/recover (default output_path : stdout) \n");
+	fprintf(stderr,"    -dump [snapshot_file]       : print a snapshot of --format=bin as the text table to stdout \n");
+	fprintf(stderr,"    -diff [old_file] [new_file] : print the changes between two snapshots of --format=bin (default new_file : the live windows) \n");
+	fprintf(stderr,"    -record [output_path]       : append a scan of the top level visible windows every interval to a record (default output_path : current working directory) \n");
+	fprintf(stderr,"    -replay [record_file]       : print the top level windows of a record at a time (default : the last frame) \n");
+	fprintf(stderr,"    -watch [output_path]        : keep a live model of the top level windows and report the changes (default output_path : stdout) \n");
+	fprintf(stderr,"\n");
+	fprintf(stderr,"    --timeout=<msec>            : deadline of the ping test and of an inputlat probe (default %d msec) \n", DEFAULT_PING_TIMEOUT);
+	fprintf(stderr,"    --interval=<msec>           : ping cadence of the watchdog, scan period of the record and the leakwatch, sampling time of the damage, pause between the inputlat probes (default %d msec) \n", DEFAULT_WATCHDOG_INTERVAL);
+	fprintf(stderr,"    --threshold=<msec>          : no reply time to report a hang (default %d msec), p99 of the inputlat (default %d msec) \n", DEFAULT_WATCHDOG_THRESHOLD, DEFAULT_INPUTLAT_THRESHOLD);
+	fprintf(stderr,"    --leak=<KB/h>               : pixmap growth of a leaking client, or 100 resources/h (default %d KB/h) \n", DEFAULT_LEAKWATCH_THRESHOLD);
+	fprintf(stderr,"    --snapshot=<msec>           : snapshot period of the watch, 0 : on SIGUSR1 only (default 0) \n");
+	fprintf(stderr,"    --format=<text|jsonl|csv|tsv> : output format of topwins, topvwins, ping, topvwins_props, occlusion, overdraw, xres, damage and inputlat (default text) \n");
+	fprintf(stderr,"    --format=bin                : binary columnar snapshot of topwins, topvwins and ping (default output : stdout) \n");
+	fprintf(stderr,"    --at=<+sec|HH:MM:SS|YYYY-MM-DD HH:MM:SS> : time of the replay, +sec from the start of the record \n");
+	fprintf(stderr,"    --heatmap=<file.pgm>        : overdraw also saves the number of layers of every pixel as a PGM image \n");
+	fprintf(stderr,"    --exec=<command>            : launch starts the command and times it from the fork to its first frame \n");
+	fprintf(stderr,"    --count=<n>                 : inputlat probes (default %d) \n", DEFAULT_INPUTLAT_PROBES);
+	fprintf(stderr,"    --input=<button|motion|keysym> : inputlat event, a click, a pointer motion or a key like space (default button), a key moves the focus to the window for good \n");
+	fprintf(stderr,"    --compress=<gzip|none>      : compression of the xwd files (default gzip) \n");
+	fprintf(stderr,"    --proc                      : add RSS, PSS, CPU time, threads and FDs of the owner process (topwins, topvwins) \n");
 	fprintf(stderr,"\n\n");
 	exit(1);
 }
@@ -268,6 +373,23 @@ usage()
 int main(int argc, char **argv)
 {
 	XinfoPtr pXinfo;
+	char *args = NULL;
+	char *args2 = NULL;
+	long timeout = DEFAULT_PING_TIMEOUT;
+	long interval = DEFAULT_WATCHDOG_INTERVAL;
+	long threshold = -1;
+	int compress = TRUE;
+	int proc = FALSE;
+	long snapshot = 0;
+	int format = XINFO_FORMAT_TEXT;
+	char *at = NULL;
+	char *heatmap = NULL;
+	long leak = DEFAULT_LEAKWATCH_THRESHOLD;
+	char *exec = NULL;
+	int count = DEFAULT_INPUTLAT_PROBES;
+	char *input = "button";
+	int status = 0;
+	int i;
 
 	int xinfo_value = -1;
 	if(argv[1])
@@ -293,38 +415,234 @@ int main(int argc, char **argv)
 		else if(!strcmp(argv[1], "-xwd_win"))
 		{
 			xinfo_value = XINFO_XWD_WIN;
-			if(!argv[2])
-			{
-				fprintf(stderr, "Error : no window id \n");
-				usage();
-				exit(1);
-			}
 		}
 		else if(!strcmp(argv[1], "-topvwins_props"))
 		{
 			xinfo_value = XINFO_TOPVWINS_PROPS;
 		}
+		else if(!strcmp(argv[1], "-watchdog"))
+		{
+			xinfo_value = XINFO_WATCHDOG;
+		}
+		else if(!strcmp(argv[1], "-watch"))
+		{
+			xinfo_value = XINFO_WATCH;
+		}
+		else if(!strcmp(argv[1], "-tree"))
+		{
+			xinfo_value = XINFO_TREE;
+		}
+		else if(!strcmp(argv[1], "-occlusion"))
+		{
+			xinfo_value = XINFO_OCCLUSION;
+		}
+		else if(!strcmp(argv[1], "-overdraw"))
+		{
+			xinfo_value = XINFO_OVERDRAW;
+		}
+		else if(!strcmp(argv[1], "-xres"))
+		{
+			xinfo_value = XINFO_XRES;
+		}
+		else if(!strcmp(argv[1], "-leakwatch"))
+		{
+			xinfo_value = XINFO_LEAKWATCH;
+		}
+		else if(!strcmp(argv[1], "-damage"))
+		{
+			xinfo_value = XINFO_DAMAGE;
+		}
+		else if(!strcmp(argv[1], "-launch"))
+		{
+			xinfo_value = XINFO_LAUNCH;
+		}
+		else if(!strcmp(argv[1], "-inputlat"))
+		{
+			xinfo_value = XINFO_INPUTLAT;
+		}
+		else if(!strcmp(argv[1], "-dump"))
+		{
+			xinfo_value = XINFO_DUMP;
+		}
+		else if(!strcmp(argv[1], "-diff"))
+		{
+			xinfo_value = XINFO_DIFF;
+		}
+		else if(!strcmp(argv[1], "-record"))
+		{
+			xinfo_value = XINFO_RECORD;
+		}
+		else if(!strcmp(argv[1], "-replay"))
+		{
+			xinfo_value = XINFO_REPLAY;
+		}
 
 		else
 			usage();
 
-	  	pXinfo = (XinfoPtr) malloc(sizeof(Xinfo));
+		for(i = 2; i < argc; i++)
+		{
+			if(!strncmp(argv[i], "--timeout=", strlen("--timeout=")))
+			{
+				timeout = parse_long(argv[i] + strlen("--timeout="));
+				if(timeout <= 0)
+				{
+					fprintf(stderr, "Error : invalid timeout \n");
+					usage();
+				}
+			}
+			else if(!strncmp(argv[i], "--interval=", strlen("--interval=")))
+			{
+				interval = parse_long(argv[i] + strlen("--interval="));
+				if(interval <= 0)
+				{
+					fprintf(stderr, "Error : invalid interval \n");
+					usage();
+				}
+			}
+			else if(!strncmp(argv[i], "--threshold=", strlen("--threshold=")))
+			{
+				threshold = parse_long(argv[i] + strlen("--threshold="));
+				if(threshold <= 0)
+				{
+					fprintf(stderr, "Error : invalid threshold \n");
+					usage();
+				}
+			}
+			else if(!strncmp(argv[i], "--leak=", strlen("--leak=")))
+			{
+				leak = parse_long(argv[i] + strlen("--leak="));
+				if(leak <= 0)
+				{
+					fprintf(stderr, "Error : invalid leak threshold \n");
+					usage();
+				}
+			}
+			else if(!strncmp(argv[i], "--snapshot=", strlen("--snapshot=")))
+			{
+				snapshot = parse_long(argv[i] + strlen("--snapshot="));
+				if(snapshot < 0)
+				{
+					fprintf(stderr, "Error : invalid snapshot period \n");
+					usage();
+				}
+			}
+			else if(!strncmp(argv[i], "--format=", strlen("--format=")))
+			{
+				for(format = 0; format < (int)(sizeof(formats) / sizeof(formats[0])); format++)
+					if(!strcmp(argv[i] + strlen("--format="), formats[format]))
+						break;
+				if(format == (int)(sizeof(formats) / sizeof(formats[0])))
+				{
+					fprintf(stderr, "Error : invalid format \n");
+					usage();
+				}
+			}
+			else if(!strncmp(argv[i], "--at=", strlen("--at=")))
+				at = argv[i] + strlen("--at=");
+			else if(!strncmp(argv[i], "--heatmap=", strlen("--heatmap=")))
+				heatmap = argv[i] + strlen("--heatmap=");
+			else if(!strncmp(argv[i], "--exec=", strlen("--exec=")))
+				exec = argv[i] + strlen("--exec=");
+			else if(!strncmp(argv[i], "--count=", strlen("--count=")))
+			{
+				count = parse_long(argv[i] + strlen("--count="));
+				if(count <= 0)
+				{
+					fprintf(stderr, "Error : invalid count \n");
+					usage();
+				}
+			}
+			else if(!strncmp(argv[i], "--input=", strlen("--input=")))
+				input = argv[i] + strlen("--input=");
+			else if(!strcmp(argv[i], "--compress=gzip"))
+				compress = TRUE;
+			else if(!strcmp(argv[i], "--compress=none"))
+				compress = FALSE;
+			else if(!strcmp(argv[i], "--proc"))
+				proc = TRUE;
+			else if(!args)
+				args = argv[i];
+			else if(xinfo_value == XINFO_DIFF && !args2)
+				args2 = argv[i];
+			else
+				usage();
+		}
+
+		if((xinfo_value == XINFO_XWD_WIN || xinfo_value == XINFO_INPUTLAT) && !args)
+		{
+			fprintf(stderr, "Error : no window id \n");
+			usage();
+		}
+
+		if((xinfo_value == XINFO_DUMP || xinfo_value == XINFO_DIFF) && !args)
+		{
+			fprintf(stderr, "Error : no snapshot file \n");
+			usage();
+		}
+
+		if(xinfo_value == XINFO_REPLAY && !args)
+		{
+			fprintf(stderr, "Error : no record file \n");
+			usage();
+		}
+
+		if(format == XINFO_FORMAT_BIN && xinfo_value != XINFO_TOPWINS &&
+			xinfo_value != XINFO_TOPVWINS && xinfo_value != XINFO_PING)
+		{
+			fprintf(stderr, "Error : --format=bin is for topwins, topvwins and ping \n");
+			usage();
+		}
+
+	  	pXinfo = (XinfoPtr) calloc(1, sizeof(Xinfo));
 		if(!pXinfo)
 		{
 			fprintf(stderr, " alloc error \n");
 			exit(1);
 		}
-
-		if(argv[2])
-			init_xinfo(pXinfo, xinfo_value, argv[2]);
-		else
-			init_xinfo(pXinfo, xinfo_value, NULL);
+		pXinfo->timeout = timeout;
+		pXinfo->interval = interval;
+		if(threshold < 0)
+			threshold = xinfo_value == XINFO_INPUTLAT ? DEFAULT_INPUTLAT_THRESHOLD : DEFAULT_WATCHDOG_THRESHOLD;
+		pXinfo->threshold = threshold;
+		pXinfo->leak = leak;
+		pXinfo->exec = exec;
+		pXinfo->count = count;
+		pXinfo->input = input;
+		pXinfo->compress = compress;
+		pXinfo->proc = proc;
+		pXinfo->snapshot = snapshot;
+		pXinfo->format = format;
+		pXinfo->at = at;
+		pXinfo->heatmap = heatmap;
+
+		init_xinfo(pXinfo, xinfo_value, args);
 
 		if(xinfo_value == XINFO_TOPWINS || xinfo_value == XINFO_TOPVWINS || xinfo_value == XINFO_PING ||
-			xinfo_value == XINFO_XWD_TOPVWINS || xinfo_value == XINFO_XWD_WIN || xinfo_value == XINFO_TOPVWINS_PROPS)
+			xinfo_value == XINFO_XWD_TOPVWINS || xinfo_value == XINFO_XWD_WIN || xinfo_value == XINFO_TOPVWINS_PROPS ||
+			xinfo_value == XINFO_WATCHDOG || xinfo_value == XINFO_WATCH || xinfo_value == XINFO_TREE ||
+			xinfo_value == XINFO_OCCLUSION || xinfo_value == XINFO_OVERDRAW || xinfo_value == XINFO_XRES ||
+			xinfo_value == XINFO_LEAKWATCH || xinfo_value == XINFO_DAMAGE || xinfo_value == XINFO_LAUNCH ||
+			xinfo_value == XINFO_INPUTLAT)
 		{
 			display_topwins(pXinfo);
 		}
+		else if(xinfo_value == XINFO_DUMP)
+		{
+			dump_snapshot(pXinfo, args);
+		}
+		else if(xinfo_value == XINFO_DIFF)
+		{
+			diff_snapshot(pXinfo, args, args2);
+		}
+		else if(xinfo_value == XINFO_RECORD)
+		{
+			record_topwins(pXinfo);
+		}
+		else if(xinfo_value == XINFO_REPLAY)
+		{
+			replay_record(pXinfo, args);
+		}
 		else
 		{
 			fprintf(stderr, "error unsupported xinfo vaule\n");
@@ -337,9 +655,11 @@ int main(int argc, char **argv)
 		usage();
 
 error:
+	if(pXinfo)
+		status = pXinfo->status;
 	free_xinfo(pXinfo);
 
-	 return 0;
+	 return status;
 }
 
 
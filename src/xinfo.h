@@ -32,6 +32,10 @@ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #ifndef _XINFO_
 #define _XINFO_ 1
 
+#include <stdint.h>
+#include <stdio.h>
+#include <X11/Xlib.h>
+
 #define TRUE 1
 #define FALSE 0
 
@@ -42,7 +46,39 @@ enum XINFO_VAL
 	XINFO_PING,
 	XINFO_XWD_TOPVWINS,
 	XINFO_XWD_WIN,
-	XINFO_TOPVWINS_PROPS
+	XINFO_TOPVWINS_PROPS,
+	XINFO_WATCHDOG,
+	XINFO_WATCH,
+	XINFO_DUMP,
+	XINFO_DIFF,
+	XINFO_RECORD,
+	XINFO_REPLAY,
+	XINFO_TREE,
+	XINFO_OCCLUSION,
+	XINFO_OVERDRAW,
+	XINFO_XRES,
+	XINFO_LEAKWATCH,
+	XINFO_DAMAGE,
+	XINFO_LAUNCH,
+	XINFO_INPUTLAT
+};
+
+enum XINFO_FORMAT
+{
+	XINFO_FORMAT_TEXT,
+	XINFO_FORMAT_JSONL,
+	XINFO_FORMAT_CSV,
+	XINFO_FORMAT_TSV,
+	XINFO_FORMAT_BIN
+};
+
+/* how much of a window is on the screen, clipped by its ancestors */
+enum XINFO_SCREEN
+{
+	XINFO_SCREEN_UNKNOWN,
+	XINFO_SCREEN_ON,
+	XINFO_SCREEN_PARTIAL,
+	XINFO_SCREEN_OFF
 };
 
 typedef struct  _Xinfo {
@@ -52,9 +88,262 @@ typedef struct  _Xinfo {
 	char* filename;
 	char* pathname;
 	unsigned int  win; /* window id from command line */
+	long timeout; /* ping deadline in msec */
+	long interval; /* watchdog ping cadence in msec */
+	long threshold; /* watchdog hang threshold in msec */
+	int compress; /* gzip the xwd files */
+	int proc; /* print the resource usage of the processes */
+	long snapshot; /* watch snapshot period in msec, 0 : on SIGUSR1 only */
+	int format; /* XINFO_FORMAT of the output */
+	char *at; /* replay time from command line */
+	char *heatmap; /* overdraw heatmap file */
+	long leak; /* leakwatch growth threshold of the pixmaps in KB/h */
+	char *exec; /* command started and timed by launch */
+	int count; /* inputlat probes */
+	char *input; /* inputlat event : button, motion or a keysym name */
+	int status; /* exit status of xinfo */
 } Xinfo, *XinfoPtr;
 
-#endif
+/* xwd.c */
+void xwd_init(Display *dpy, int compress);
+void xwd_fini(Display *dpy);
+int xwd_dump_window(Display *dpy, Window window, const char *filename);
+
+/* props.c */
+typedef struct _PropList PropList, *PropListPtr;
+PropListPtr props_query(Display *dpy, Window *windows, int count);
+void props_print(Display *dpy, PropListPtr list, int idx, FILE *fd);
+void props_free(PropListPtr list);
+void props_export(Display *dpy, PropListPtr list, int idx,
+		  void (*emit)(void *data, const char *name, const char *type, const char *value), void *data);
+
+/* writer.c : the records of the XINFO_FORMAT outputs */
+typedef struct _Writer Writer, *WriterPtr;
+WriterPtr writer_open(FILE *fd, int format, const char *const *columns);
+void writer_str(WriterPtr w, const char *str);
+void writer_strn(WriterPtr w, const char *str, size_t len);
+void writer_long(WriterPtr w, long val);
+void writer_xid(WriterPtr w, unsigned long xid);
+void writer_double(WriterPtr w, double val);
+void writer_null(WriterPtr w);
+void writer_end(WriterPtr w);
+void writer_close(WriterPtr w);
+
+typedef struct _ProcUsage {
+	long rss; /* KB */
+	long pss; /* KB */
+	double cpu; /* user + system time in sec */
+	long threads;
+	long fds;
+} ProcUsage;
+
+const char *procinfo_cmdline(long pid);
+const ProcUsage *procinfo_usage(long pid);
+void procinfo_reset(void);
+
+typedef struct _StrChunk StrChunk;
+
+typedef struct _StrArena {
+	StrChunk *chunks;
+	size_t used; /* bytes of all the strings */
+	const char **table; /* interned strings */
+	int size;
+	int num;
+} StrArena;
+
+const char *arena_strdup(StrArena *arena, const char *str);
+const char *arena_strndup(StrArena *arena, const char *str, size_t len);
+void arena_release(StrArena *arena);
+
+/*
+ * Binary snapshot (--format=bin) : a header, a directory of fixed width
+ * columns of count rows each, and a table of NUL terminated strings. The
+ * file can be mmap()ed and the columns scanned in place. The integers are in
+ * the byte order of the writer, see byte_order.
+ */
+#define SNAP_MAGIC "XINFOSNP"
+#define SNAP_VERSION 1
+#define SNAP_BYTE_ORDER 0x01020304
+#define SNAP_NO_STRING 0xffffffff /* NULL in a string column */
+
+enum SNAP_COLUMN
+{
+	SNAP_PID,		/* int32 */
+	SNAP_BORDER_ID,		/* uint32 */
+	SNAP_WINID,		/* uint32 */
+	SNAP_W,			/* int32, and the geometry below */
+	SNAP_H,
+	SNAP_REL_X,
+	SNAP_REL_Y,
+	SNAP_ABS_X,
+	SNAP_ABS_Y,
+	SNAP_DEPTH,		/* uint8 */
+	SNAP_TYPE,		/* char[8] */
+	SNAP_LEVEL,		/* char[4] */
+	SNAP_MAP_STATE,		/* uint8, 0xff : unknown */
+	SNAP_PING_RTT,		/* int32 usec, -1 : no reply */
+	SNAP_WINNAME,		/* uint32 offset in the string table */
+	SNAP_APPNAME,
+	SNAP_COMMAND,
+	SNAP_RSS,		/* int32 KB, -1 : unknown, with --proc */
+	SNAP_PSS,
+	SNAP_CPU,		/* int32 1/100 sec */
+	SNAP_THREADS,
+	SNAP_FDS,
+	SNAP_SCREEN,		/* uint8 XINFO_SCREEN */
+	SNAP_VIS_X,		/* int32, the visible rectangle */
+	SNAP_VIS_Y,
+	SNAP_VIS_W,
+	SNAP_VIS_H
+};
 
+typedef struct _SnapColumn {
+	uint32_t id; /* SNAP_COLUMN */
+	uint32_t width; /* bytes per row */
+	uint64_t offset; /* from the start of the file, 8 bytes aligned */
+} SnapColumn;
 
+typedef struct _SnapHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t byte_order;
+	uint32_t mode; /* XINFO_VAL of the snapshot */
+	uint32_t count; /* rows */
+	int64_t time; /* seconds since the epoch */
+	uint32_t root;
+	uint32_t num_columns;
+	uint64_t strings; /* offset of the string table */
+	uint64_t strings_size;
+	SnapColumn columns[];
+} SnapHeader;
 
+typedef struct _SnapWriter SnapWriter, *SnapWriterPtr;
+SnapWriterPtr snap_writer_new(uint32_t mode, uint32_t root, uint32_t count);
+void *snap_writer_column(SnapWriterPtr sw, uint32_t id, uint32_t width);
+uint32_t snap_writer_string(SnapWriterPtr sw, const char *str);
+int snap_writer_save(SnapWriterPtr sw, FILE *fd);
+void snap_writer_free(SnapWriterPtr sw);
+const SnapHeader *snap_map(const char *path, size_t *size);
+const void *snap_column(const SnapHeader *header, uint32_t id, uint32_t width);
+const char *snap_string(const SnapHeader *header, uint32_t offset);
+void snap_unmap(const SnapHeader *header, size_t size);
+
+/*
+ * Record log (-record) : a header and a sequence of frames appended one per
+ * scan. A key frame holds the whole window table, a delta frame only the
+ * changes against the table of the frame before. Both are a stream of
+ * varints (zigzag for the signed values) :
+ *
+ *   count, then ops until count rows are made, the tag of an op is
+ *   (n << 1) | 1 : the next n rows of the previous table, unchanged
+ *   (i << 1)     : i = 0 a new window, border id follows, else the row i - 1
+ *                  of the previous table; a REC_FIELD mask and the fields
+ *                  in the mask follow
+ *
+ * A key frame is a delta against an empty table. The frames are 8 bytes
+ * aligned. Every key frame is also appended as a RecIndex to the sparse
+ * index file <file>.idx, so a reader seeks to a time without decoding the
+ * frames before it.
+ */
+#define REC_MAGIC "XINFOREC"
+#define REC_VERSION 1
+#define REC_INDEX_SUFFIX ".idx"
+
+enum REC_KIND
+{
+	REC_KEY,
+	REC_DELTA
+};
+
+enum REC_FIELD
+{
+	REC_PID = 1 << 0,	/* int */
+	REC_WINID = 1 << 1,	/* uint */
+	REC_W = 1 << 2,		/* int, and the geometry below */
+	REC_H = 1 << 3,
+	REC_REL_X = 1 << 4,
+	REC_REL_Y = 1 << 5,
+	REC_ABS_X = 1 << 6,
+	REC_ABS_Y = 1 << 7,
+	REC_DEPTH = 1 << 8,	/* uint */
+	REC_TYPE = 1 << 9,	/* string, and the strings below */
+	REC_LEVEL = 1 << 10,
+	REC_MAP_STATE = 1 << 11,	/* uint, 0xff : unknown */
+	REC_WINNAME = 1 << 12,
+	REC_APPNAME = 1 << 13,
+	REC_COMMAND = 1 << 14,
+	REC_SCREEN = 1 << 15	/* uint XINFO_SCREEN, then the visible rectangle as int */
+};
+
+typedef struct _RecHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t byte_order; /* SNAP_BYTE_ORDER */
+	uint32_t mode; /* XINFO_VAL of the scans */
+	uint32_t root;
+	int64_t start; /* msec since the epoch */
+	int64_t interval; /* msec */
+} RecHeader;
+
+typedef struct _RecFrame {
+	uint32_t size; /* bytes of the payload which follows */
+	uint32_t kind; /* REC_KIND */
+	int64_t time; /* msec since the epoch */
+} RecFrame;
+
+typedef struct _RecIndex {
+	int64_t time; /* of the key frame */
+	uint64_t offset; /* of the key frame in the record file */
+} RecIndex;
+
+/* growable buffer of the encoder, and the cursor of the decoder */
+typedef struct _RecBuf {
+	unsigned char *data;
+	size_t len;
+	size_t size;
+} RecBuf;
+
+typedef struct _RecCursor {
+	const unsigned char *pos;
+	const unsigned char *end;
+	int error; /* set when the data ran out or is malformed */
+} RecCursor;
+
+typedef struct _RecFile RecFile, *RecFilePtr;
+void rec_put_uint(RecBuf *buf, uint64_t val);
+void rec_put_int(RecBuf *buf, int64_t val);
+void rec_put_str(RecBuf *buf, const char *str);
+uint64_t rec_get_uint(RecCursor *cur);
+int64_t rec_get_int(RecCursor *cur);
+const char *rec_get_str(RecCursor *cur);
+RecFilePtr rec_open(FILE *fd, FILE *index, uint32_t mode, uint32_t root, int64_t start, int64_t interval);
+int rec_append(RecFilePtr rf, uint32_t kind, int64_t time, const RecBuf *buf);
+void rec_close(RecFilePtr rf);
+const RecHeader *rec_map(const char *path, size_t *size);
+void rec_unmap(const RecHeader *header, size_t size);
+const RecFrame *rec_first(const RecHeader *header, size_t size);
+const RecFrame *rec_next(const RecHeader *header, size_t size, const RecFrame *frame);
+const RecFrame *rec_seek(const RecHeader *header, size_t size, const char *path, int64_t time);
+
+/*
+ * Overdraw : the number of windows on every pixel of the screen.
+ */
+#define OVERDRAW_LEVELS 16 /* the last level counts the pixels with more layers too */
+
+typedef struct _OverdrawStats {
+	int width;
+	int height;
+	int max; /* most layers on a pixel */
+	long covered; /* pixels under one window at least */
+	long long layers; /* sum of the layers of all the pixels */
+	long area[OVERDRAW_LEVELS + 1]; /* pixels with n layers */
+} OverdrawStats;
+
+typedef struct _Overdraw Overdraw, *OverdrawPtr;
+OverdrawPtr overdraw_new(int width, int height);
+void overdraw_add(OverdrawPtr od, int x, int y, int w, int h);
+const OverdrawStats *overdraw_resolve(OverdrawPtr od);
+int overdraw_write_pgm(OverdrawPtr od, FILE *fd);
+void overdraw_free(OverdrawPtr od);
+
+#endif
@@ -0,0 +1,732 @@
+/**************************************************************************
+
+xinfo
+
+Copyright 2014-2018 Samsung Electronics co., Ltd. All Rights Reserved.
+
+Contact: SooChan Lim <sc1.lim@samsung.com>
+Contact: Gwan-gyeong Mun <kk.moon@samsung.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sub license, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice (including the
+next paragraph) shall be included in all copies or substantial portions
+of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+**************************************************************************/
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/XWDFile.h>
+#include <X11/extensions/XShm.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <zlib.h>
+#include <arpa/inet.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <xinfo.h>
+
+/*
+ * In-process replacement of /usr/bin/xwd : the window is captured with
+ * XGetImage on the connection of xinfo and stored in the XWD file format,
+ * the same way as 'xwd -id <window> -out <file>' does.
+ *
+ * When the MIT-SHM extension is available, the images are read with
+ * XShmGetImage into one shared memory segment, sized for the whole screen
+ * and reused for all the windows, instead of through the socket.
+ *
+ * The dump is a pipeline : the windows are captured on the X thread, the
+ * XWD files are gzip compressed by a bounded pool of workers, one per core,
+ * and written by a writer thread, so the capture doesn't wait for the flash.
+ */
+
+#define XWD_GZIP_LEVEL 1 /* window contents compress well even at the fastest level */
+
+typedef struct _XwdJob {
+    struct _XwdJob *next;
+    char filename[255];
+    unsigned char *data; /* the whole xwd file : header, name, colors and image */
+    size_t size;
+    unsigned char *out; /* compressed data, or data */
+    size_t out_size;
+} XwdJob, *XwdJobPtr;
+
+typedef struct _XwdQueue {
+    XwdJobPtr head, tail;
+    int num;
+    int max;
+    int closed;
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+} XwdQueue;
+
+typedef struct _XwdStat {
+    int files;
+    int failed;
+    long capture_us;
+    long compress_us;
+    long write_us;
+    size_t raw_bytes;
+    size_t out_bytes;
+} XwdStat;
+
+static int xwd_error_code = 0;
+static XShmSegmentInfo xwd_shminfo;
+static size_t xwd_shm_size = 0; /* 0 : MIT-SHM is not used */
+
+static int xwd_compress = 0;
+static int xwd_num_workers = 0;
+static pthread_t *xwd_workers = NULL;
+static pthread_t xwd_writer;
+static XwdQueue xwd_compress_queue;
+static XwdQueue xwd_write_queue;
+static XwdStat xwd_stat;
+static pthread_mutex_t xwd_stat_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct timespec xwd_start;
+
+    static int
+_xwd_error_handler(Display *disp, XErrorEvent *ev)
+{
+    xwd_error_code = ev->error_code;
+    return 0;
+}
+
+    static long
+_elapsed_usec(struct timespec *from, struct timespec *to)
+{
+    return (to->tv_sec - from->tv_sec) * 1000000L + (to->tv_nsec - from->tv_nsec) / 1000L;
+}
+
+    static void
+_queue_init(XwdQueue *q, int max)
+{
+    memset(q, 0, sizeof(XwdQueue));
+    q->max = max;
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->not_empty, NULL);
+    pthread_cond_init(&q->not_full, NULL);
+}
+
+    static void
+_queue_fini(XwdQueue *q)
+{
+    pthread_mutex_destroy(&q->lock);
+    pthread_cond_destroy(&q->not_empty);
+    pthread_cond_destroy(&q->not_full);
+}
+
+/* blocks while the queue is full, which bounds the memory of the pipeline */
+    static void
+_queue_push(XwdQueue *q, XwdJobPtr job)
+{
+    pthread_mutex_lock(&q->lock);
+    while (q->num >= q->max)
+        pthread_cond_wait(&q->not_full, &q->lock);
+
+    job->next = NULL;
+    if (q->tail)
+        q->tail->next = job;
+    else
+        q->head = job;
+    q->tail = job;
+    q->num++;
+
+    pthread_cond_signal(&q->not_empty);
+    pthread_mutex_unlock(&q->lock);
+}
+
+/* returns NULL when the queue is closed and empty */
+    static XwdJobPtr
+_queue_pop(XwdQueue *q)
+{
+    XwdJobPtr job;
+
+    pthread_mutex_lock(&q->lock);
+    while (!q->head && !q->closed)
+        pthread_cond_wait(&q->not_empty, &q->lock);
+
+    job = q->head;
+    if (job)
+    {
+        q->head = job->next;
+        if (!q->head)
+            q->tail = NULL;
+        q->num--;
+        pthread_cond_signal(&q->not_full);
+    }
+    pthread_mutex_unlock(&q->lock);
+
+    return job;
+}
+
+    static void
+_queue_close(XwdQueue *q)
+{
+    pthread_mutex_lock(&q->lock);
+    q->closed = 1;
+    pthread_cond_broadcast(&q->not_empty);
+    pthread_mutex_unlock(&q->lock);
+}
+
+    static void
+_free_job(XwdJobPtr job)
+{
+    if (job->out != job->data)
+        free(job->out);
+    free(job->data);
+    free(job);
+}
+
+    static int
+_gzip(XwdJobPtr job)
+{
+    z_stream zs;
+    uLong bound;
+    int ret;
+
+    memset(&zs, 0, sizeof(zs));
+    /* 16 + MAX_WBITS : gzip header, so the file can be read with zcat */
+    if (deflateInit2(&zs, XWD_GZIP_LEVEL, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        return -1;
+
+    bound = deflateBound(&zs, job->size);
+    job->out = malloc(bound);
+    if (!job->out)
+    {
+        deflateEnd(&zs);
+        return -1;
+    }
+
+    zs.next_in = job->data;
+    zs.avail_in = job->size;
+    zs.next_out = job->out;
+    zs.avail_out = bound;
+    ret = deflate(&zs, Z_FINISH);
+    job->out_size = zs.total_out;
+    deflateEnd(&zs);
+
+    if (ret != Z_STREAM_END)
+    {
+        free(job->out);
+        job->out = NULL;
+        return -1;
+    }
+
+    return 0;
+}
+
+    static void *
+_compress_worker(void *data)
+{
+    struct timespec start, end;
+    XwdJobPtr job;
+
+    while ((job = _queue_pop(&xwd_compress_queue)))
+    {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        if (!xwd_compress || _gzip(job))
+        {
+            job->out = job->data;
+            job->out_size = job->size;
+        }
+        else
+            strncat(job->filename, ".gz", sizeof(job->filename) - strlen(job->filename) - 1);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        pthread_mutex_lock(&xwd_stat_lock);
+        xwd_stat.compress_us += _elapsed_usec(&start, &end);
+        pthread_mutex_unlock(&xwd_stat_lock);
+
+        _queue_push(&xwd_write_queue, job);
+    }
+
+    return NULL;
+}
+
+    static void *
+_write_worker(void *data)
+{
+    struct timespec start, end;
+    XwdJobPtr job;
+    FILE *fp;
+    int ret;
+
+    while ((job = _queue_pop(&xwd_write_queue)))
+    {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        ret = -1;
+        fp = fopen(job->filename, "wb");
+        if (fp)
+        {
+            ret = (fwrite(job->out, job->out_size, 1, fp) == 1) ? 0 : -1;
+            if (fclose(fp))
+                ret = -1;
+        }
+        if (ret)
+            fprintf(stderr, "fail to write %s\n", job->filename);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        pthread_mutex_lock(&xwd_stat_lock);
+        xwd_stat.write_us += _elapsed_usec(&start, &end);
+        if (ret)
+            xwd_stat.failed++;
+        else
+        {
+            xwd_stat.files++;
+            xwd_stat.raw_bytes += job->size;
+            xwd_stat.out_bytes += job->out_size;
+        }
+        pthread_mutex_unlock(&xwd_stat_lock);
+
+        _free_job(job);
+    }
+
+    return NULL;
+}
+
+/*
+ * Prepare the shared memory segment for the captures. Falls back to the
+ * socket transfer if MIT-SHM is missing or can't be attached (remote display).
+ */
+    static void
+_shm_init(Display *dpy)
+{
+    int (*old_handler)(Display *, XErrorEvent *);
+    Screen *scr = DefaultScreenOfDisplay(dpy);
+    size_t size;
+
+    if (xwd_shm_size)
+        return;
+
+    if (!XShmQueryExtension(dpy))
+    {
+        fprintf(stderr, "MIT-SHM is not available, capture through the socket\n");
+        return;
+    }
+
+    size = (size_t)WidthOfScreen(scr) * HeightOfScreen(scr) * 4;
+
+    xwd_shminfo.shmid = shmget(IPC_PRIVATE, size, IPC_CREAT | 0600);
+    if (xwd_shminfo.shmid < 0)
+    {
+        fprintf(stderr, "fail to get shared memory, capture through the socket\n");
+        return;
+    }
+
+    xwd_shminfo.shmaddr = shmat(xwd_shminfo.shmid, NULL, 0);
+    if (xwd_shminfo.shmaddr == (char *)-1)
+    {
+        fprintf(stderr, "fail to attach shared memory, capture through the socket\n");
+        shmctl(xwd_shminfo.shmid, IPC_RMID, NULL);
+        return;
+    }
+    xwd_shminfo.readOnly = False;
+
+    xwd_error_code = 0;
+    old_handler = XSetErrorHandler(_xwd_error_handler);
+    XShmAttach(dpy, &xwd_shminfo);
+    XSync(dpy, False);
+    XSetErrorHandler(old_handler);
+
+    /* the segment is removed as soon as both sides detach it */
+    shmctl(xwd_shminfo.shmid, IPC_RMID, NULL);
+
+    if (xwd_error_code)
+    {
+        fprintf(stderr, "fail to attach MIT-SHM, capture through the socket\n");
+        shmdt(xwd_shminfo.shmaddr);
+        return;
+    }
+
+    xwd_shm_size = size;
+}
+
+    static void
+_shm_fini(Display *dpy)
+{
+    if (!xwd_shm_size)
+        return;
+
+    XShmDetach(dpy, &xwd_shminfo);
+    XSync(dpy, False);
+    shmdt(xwd_shminfo.shmaddr);
+    xwd_shm_size = 0;
+}
+
+    static XImage *
+_shm_get_image(Display *dpy, Window window, XWindowAttributes *attr, int x, int y, int width, int height)
+{
+    XImage *image;
+
+    if (!xwd_shm_size)
+        return NULL;
+
+    image = XShmCreateImage(dpy, attr->visual, attr->depth, ZPixmap, NULL, &xwd_shminfo, width, height);
+    if (!image)
+        return NULL;
+
+    if ((size_t)image->bytes_per_line * height > xwd_shm_size)
+    {
+        XDestroyImage(image);
+        return NULL;
+    }
+
+    image->data = xwd_shminfo.shmaddr;
+    if (!XShmGetImage(dpy, window, image, x, y, AllPlanes))
+    {
+        image->data = NULL;
+        XDestroyImage(image);
+        return NULL;
+    }
+
+    return image;
+}
+
+    static int
+_get_xcolors(Display *dpy, XWindowAttributes *attr, XColor **colors)
+{
+    Visual *vis = attr->visual;
+    unsigned long red, green, blue, red1, green1, blue1;
+    int i, ncolors;
+
+    *colors = NULL;
+    if (attr->colormap == None)
+        return 0;
+
+    ncolors = vis->map_entries;
+    if (ncolors <= 0)
+        return 0;
+
+    *colors = (XColor *) calloc(ncolors, sizeof(XColor));
+    if (!*colors)
+        return 0;
+
+    if (vis->class == DirectColor || vis->class == TrueColor)
+    {
+        red = green = blue = 0;
+        red1 = vis->red_mask & -vis->red_mask;
+        green1 = vis->green_mask & -vis->green_mask;
+        blue1 = vis->blue_mask & -vis->blue_mask;
+        for (i = 0; i < ncolors; i++)
+        {
+            (*colors)[i].pixel = red | green | blue;
+            red += red1;
+            if (red > vis->red_mask)
+                red = 0;
+            green += green1;
+            if (green > vis->green_mask)
+                green = 0;
+            blue += blue1;
+            if (blue > vis->blue_mask)
+                blue = 0;
+        }
+    }
+    else
+    {
+        for (i = 0; i < ncolors; i++)
+            (*colors)[i].pixel = i;
+    }
+
+    XQueryColors(dpy, attr->colormap, *colors, ncolors);
+
+    return ncolors;
+}
+
+    static XwdJobPtr
+_build_xwd(const char *filename, const char *name, XWindowAttributes *attr,
+           int absx, int absy, XImage *image, XColor *colors, int ncolors)
+{
+    XWDFileHeader header;
+    XWDColor xwdcolor;
+    XwdJobPtr job;
+    CARD32 *val;
+    unsigned char *p;
+    size_t name_size, image_size;
+    unsigned int i;
+
+    name_size = strlen(name) + 1;
+    image_size = (size_t)image->bytes_per_line * image->height;
+
+    memset(&header, 0, sizeof(header));
+    header.header_size = sz_XWDheader + name_size;
+    header.file_version = XWD_FILE_VERSION;
+    header.pixmap_format = ZPixmap;
+    header.pixmap_depth = image->depth;
+    header.pixmap_width = image->width;
+    header.pixmap_height = image->height;
+    header.xoffset = image->xoffset;
+    header.byte_order = image->byte_order;
+    header.bitmap_unit = image->bitmap_unit;
+    header.bitmap_bit_order = image->bitmap_bit_order;
+    header.bitmap_pad = image->bitmap_pad;
+    header.bits_per_pixel = image->bits_per_pixel;
+    header.bytes_per_line = image->bytes_per_line;
+    header.visual_class = attr->visual->class;
+    header.red_mask = attr->visual->red_mask;
+    header.green_mask = attr->visual->green_mask;
+    header.blue_mask = attr->visual->blue_mask;
+    header.bits_per_rgb = attr->visual->bits_per_rgb;
+    header.colormap_entries = attr->visual->map_entries;
+    header.ncolors = ncolors;
+    header.window_width = attr->width;
+    header.window_height = attr->height;
+    header.window_x = absx;
+    header.window_y = absy;
+    header.window_bdrwidth = attr->border_width;
+
+    /* the header and the colors are stored in MSB first */
+    for (i = 0, val = (CARD32 *)&header; i < sz_XWDheader / sizeof(CARD32); i++)
+        val[i] = htonl(val[i]);
+
+    job = calloc(1, sizeof(XwdJob));
+    if (!job)
+        return NULL;
+
+    job->size = sz_XWDheader + name_size + (size_t)ncolors * sz_XWDColor + image_size;
+    job->data = malloc(job->size);
+    if (!job->data)
+    {
+        free(job);
+        return NULL;
+    }
+    snprintf(job->filename, sizeof(job->filename), "%s", filename);
+
+    p = job->data;
+    memcpy(p, &header, sz_XWDheader);
+    p += sz_XWDheader;
+    memcpy(p, name, name_size);
+    p += name_size;
+
+    for (i = 0; i < (unsigned int)ncolors; i++)
+    {
+        xwdcolor.pixel = htonl(colors[i].pixel);
+        xwdcolor.red = htons(colors[i].red);
+        xwdcolor.green = htons(colors[i].green);
+        xwdcolor.blue = htons(colors[i].blue);
+        xwdcolor.flags = colors[i].flags;
+        xwdcolor.pad = 0;
+        memcpy(p, &xwdcolor, sz_XWDColor);
+        p += sz_XWDColor;
+    }
+
+    /* the image is copied out, the shared memory segment is reused */
+    memcpy(p, image->data, image_size);
+
+    return job;
+}
+
+/*
+ * Start the dump : prepare MIT-SHM and the compress and write threads.
+ * compress : gzip the xwd files.
+ */
+    void
+xwd_init(Display *dpy, int compress)
+{
+    long cores;
+    int i;
+
+    _shm_init(dpy);
+
+    memset(&xwd_stat, 0, sizeof(xwd_stat));
+    clock_gettime(CLOCK_MONOTONIC, &xwd_start);
+
+    cores = sysconf(_SC_NPROCESSORS_ONLN);
+    xwd_num_workers = cores > 0 ? cores : 1;
+    xwd_compress = compress;
+
+    _queue_init(&xwd_compress_queue, 2 * xwd_num_workers);
+    _queue_init(&xwd_write_queue, 2 * xwd_num_workers);
+
+    xwd_workers = calloc(xwd_num_workers, sizeof(pthread_t));
+    if (!xwd_workers)
+    {
+        fprintf(stderr, " alloc error \n");
+        exit(1);
+    }
+
+    for (i = 0; i < xwd_num_workers; i++)
+    {
+        if (pthread_create(&xwd_workers[i], NULL, _compress_worker, NULL))
+        {
+            fprintf(stderr, "fail to create the compress thread\n");
+            exit(1);
+        }
+    }
+
+    if (pthread_create(&xwd_writer, NULL, _write_worker, NULL))
+    {
+        fprintf(stderr, "fail to create the write thread\n");
+        exit(1);
+    }
+}
+
+/*
+ * Finish the dump : wait for the pending files and report the timings of
+ * every stage.
+ */
+    void
+xwd_fini(Display *dpy)
+{
+    struct timespec end;
+    int i;
+
+    _queue_close(&xwd_compress_queue);
+    for (i = 0; i < xwd_num_workers; i++)
+        pthread_join(xwd_workers[i], NULL);
+
+    _queue_close(&xwd_write_queue);
+    pthread_join(xwd_writer, NULL);
+
+    _queue_fini(&xwd_compress_queue);
+    _queue_fini(&xwd_write_queue);
+    free(xwd_workers);
+    xwd_workers = NULL;
+
+    _shm_fini(dpy);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    fprintf(stderr, " [STAT] %d files (%d failed), %zu KB -> %zu KB, wall %ld ms\n",
+            xwd_stat.files, xwd_stat.failed, xwd_stat.raw_bytes / 1024, xwd_stat.out_bytes / 1024,
+            _elapsed_usec(&xwd_start, &end) / 1000);
+    fprintf(stderr, " [STAT] capture %ld ms, compress %ld ms (%d workers%s), write %ld ms\n",
+            xwd_stat.capture_us / 1000, xwd_stat.compress_us / 1000, xwd_num_workers,
+            xwd_compress ? ", gzip" : ", none", xwd_stat.write_us / 1000);
+}
+
+/*
+ * Capture the window including its border, clipped to the screen, and queue
+ * it to be stored into filename (".gz" is appended when it is compressed).
+ * Must be called between xwd_init() and xwd_fini().
+ * Returns 0 on success, -1 if the window can't be captured.
+ */
+    int
+xwd_dump_window(Display *dpy, Window window, const char *filename)
+{
+    int (*old_handler)(Display *, XErrorEvent *);
+    XWindowAttributes attr;
+    XImage *image = NULL;
+    XColor *colors = NULL;
+    char *win_name = NULL;
+    Window child;
+    int absx, absy, x, y, width, height, dwidth, dheight;
+    int ncolors = 0;
+    Bool shm = False;
+    XwdJobPtr job = NULL;
+    struct timespec start, end;
+    int ret = -1;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    /* the window can be unmapped or destroyed in the meantime */
+    xwd_error_code = 0;
+    old_handler = XSetErrorHandler(_xwd_error_handler);
+
+    if (!XGetWindowAttributes(dpy, window, &attr))
+        goto out;
+
+    if (!XTranslateCoordinates(dpy, window, attr.root, 0, 0, &absx, &absy, &child))
+        goto out;
+
+    /* include the border and clip to the screen */
+    absx -= attr.border_width;
+    absy -= attr.border_width;
+    width = attr.width + 2 * attr.border_width;
+    height = attr.height + 2 * attr.border_width;
+    dwidth = WidthOfScreen(attr.screen);
+    dheight = HeightOfScreen(attr.screen);
+
+    x = -attr.border_width;
+    y = -attr.border_width;
+    if (absx < 0)
+    {
+        width += absx;
+        x -= absx;
+        absx = 0;
+    }
+    if (absy < 0)
+    {
+        height += absy;
+        y -= absy;
+        absy = 0;
+    }
+    if (absx + width > dwidth)
+        width = dwidth - absx;
+    if (absy + height > dheight)
+        height = dheight - absy;
+
+    if (width <= 0 || height <= 0)
+    {
+        fprintf(stderr, "window 0x%lx is out of the screen\n", window);
+        goto out;
+    }
+
+    image = _shm_get_image(dpy, window, &attr, x, y, width, height);
+    if (image)
+        shm = True;
+    else
+        image = XGetImage(dpy, window, x, y, width, height, AllPlanes, ZPixmap);
+    if (!image)
+    {
+        fprintf(stderr, "fail to get the image of window 0x%lx (error %d)\n", window, xwd_error_code);
+        goto out;
+    }
+
+    ncolors = _get_xcolors(dpy, &attr, &colors);
+
+    if (!XFetchName(dpy, window, &win_name) || !win_name)
+        win_name = NULL;
+
+    job = _build_xwd(filename, win_name ? win_name : "xwdump", &attr, absx, absy, image, colors, ncolors);
+    if (!job)
+        fprintf(stderr, "fail to alloc the xwd of window 0x%lx\n", window);
+
+out:
+    XSetErrorHandler(old_handler);
+    if (win_name)
+        XFree(win_name);
+    if (image)
+    {
+        /* the data of the shared memory image is the segment */
+        if (shm)
+            image->data = NULL;
+        XDestroyImage(image);
+    }
+    free(colors);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    pthread_mutex_lock(&xwd_stat_lock);
+    xwd_stat.capture_us += _elapsed_usec(&start, &end);
+    if (!job)
+        xwd_stat.failed++;
+    pthread_mutex_unlock(&xwd_stat_lock);
+
+    if (job)
+    {
+        _queue_push(&xwd_compress_queue, job);
+        ret = 0;
+    }
+
+    return ret;
+}